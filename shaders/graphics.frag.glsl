@@ -1,11 +1,21 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(set = 1, binding = 0) uniform sampler2D texSampler;
+// 无绑定纹理表，BINDLESS_SAMPLER_CAPACITY 由 ShaderManager 按 Config 定义
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 1) uniform sampler samplers[BINDLESS_SAMPLER_CAPACITY];
+
+// 两条渲染路径的推送常量在偏移 96 处都是纹理槽位，与 GraphicsPipeline 中的 TEXTURE_CONSTANTS_OFFSET 一致
+layout(push_constant) uniform TextureConstants {
+    layout(offset = 96) uint texture_index;
+    uint sampler_index;
+} material;
 
 layout(location = 0) in vec2 fragTexCoord;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = texture(texSampler, fragTexCoord);
+    // 推送常量在一次绘制内是统一的，不需要 nonuniformEXT
+    outColor = texture(sampler2D(textures[material.texture_index], samplers[material.sampler_index]), fragTexCoord);
 }
@@ -6,12 +6,23 @@ layout(binding = 0) uniform UniformBufferObject {
     mat4 proj;
 } ubo;
 
+// 逐绘制参数：网格变换与反量化参数，浮点顶点布局时反量化为单位变换
+layout(push_constant) uniform DrawConstants {
+    mat4 transform;
+    vec4 offset;
+    vec4 scale;
+    uint texture_index;
+    uint sampler_index;
+} mesh;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec2 inTexCoord;
 
 layout(location = 0) out vec2 fragTexCoord;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    // UNORM 与半精度属性已由顶点输入阶段解码为浮点数
+    vec3 position = mesh.offset.xyz + inPosition * mesh.scale.xyz;
+    gl_Position = ubo.proj * ubo.view * ubo.model * mesh.transform * vec4(position, 1.0);
     fragTexCoord = inTexCoord;
 }
@@ -0,0 +1,88 @@
+#version 460
+#extension GL_EXT_mesh_shader : require
+
+layout(local_size_x = 32) in;
+// 与 Config 中的 MESHLET_MAX_VERTICES、MESHLET_MAX_TRIANGLES 一致
+layout(triangles, max_vertices = 64, max_primitives = 124) out;
+
+// 顶点布局，与 Config 中的 VertexLayout 一致：0 为浮点布局，1 为紧凑布局
+layout(constant_id = 0) const uint VERTEX_LAYOUT = 1;
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(push_constant) uniform MeshletConstants {
+    mat4 transform;
+    vec4 offset;
+    vec4 scale;
+    uint texture_index;
+    uint sampler_index;
+    uint meshlet_offset;
+    uint meshlet_count;
+    uint vertex_offset;
+} constants;
+
+struct Meshlet {
+    vec4 sphere;
+    vec4 cone;
+    uint vertex_offset;
+    uint triangle_offset;
+    uint vertex_count;
+    uint triangle_count;
+};
+
+// 顶点缓冲区按 uint 读取，再按顶点布局解码
+layout(set = 2, binding = 0, std430) readonly buffer Vertices {
+    uint vertices[];
+};
+layout(set = 2, binding = 1, std430) readonly buffer Meshlets {
+    Meshlet meshlets[];
+};
+layout(set = 2, binding = 2, std430) readonly buffer MeshletVertices {
+    uint meshlet_vertices[];
+};
+layout(set = 2, binding = 3, std430) readonly buffer MeshletTriangles {
+    uint meshlet_triangles[];
+};
+
+struct Payload {
+    uint meshlet_indices[32];
+};
+
+taskPayloadSharedEXT Payload payload;
+
+layout(location = 0) out vec2 fragTexCoord[];
+
+void load_vertex(uint index, out vec3 position, out vec2 tex_coord) {
+    if (VERTEX_LAYOUT == 0) {
+        uint base = index * 5;
+        position = uintBitsToFloat(uvec3(vertices[base], vertices[base + 1], vertices[base + 2]));
+        tex_coord = uintBitsToFloat(uvec2(vertices[base + 3], vertices[base + 4]));
+    } else {
+        uint base = index * 3;
+        position = vec3(unpackUnorm2x16(vertices[base]), unpackUnorm2x16(vertices[base + 1]).x);
+        tex_coord = unpackHalf2x16(vertices[base + 2]);
+    }
+}
+
+void main() {
+    Meshlet meshlet = meshlets[payload.meshlet_indices[gl_WorkGroupID.x]];
+    SetMeshOutputsEXT(meshlet.vertex_count, meshlet.triangle_count);
+
+    mat4 mvp = ubo.proj * ubo.view * ubo.model * constants.transform;
+    for (uint i = gl_LocalInvocationIndex; i < meshlet.vertex_count; i += gl_WorkGroupSize.x) {
+        vec3 position;
+        vec2 tex_coord;
+        load_vertex(constants.vertex_offset + meshlet_vertices[meshlet.vertex_offset + i], position, tex_coord);
+        position = constants.offset.xyz + position * constants.scale.xyz;
+        gl_MeshVerticesEXT[i].gl_Position = mvp * vec4(position, 1.0);
+        fragTexCoord[i] = tex_coord;
+    }
+    for (uint i = gl_LocalInvocationIndex; i < meshlet.triangle_count; i += gl_WorkGroupSize.x) {
+        uint packed = meshlet_triangles[meshlet.triangle_offset + i];
+        gl_PrimitiveTriangleIndicesEXT[i] = uvec3(packed & 0xff, (packed >> 8) & 0xff, (packed >> 16) & 0xff);
+    }
+}
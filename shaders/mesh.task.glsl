@@ -0,0 +1,82 @@
+#version 460
+#extension GL_EXT_mesh_shader : require
+
+// 每个任务工作组处理 32 个 meshlet，与 Drawer 中的分发数量一致
+layout(local_size_x = 32) in;
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(push_constant) uniform MeshletConstants {
+    mat4 transform;
+    vec4 offset;
+    vec4 scale;
+    uint texture_index;
+    uint sampler_index;
+    uint meshlet_offset;
+    uint meshlet_count;
+    uint vertex_offset;
+} constants;
+
+struct Meshlet {
+    vec4 sphere;
+    vec4 cone;
+    uint vertex_offset;
+    uint triangle_offset;
+    uint vertex_count;
+    uint triangle_count;
+};
+
+layout(set = 2, binding = 1, std430) readonly buffer Meshlets {
+    Meshlet meshlets[];
+};
+
+struct Payload {
+    uint meshlet_indices[32];
+};
+
+taskPayloadSharedEXT Payload payload;
+
+shared uint visible_count;
+
+// 视锥剔除：在观察空间中用包围球测试左右、上下四个侧面以及相机后方
+bool frustum_visible(vec3 center, float radius) {
+    mat4 model = ubo.model * constants.transform;
+    vec4 view_center = ubo.view * model * vec4(center, 1.0);
+    float scale = max(max(length(model[0].xyz), length(model[1].xyz)), length(model[2].xyz));
+    float view_radius = radius * scale;
+    if (view_center.z - view_radius > 0.0) return false;
+    vec2 px = normalize(vec2(ubo.proj[0][0], 1.0));
+    vec2 py = normalize(vec2(abs(ubo.proj[1][1]), 1.0));
+    if (px.x * abs(view_center.x) + px.y * view_center.z > view_radius) return false;
+    if (py.x * abs(view_center.y) + py.y * view_center.z > view_radius) return false;
+    return true;
+}
+
+// 法线锥剔除：在模型空间中判断 meshlet 内所有三角形是否都背向相机
+bool cone_visible(vec3 center, float radius, vec4 cone) {
+    if (cone.w >= 1.0) return true;
+    vec3 camera = (inverse(ubo.view * ubo.model * constants.transform) * vec4(0.0, 0.0, 0.0, 1.0)).xyz;
+    vec3 direction = center - camera;
+    return dot(direction, cone.xyz) < cone.w * length(direction) + radius;
+}
+
+void main() {
+    if (gl_LocalInvocationIndex == 0) visible_count = 0;
+    barrier();
+
+    uint index = constants.meshlet_offset + gl_GlobalInvocationID.x;
+    if (gl_GlobalInvocationID.x < constants.meshlet_count) {
+        Meshlet meshlet = meshlets[index];
+        if (frustum_visible(meshlet.sphere.xyz, meshlet.sphere.w) &&
+            cone_visible(meshlet.sphere.xyz, meshlet.sphere.w, meshlet.cone)) {
+            payload.meshlet_indices[atomicAdd(visible_count, 1)] = index;
+        }
+    }
+    barrier();
+
+    EmitMeshTasksEXT(visible_count, 1, 1);
+}
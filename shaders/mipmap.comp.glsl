@@ -0,0 +1,41 @@
+#version 450
+
+// 由上一级 mip 生成下一级，每个线程输出一个像素
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// 两级都以 UNORM 格式的存储图像视图访问，sRGB 图像在着色器中转换
+layout(set = 0, binding = 0, rgba8) uniform readonly image2D srcImage;
+layout(set = 0, binding = 1, rgba8) uniform writeonly image2D dstImage;
+
+layout(push_constant) uniform MipmapConstants {
+    uint srgb;
+} constants;
+
+vec3 to_linear(vec3 c) {
+    return mix(c / 12.92, pow((c + 0.055) / 1.055, vec3(2.4)), greaterThan(c, vec3(0.04045)));
+}
+
+vec3 to_srgb(vec3 c) {
+    return mix(c * 12.92, 1.055 * pow(c, vec3(1.0 / 2.4)) - 0.055, greaterThan(c, vec3(0.0031308)));
+}
+
+vec4 load(ivec2 p, ivec2 size) {
+    vec4 texel = imageLoad(srcImage, min(p, size - 1));
+    if (constants.srgb != 0) texel.rgb = to_linear(texel.rgb);
+    return texel;
+}
+
+void main() {
+    const ivec2 dst = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(dst, imageSize(dstImage)))) return;
+
+    // 2x2 盒式滤波，奇数尺寸时边缘像素重复
+    const ivec2 size = imageSize(srcImage);
+    const ivec2 src = dst * 2;
+    vec4 color = load(src, size) + load(src + ivec2(1, 0), size) +
+                 load(src + ivec2(0, 1), size) + load(src + ivec2(1, 1), size);
+    color *= 0.25;
+
+    if (constants.srgb != 0) color.rgb = to_srgb(color.rgb);
+    imageStore(dstImage, dst, color);
+}
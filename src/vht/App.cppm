@@ -4,37 +4,69 @@ import std;
 import glfw;
 import vulkan_hpp;
 
-import DataLoader;
+import AssetLoader;
+import SceneLoader;
 import Context;
 import Window;
 import Device;
+import MemoryAllocator;
+import StagingRing;
+import UploadBatcher;
+import PipelineCache;
+import ShaderManager;
 import Swapchain;
 import DepthImage;
 import RenderPass;
+import PipelineRegistry;
 import GraphicsPipeline;
+import MeshPipeline;
+import PipelineBuilder;
 import CommandPool;
 import InputAssembly;
+import MeshletAssembly;
 import UniformBuffer;
+import MipmapGenerator;
+import TextureTable;
 import TextureSampler;
+import TextureStreamer;
+import TextureLoader;
 import Descriptor;
+import ShaderReloader;
 import Drawer;
 
 export namespace vht {
     class App {
-        std::shared_ptr<vht::DataLoader> m_data_loader{ nullptr };
         std::shared_ptr<vht::Context> m_context{ nullptr };
         std::shared_ptr<vht::Window> m_window{ nullptr };
         std::shared_ptr<vht::Device> m_device{ nullptr };
+        std::shared_ptr<vht::MemoryAllocator> m_memory_allocator{ nullptr };
+        std::shared_ptr<vht::StagingRing> m_staging_ring{ nullptr };
+        std::shared_ptr<vht::UploadBatcher> m_upload_batcher{ nullptr };
+        std::shared_ptr<vht::PipelineCache> m_pipeline_cache{ nullptr };
+        std::shared_ptr<vht::ShaderManager> m_shader_manager{ nullptr };
         std::shared_ptr<vht::Swapchain> m_swapchain{ nullptr };
         std::shared_ptr<vht::DepthImage> m_depth_image{ nullptr };
         std::shared_ptr<vht::RenderPass> m_render_pass{ nullptr };
+        std::shared_ptr<vht::PipelineRegistry> m_pipeline_registry{ nullptr };
+        std::shared_ptr<vht::TextureTable> m_texture_table{ nullptr };
         std::shared_ptr<vht::GraphicsPipeline> m_graphics_pipeline{ nullptr };
+        std::shared_ptr<vht::MeshPipeline> m_mesh_pipeline{ nullptr };
+        // 在管线对象之后声明，先析构并等待工作线程结束
+        std::shared_ptr<vht::PipelineBuilder> m_pipeline_builder{ nullptr };
         std::shared_ptr<vht::CommandPool> m_command_pool{ nullptr };
         std::shared_ptr<vht::InputAssembly> m_input_assembly{ nullptr };
+        std::shared_ptr<vht::MeshletAssembly> m_meshlet_assembly{ nullptr };
+        std::shared_ptr<vht::AssetLoader> m_asset_loader{ nullptr };
+        std::shared_ptr<vht::SceneLoader> m_scene_loader{ nullptr };
         std::shared_ptr<vht::UniformBuffer> m_uniform_buffer{ nullptr };
+        std::shared_ptr<vht::MipmapGenerator> m_mipmap_generator{ nullptr };
         std::shared_ptr<vht::TextureSampler> m_texture_sampler{ nullptr };
+        std::shared_ptr<vht::TextureStreamer> m_texture_streamer{ nullptr };
+        std::shared_ptr<vht::TextureLoader> m_texture_loader{ nullptr };
         std::shared_ptr<vht::Descriptor> m_descriptor{ nullptr };
+        std::shared_ptr<vht::ShaderReloader> m_shader_reloader{ nullptr };
         std::shared_ptr<vht::Drawer> m_drawer{ nullptr };
+        std::vector<std::future<vk::Pipeline>> m_pipeline_futures;
     public:
         void run() {
             init();
@@ -43,54 +75,131 @@ export namespace vht {
                 m_drawer->draw();
             }
             std::println("device waitIdle");
-            m_device->device().waitIdle();
+            m_device->wait_idle();
             std::println("finished");
         }
     private:
         void init() {
-            init_data_loader();
             init_context();
             init_window();
             std::println("window created");
             init_device();
             std::println("device created");
+            init_memory_allocator();
+            std::println("memory allocator created");
+            init_pipeline_cache();
+            std::println("pipeline cache created");
+            init_shader_manager();
+            std::println("shader manager created");
+            init_pipeline_builder();
+            std::println("pipeline builder created");
+            init_staging_ring();
+            std::println("staging ring created");
+            init_upload_batcher();
+            std::println("upload batcher created");
+            init_input_assembly();
+            std::println("input assembly created");
+            init_meshlet_assembly();
+            std::println("meshlet assembly created");
+            // 模型在后台加载，与其余初始化和渲染并行
+            init_asset_loader();
+            std::println("asset loader created");
+            // 默认纹理先注册，占用纹理表的 0 号槽位
+            init_texture_table();
+            std::println("texture table created");
+            init_mipmap_generator();
+            std::println("mipmap generator created");
+            init_texture_sampler();
+            std::println("texture sampler created");
+            init_texture_streamer();
+            std::println("texture streamer created");
+            init_texture_loader();
+            std::println("texture loader created");
+            init_scene_loader();
+            std::println("scene requested");
             init_swapchain();
             std::println("swapchain created");
             init_depth_image();
             std::println("depth image created");
             init_render_pass();
             std::println("render pass created");
+            init_pipeline_registry();
+            std::println("pipeline registry created");
             init_graphics_pipeline();
             std::println("graphics pipeline created");
+            init_mesh_pipeline();
+            std::println("mesh pipeline created");
+            // 图形管线在工作线程中并行编译，与其余初始化和上传等待重叠
+            submit_pipelines();
+            std::println("pipelines submitted");
             init_command_pool();
             std::println("command pool created");
             init_uniform_buffer();
             std::println("uniform buffer created");
-            init_texture_sampler();
-            std::println("texture sampler created");
-            init_input_assembly();
-            std::println("input assembly created");
+            finish_uploads();
+            std::println("uploads finished");
+            wait_pipelines();
+            std::println("pipelines created");
+            // 所有管线都已创建，计算管线在纹理加载需要时已经创建
+            save_pipeline_cache();
             init_descriptor();
             std::println("descriptor created");
+            init_shader_reloader();
+            std::println("shader reloader created");
             init_drawer();
             std::println("drawer created");
+            m_memory_allocator->print_stats();
         }
-        void init_data_loader() { m_data_loader = std::make_shared<vht::DataLoader>(); }
         void init_context() { m_context = std::make_shared<vht::Context>( true ); }
         void init_window() { m_window = std::make_shared<vht::Window>( m_context ); }
         void init_device() { m_device = std::make_shared<vht::Device>( m_context, m_window ); }
+        void init_memory_allocator() { m_memory_allocator = std::make_shared<vht::MemoryAllocator>( m_device ); }
+        void init_staging_ring() { m_staging_ring = std::make_shared<vht::StagingRing>( m_device, m_memory_allocator ); }
+        void init_upload_batcher() { m_upload_batcher = std::make_shared<vht::UploadBatcher>( m_device, m_staging_ring ); }
+        void init_pipeline_cache() { m_pipeline_cache = std::make_shared<vht::PipelineCache>( m_device ); }
+        void init_shader_manager() { m_shader_manager = std::make_shared<vht::ShaderManager>( m_device ); }
+        void init_pipeline_builder() { m_pipeline_builder = std::make_shared<vht::PipelineBuilder>(); }
+        void save_pipeline_cache() const {
+            m_pipeline_cache->save();
+            std::println("pipelines: {}/{} cache hits, {:.3f} ms",
+                m_pipeline_cache->hit_count(), m_pipeline_cache->pipeline_count(), m_pipeline_cache->total_time());
+            std::println("pipeline registry: {} hits, {} misses", m_pipeline_registry->hit_count(), m_pipeline_registry->miss_count());
+            std::println("shaders: {} from cache, {} compiled", m_shader_manager->cache_hits(), m_shader_manager->compile_count());
+        }
         void init_swapchain() { m_swapchain = std::make_shared<vht::Swapchain>( m_window, m_device ); }
-        void init_depth_image() { m_depth_image = std::make_shared<vht::DepthImage>( m_device, m_swapchain ); }
+        void init_depth_image() { m_depth_image = std::make_shared<vht::DepthImage>( m_device, m_memory_allocator, m_swapchain ); }
         void init_render_pass() { m_render_pass = std::make_shared<vht::RenderPass>( m_window, m_device, m_swapchain, m_depth_image ); }
-        void init_graphics_pipeline() { m_graphics_pipeline = std::make_shared<vht::GraphicsPipeline>( m_device, m_render_pass ); }
+        void init_texture_table() { m_texture_table = std::make_shared<vht::TextureTable>( m_device ); }
+        void init_pipeline_registry() { m_pipeline_registry = std::make_shared<vht::PipelineRegistry>( m_device, m_render_pass, m_pipeline_cache, m_shader_manager ); }
+        void init_graphics_pipeline() { m_graphics_pipeline = std::make_shared<vht::GraphicsPipeline>( m_device, m_pipeline_registry, m_texture_table ); }
+        void init_mesh_pipeline() { m_mesh_pipeline = std::make_shared<vht::MeshPipeline>( m_device, m_pipeline_registry, m_graphics_pipeline ); }
+        void submit_pipelines() {
+            std::vector<vht::PipelineDescription> batch{ m_graphics_pipeline->description() };
+            if (m_mesh_pipeline->supported()) batch.push_back(m_mesh_pipeline->description());
+            m_pipeline_futures = m_pipeline_builder->submit(std::move(batch));
+        }
+        // 管线创建失败时 get() 重新抛出异常，与同步创建时一样终止初始化
+        void wait_pipelines() {
+            m_graphics_pipeline->replace(m_pipeline_futures[0].get());
+            if (m_mesh_pipeline->supported()) m_mesh_pipeline->replace(m_pipeline_futures[1].get());
+            m_pipeline_futures.clear();
+        }
         void init_command_pool() { m_command_pool = std::make_shared<vht::CommandPool>( m_device ); }
-        void init_input_assembly() { m_input_assembly = std::make_shared<vht::InputAssembly>( m_data_loader, m_device, m_command_pool ); }
-        void init_uniform_buffer() { m_uniform_buffer = std::make_shared<vht::UniformBuffer>( m_window, m_device, m_swapchain ); }
-        void init_texture_sampler() { m_texture_sampler = std::make_shared<vht::TextureSampler>( m_device, m_command_pool ); }
-        void init_descriptor() { m_descriptor = std::make_shared<vht::Descriptor>( m_device, m_graphics_pipeline, m_uniform_buffer, m_texture_sampler ); }
+        void init_input_assembly() { m_input_assembly = std::make_shared<vht::InputAssembly>( m_device, m_memory_allocator ); }
+        void init_meshlet_assembly() { m_meshlet_assembly = std::make_shared<vht::MeshletAssembly>( m_device, m_memory_allocator ); }
+        void init_asset_loader() { m_asset_loader = std::make_shared<vht::AssetLoader>( m_device, m_memory_allocator, m_input_assembly, m_meshlet_assembly ); }
+        void init_scene_loader() { m_scene_loader = std::make_shared<vht::SceneLoader>( m_asset_loader, m_texture_loader ); }
+        void init_uniform_buffer() { m_uniform_buffer = std::make_shared<vht::UniformBuffer>( m_window, m_device, m_memory_allocator, m_swapchain ); }
+        void init_mipmap_generator() { m_mipmap_generator = std::make_shared<vht::MipmapGenerator>( m_device, m_pipeline_cache, m_shader_manager ); }
+        void init_texture_sampler() { m_texture_sampler = std::make_shared<vht::TextureSampler>( m_device, m_memory_allocator, m_upload_batcher, m_mipmap_generator, m_texture_table ); }
+        void init_texture_streamer() { m_texture_streamer = std::make_shared<vht::TextureStreamer>( m_device, m_memory_allocator, m_texture_table ); }
+        void init_texture_loader() { m_texture_loader = std::make_shared<vht::TextureLoader>( m_device, m_memory_allocator, m_upload_batcher, m_mipmap_generator, m_texture_table, m_texture_streamer ); }
+        void init_descriptor() { m_descriptor = std::make_shared<vht::Descriptor>( m_device, m_graphics_pipeline, m_uniform_buffer, m_texture_table, m_input_assembly, m_meshlet_assembly, m_mesh_pipeline ); }
+        // 纹理的上传命令合并为一次提交，只等待这一次；模型由 m_asset_loader 在后台上传
+        void finish_uploads() const { m_upload_batcher->wait( m_upload_batcher->submit() ); }
+        void init_shader_reloader() { m_shader_reloader = std::make_shared<vht::ShaderReloader>( m_graphics_pipeline, m_mesh_pipeline, m_pipeline_builder, m_pipeline_registry ); }
         void init_drawer() {
             m_drawer = std::make_shared<vht::Drawer>(
-                m_data_loader,
                 m_window,
                 m_device,
                 m_swapchain,
@@ -99,7 +208,12 @@ export namespace vht {
                 m_command_pool,
                 m_input_assembly,
                 m_uniform_buffer,
-                m_descriptor
+                m_descriptor,
+                m_mesh_pipeline,
+                m_meshlet_assembly,
+                m_asset_loader,
+                m_texture_streamer,
+                m_shader_reloader
             );
         }
     };
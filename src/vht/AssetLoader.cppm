@@ -0,0 +1,151 @@
+export module AssetLoader;
+
+import std;
+import vulkan_hpp;
+import glm;
+
+import DataLoader;
+import Device;
+import MemoryAllocator;
+import StagingRing;
+import UploadBatcher;
+import InputAssembly;
+import MeshletAssembly;
+import Meshlet;
+import TextureTable;
+
+export namespace vht {
+
+    /**
+     * @brief 后台模型加载
+     * @details
+     * - 依赖：
+     *  - m_device: 逻辑设备与队列
+     *  - m_allocator: 设备内存分配器
+     *  - m_input_assembly: 共享的顶点缓冲和索引缓冲
+     *  - m_meshlet_assembly: meshlet 缓冲区
+     * - 工作：
+     *  - request() 按路径请求加载模型，立即返回，绘制使用请求时指定的纹理槽位
+     *  - 加载线程依次解析模型、构建 meshlet，并用自己的暂存环和上传批处理上传到共享缓冲区
+     *  - poll() 由主线程每帧调用，只查询时间线信号量的当前值，不等待；
+     *    上传完成的网格此时才加入 InputAssembly 与 MeshletAssembly 的绘制列表
+     *  - 绘制提交需等待 semaphore() 到达 ready_value()，该值已经到达，等待不会阻塞，
+     *    只用于建立上传与绘制之间的内存依赖
+     *  - 析构时停止加载线程，并等待已提交的上传完成
+     * - 可访问成员：
+     *  - semaphore(): 上传时间线信号量
+     *  - ready_value(): 已加入绘制列表的网格对应的时间线值
+     */
+    class AssetLoader {
+        struct Request {
+            std::filesystem::path path;
+            glm::mat4 transform{ 1.0f };
+            TextureSlot texture{};
+        };
+        struct Loaded {
+            MeshDraw draw;
+            std::vector<MeshletRange> meshlets;
+            std::uint64_t value{};
+        };
+        std::shared_ptr<vht::Device> m_device{ nullptr };
+        std::shared_ptr<vht::MemoryAllocator> m_allocator{ nullptr };
+        std::shared_ptr<vht::InputAssembly> m_input_assembly{ nullptr };
+        std::shared_ptr<vht::MeshletAssembly> m_meshlet_assembly{ nullptr };
+        std::shared_ptr<vht::StagingRing> m_staging_ring{ nullptr };
+        std::shared_ptr<vht::UploadBatcher> m_upload_batcher{ nullptr };
+        std::mutex m_mutex;
+        std::condition_variable_any m_condition;
+        std::deque<Request> m_requests;     // 由 m_mutex 保护
+        std::vector<Loaded> m_loaded;       // 由 m_mutex 保护
+        std::uint64_t m_ready_value{ 0 };
+        std::jthread m_worker;
+    public:
+        explicit AssetLoader(
+            std::shared_ptr<vht::Device> device,
+            std::shared_ptr<vht::MemoryAllocator> allocator,
+            std::shared_ptr<vht::InputAssembly> input_assembly,
+            std::shared_ptr<vht::MeshletAssembly> meshlet_assembly
+        ):  m_device(std::move(device)),
+            m_allocator(std::move(allocator)),
+            m_input_assembly(std::move(input_assembly)),
+            m_meshlet_assembly(std::move(meshlet_assembly)) {
+            init();
+        }
+        ~AssetLoader() {
+            m_worker.request_stop();
+            m_worker.join();
+            m_upload_batcher->wait(m_upload_batcher->submitted_value());
+        }
+        AssetLoader(const AssetLoader&) = delete;
+        AssetLoader& operator=(const AssetLoader&) = delete;
+
+        [[nodiscard]]
+        const vk::raii::Semaphore& semaphore() const { return m_staging_ring->semaphore(); }
+        [[nodiscard]]
+        std::uint64_t ready_value() const { return m_ready_value; }
+
+        // 请求加载模型
+        void request(std::filesystem::path path, const glm::mat4& transform, const TextureSlot texture = {}) {
+            {
+                const std::scoped_lock lock{ m_mutex };
+                m_requests.emplace_back(std::move(path), transform, texture);
+            }
+            m_condition.notify_one();
+        }
+
+        // 把上传完成的网格加入绘制列表，只能在主线程调用
+        void poll() {
+            const std::uint64_t completed = m_staging_ring->completed_value();
+            const std::scoped_lock lock{ m_mutex };
+            // 加载线程按提交顺序追加，时间线值单调递增
+            auto ready_end = m_loaded.begin();
+            while (ready_end != m_loaded.end() && ready_end->value <= completed) ++ready_end;
+            for (auto& loaded : std::ranges::subrange(m_loaded.begin(), ready_end)) {
+                m_input_assembly->add_draw(std::move(loaded.draw));
+                m_meshlet_assembly->add_ranges(std::move(loaded.meshlets));
+                m_ready_value = std::max(m_ready_value, loaded.value);
+            }
+            m_loaded.erase(m_loaded.begin(), ready_end);
+        }
+
+    private:
+        void init() {
+            m_staging_ring = std::make_shared<vht::StagingRing>(m_device, m_allocator);
+            m_upload_batcher = std::make_shared<vht::UploadBatcher>(m_device, m_staging_ring);
+            m_worker = std::jthread([this](const std::stop_token& stop) { run(stop); });
+        }
+        // 加载线程：逐个处理请求，直到被要求停止
+        void run(const std::stop_token& stop) {
+            while (true) {
+                Request request;
+                {
+                    std::unique_lock lock{ m_mutex };
+                    if (!m_condition.wait(lock, stop, [this] { return !m_requests.empty(); })) return;
+                    request = std::move(m_requests.front());
+                    m_requests.pop_front();
+                }
+                try {
+                    load(request);
+                } catch (const std::exception& e) {
+                    std::println("failed to load model {}: {}", request.path.generic_string(), e.what());
+                }
+            }
+        }
+        // 解析并上传一个模型，提交后不等待
+        void load(const Request& request) {
+            const vht::DataLoader data{ request.path };
+            // 先确认 meshlet 容量，放不下时还没有在任何缓冲区中预留空间
+            auto meshlets = m_meshlet_assembly->prepare_mesh(data);
+            Loaded loaded;
+            loaded.draw = m_input_assembly->upload_mesh(data, *m_upload_batcher);
+            loaded.draw.transform = request.transform;
+            loaded.draw.texture_index = request.texture.texture;
+            loaded.draw.sampler_index = request.texture.sampler;
+            loaded.meshlets = m_meshlet_assembly->upload_mesh(std::move(meshlets), *m_upload_batcher);
+            loaded.value = m_upload_batcher->submit();
+            const std::scoped_lock lock{ m_mutex };
+            m_loaded.emplace_back(std::move(loaded));
+        }
+    };
+
+}
@@ -0,0 +1,546 @@
+module;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VHT_SIMD_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define VHT_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+export module BlockCompressor;
+
+import std;
+import vulkan_hpp;
+
+import Config;
+
+namespace vht {
+
+    /**
+     * @brief 4 个 float 组成的 SIMD 向量
+     * @details x86 上使用 SSE2，ARM 上使用 NEON，其余平台逐分量计算；
+     * 用于同时处理一个像素的 4 个通道，或一个通道上的 4 个调色板颜色
+     */
+    struct Float4 {
+#if defined(VHT_SIMD_SSE2)
+        __m128 value;
+#elif defined(VHT_SIMD_NEON)
+        float32x4_t value;
+#else
+        std::array<float, 4> value;
+#endif
+    };
+
+    [[nodiscard]]
+    Float4 load4(const float* data) {
+#if defined(VHT_SIMD_SSE2)
+        return { _mm_loadu_ps(data) };
+#elif defined(VHT_SIMD_NEON)
+        return { vld1q_f32(data) };
+#else
+        return { { data[0], data[1], data[2], data[3] } };
+#endif
+    }
+
+    [[nodiscard]]
+    Float4 splat4(const float value) {
+#if defined(VHT_SIMD_SSE2)
+        return { _mm_set1_ps(value) };
+#elif defined(VHT_SIMD_NEON)
+        return { vdupq_n_f32(value) };
+#else
+        return { { value, value, value, value } };
+#endif
+    }
+
+    void store4(float* data, const Float4 v) {
+#if defined(VHT_SIMD_SSE2)
+        _mm_storeu_ps(data, v.value);
+#elif defined(VHT_SIMD_NEON)
+        vst1q_f32(data, v.value);
+#else
+        std::copy_n(v.value.begin(), 4, data);
+#endif
+    }
+
+    [[nodiscard]]
+    Float4 operator+(const Float4 a, const Float4 b) {
+#if defined(VHT_SIMD_SSE2)
+        return { _mm_add_ps(a.value, b.value) };
+#elif defined(VHT_SIMD_NEON)
+        return { vaddq_f32(a.value, b.value) };
+#else
+        return { { a.value[0] + b.value[0], a.value[1] + b.value[1], a.value[2] + b.value[2], a.value[3] + b.value[3] } };
+#endif
+    }
+
+    [[nodiscard]]
+    Float4 operator-(const Float4 a, const Float4 b) {
+#if defined(VHT_SIMD_SSE2)
+        return { _mm_sub_ps(a.value, b.value) };
+#elif defined(VHT_SIMD_NEON)
+        return { vsubq_f32(a.value, b.value) };
+#else
+        return { { a.value[0] - b.value[0], a.value[1] - b.value[1], a.value[2] - b.value[2], a.value[3] - b.value[3] } };
+#endif
+    }
+
+    [[nodiscard]]
+    Float4 operator*(const Float4 a, const Float4 b) {
+#if defined(VHT_SIMD_SSE2)
+        return { _mm_mul_ps(a.value, b.value) };
+#elif defined(VHT_SIMD_NEON)
+        return { vmulq_f32(a.value, b.value) };
+#else
+        return { { a.value[0] * b.value[0], a.value[1] * b.value[1], a.value[2] * b.value[2], a.value[3] * b.value[3] } };
+#endif
+    }
+
+    // 一个 4x4 块的像素，按行排列，每个通道为 0~255 的浮点数
+    using BlockTexels = std::array<std::array<float, 4>, 16>;
+
+    // BC7 4 位索引的插值权重
+    constexpr std::array<std::uint32_t, 16> BC7_WEIGHTS{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    /**
+     * @brief 读取 (block_x, block_y) 处的块
+     * @details 图像尺寸不是 4 的倍数时重复边缘像素，越界的像素不影响端点
+     */
+    [[nodiscard]]
+    BlockTexels load_block(
+        const std::span<const std::byte> rgba,
+        const std::uint32_t width,
+        const std::uint32_t height,
+        const std::uint32_t block_x,
+        const std::uint32_t block_y
+    ) {
+        BlockTexels texels{};
+        for (std::uint32_t y = 0; y < 4; ++y) {
+            const std::uint32_t py = std::min(block_y * 4 + y, height - 1);
+            for (std::uint32_t x = 0; x < 4; ++x) {
+                const std::uint32_t px = std::min(block_x * 4 + x, width - 1);
+                const std::byte* texel = rgba.data() + (static_cast<std::size_t>(py) * width + px) * 4;
+                for (std::size_t c = 0; c < 4; ++c) {
+                    texels[y * 4 + x][c] = static_cast<float>(std::to_integer<std::uint8_t>(texel[c]));
+                }
+            }
+        }
+        return texels;
+    }
+
+    /**
+     * @brief 沿主轴求块的初始端点
+     * @details 用幂迭代求前 N 个通道协方差矩阵的主特征向量，取投影的最小值与最大值
+     * @return {主轴负方向端点, 主轴正方向端点}
+     */
+    template<std::size_t N>
+    [[nodiscard]]
+    std::pair<std::array<float, 4>, std::array<float, 4>> principal_endpoints(const BlockTexels& texels) {
+        // 均值与协方差按像素的 4 个通道一起计算，N 为 3 时忽略 alpha 分量
+        Float4 sum = splat4(0.0f);
+        for (const auto& texel : texels) sum = sum + load4(texel.data());
+        const Float4 mean4 = sum * splat4(1.0f / 16.0f);
+        std::array<float, 4> mean{};
+        store4(mean.data(), mean4);
+
+        std::array<Float4, N> rows{};
+        rows.fill(splat4(0.0f));
+        for (const auto& texel : texels) {
+            const Float4 d = load4(texel.data()) - mean4;
+            std::array<float, 4> components{};
+            store4(components.data(), d);
+            for (std::size_t i = 0; i < N; ++i) rows[i] = rows[i] + splat4(components[i]) * d;
+        }
+        std::array<std::array<float, N>, N> covariance{};
+        for (std::size_t i = 0; i < N; ++i) {
+            std::array<float, 4> row{};
+            store4(row.data(), rows[i]);
+            for (std::size_t j = 0; j < N; ++j) covariance[i][j] = row[j];
+        }
+
+        std::array<float, N> axis{};
+        axis.fill(1.0f);
+        for (int iteration = 0; iteration < 8; ++iteration) {
+            std::array<float, N> next{};
+            for (std::size_t i = 0; i < N; ++i) {
+                for (std::size_t j = 0; j < N; ++j) next[i] += covariance[i][j] * axis[j];
+            }
+            float length = 0.0f;
+            for (const float v : next) length = std::max(length, std::abs(v));
+            if (length < 1e-6f) break;
+            for (std::size_t c = 0; c < N; ++c) axis[c] = next[c] / length;
+        }
+
+        float min_t = std::numeric_limits<float>::max();
+        float max_t = std::numeric_limits<float>::lowest();
+        float axis_length2 = 0.0f;
+        for (const float v : axis) axis_length2 += v * v;
+        for (const auto& texel : texels) {
+            float t = 0.0f;
+            for (std::size_t c = 0; c < N; ++c) t += (texel[c] - mean[c]) * axis[c];
+            min_t = std::min(min_t, t);
+            max_t = std::max(max_t, t);
+        }
+        std::array<float, 4> low{ 255.0f, 255.0f, 255.0f, 255.0f };
+        std::array<float, 4> high{ 255.0f, 255.0f, 255.0f, 255.0f };
+        for (std::size_t c = 0; c < N; ++c) {
+            low[c] = std::clamp(mean[c] + axis[c] * min_t / axis_length2, 0.0f, 255.0f);
+            high[c] = std::clamp(mean[c] + axis[c] * max_t / axis_length2, 0.0f, 255.0f);
+        }
+        return { low, high };
+    }
+
+    /**
+     * @brief 固定索引后用最小二乘重新拟合端点
+     * @param weights 每个像素在两个端点间的插值权重，0 对应 a，1 对应 b
+     * @return 退化（所有权重相同）时返回 std::nullopt
+     */
+    template<std::size_t N>
+    [[nodiscard]]
+    std::optional<std::pair<std::array<float, 4>, std::array<float, 4>>> refit_endpoints(
+        const BlockTexels& texels,
+        const std::array<float, 16>& weights
+    ) {
+        float alpha2 = 0.0f, beta2 = 0.0f, alpha_beta = 0.0f;
+        std::array<float, N> alpha_x{}, beta_x{};
+        for (std::size_t i = 0; i < 16; ++i) {
+            const float beta = weights[i];
+            const float alpha = 1.0f - beta;
+            alpha2 += alpha * alpha;
+            beta2 += beta * beta;
+            alpha_beta += alpha * beta;
+            for (std::size_t c = 0; c < N; ++c) {
+                alpha_x[c] += alpha * texels[i][c];
+                beta_x[c] += beta * texels[i][c];
+            }
+        }
+        const float det = alpha2 * beta2 - alpha_beta * alpha_beta;
+        if (std::abs(det) < 1e-6f) return std::nullopt;
+        std::array<float, 4> a{ 255.0f, 255.0f, 255.0f, 255.0f };
+        std::array<float, 4> b{ 255.0f, 255.0f, 255.0f, 255.0f };
+        for (std::size_t c = 0; c < N; ++c) {
+            a[c] = std::clamp((alpha_x[c] * beta2 - beta_x[c] * alpha_beta) / det, 0.0f, 255.0f);
+            b[c] = std::clamp((beta_x[c] * alpha2 - alpha_x[c] * alpha_beta) / det, 0.0f, 255.0f);
+        }
+        return std::pair{ a, b };
+    }
+
+    /**
+     * @brief 为每个像素选择调色板中最近的颜色，返回总误差
+     * @details 调色板按通道转置后，一次计算一个像素到 4 个颜色的误差；误差相同时取下标较小的颜色
+     */
+    template<std::size_t N, std::size_t P>
+    float select_indices(
+        const BlockTexels& texels,
+        const std::array<std::array<float, 4>, P>& palette,
+        std::array<std::uint32_t, 16>& indices
+    ) {
+        static_assert(P % 4 == 0);
+        std::array<std::array<float, P>, N> channels{};
+        for (std::size_t p = 0; p < P; ++p) {
+            for (std::size_t c = 0; c < N; ++c) channels[c][p] = palette[p][c];
+        }
+        float total = 0.0f;
+        for (std::size_t i = 0; i < 16; ++i) {
+            float best = std::numeric_limits<float>::max();
+            for (std::size_t p = 0; p < P; p += 4) {
+                Float4 error = splat4(0.0f);
+                for (std::size_t c = 0; c < N; ++c) {
+                    const Float4 d = splat4(texels[i][c]) - load4(channels[c].data() + p);
+                    error = error + d * d;
+                }
+                std::array<float, 4> errors{};
+                store4(errors.data(), error);
+                for (std::size_t k = 0; k < 4; ++k) {
+                    if (errors[k] < best) {
+                        best = errors[k];
+                        indices[i] = static_cast<std::uint32_t>(p + k);
+                    }
+                }
+            }
+            total += best;
+        }
+        return total;
+    }
+
+    // BC1 端点：RGB565 与其展开后的 8 位颜色
+    struct Bc1Endpoint {
+        std::uint16_t packed{};
+        std::array<float, 4> color{};
+    };
+
+    [[nodiscard]]
+    Bc1Endpoint quantize_565(const std::array<float, 4>& color) {
+        const auto r = static_cast<std::uint32_t>(std::lround(color[0] * 31.0f / 255.0f));
+        const auto g = static_cast<std::uint32_t>(std::lround(color[1] * 63.0f / 255.0f));
+        const auto b = static_cast<std::uint32_t>(std::lround(color[2] * 31.0f / 255.0f));
+        return {
+            static_cast<std::uint16_t>(r << 11 | g << 5 | b),
+            {
+                static_cast<float>(r << 3 | r >> 2),
+                static_cast<float>(g << 2 | g >> 4),
+                static_cast<float>(b << 3 | b >> 2),
+                255.0f
+            }
+        };
+    }
+
+    // 以 c0 > c1 的四色模式编码，返回块数据与误差
+    [[nodiscard]]
+    std::pair<std::array<std::byte, 8>, float> encode_bc1_endpoints(
+        const BlockTexels& texels,
+        const std::array<float, 4>& low,
+        const std::array<float, 4>& high,
+        std::array<float, 16>& weights
+    ) {
+        auto e0 = quantize_565(high);
+        auto e1 = quantize_565(low);
+        if (e0.packed < e1.packed) std::swap(e0, e1);
+
+        std::array<std::uint32_t, 16> indices{};
+        float error = 0.0f;
+        if (e0.packed == e1.packed) {
+            // 两个端点相同时 c0 > c1 不成立，全部使用索引 0
+            for (const auto& texel : texels) {
+                for (std::size_t c = 0; c < 3; ++c) error += (texel[c] - e0.color[c]) * (texel[c] - e0.color[c]);
+            }
+            weights.fill(0.0f);
+        } else {
+            std::array<std::array<float, 4>, 4> palette{ e0.color, e1.color, {}, {} };
+            for (std::size_t c = 0; c < 3; ++c) {
+                palette[2][c] = (2.0f * e0.color[c] + e1.color[c]) / 3.0f;
+                palette[3][c] = (e0.color[c] + 2.0f * e1.color[c]) / 3.0f;
+            }
+            error = select_indices<3>(texels, palette, indices);
+            constexpr std::array<float, 4> INDEX_WEIGHTS{ 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+            for (std::size_t i = 0; i < 16; ++i) weights[i] = INDEX_WEIGHTS[indices[i]];
+        }
+
+        std::uint32_t bits = 0;
+        for (std::size_t i = 0; i < 16; ++i) bits |= indices[i] << (i * 2);
+        std::array<std::byte, 8> block{};
+        std::memcpy(block.data(), &e0.packed, 2);
+        std::memcpy(block.data() + 2, &e1.packed, 2);
+        std::memcpy(block.data() + 4, &bits, 4);
+        return { block, error };
+    }
+
+    /**
+     * @brief 编码一个 BC1 块（不透明 RGB）
+     * @details 主轴端点编码后用最小二乘重新拟合一次，保留误差较小的结果
+     */
+    void encode_bc1_block(const BlockTexels& texels, std::byte* out) {
+        const auto [low, high] = principal_endpoints<3>(texels);
+        std::array<float, 16> weights{};
+        auto [block, error] = encode_bc1_endpoints(texels, low, high, weights);
+        // weights 以 c0 为 0、c1 为 1，拟合结果中 a 对应 c0
+        if (const auto refit = refit_endpoints<3>(texels, weights)) {
+            std::array<float, 16> refit_weights{};
+            const auto [refit_block, refit_error] = encode_bc1_endpoints(texels, refit->second, refit->first, refit_weights);
+            if (refit_error < error) block = refit_block;
+        }
+        std::memcpy(out, block.data(), block.size());
+    }
+
+    // BC7 块的位写入器，从最低位开始
+    struct BitWriter {
+        std::array<std::uint64_t, 2> words{};
+        std::uint32_t position{};
+        void write(const std::uint64_t value, const std::uint32_t bits) {
+            for (std::uint32_t i = 0; i < bits; ++i, ++position) {
+                words[position / 64] |= (value >> i & 1ull) << (position % 64);
+            }
+        }
+    };
+
+    // BC7 模式 6 的端点：每通道 7 位加一个共享的 p 位
+    struct Bc7Endpoint {
+        std::array<std::uint32_t, 4> quantized{};
+        std::uint32_t p_bit{};
+        std::array<float, 4> color{};
+    };
+
+    // 分别尝试 p 位为 0 和 1，保留误差较小的量化结果
+    [[nodiscard]]
+    Bc7Endpoint quantize_bc7(const std::array<float, 4>& color) {
+        Bc7Endpoint best;
+        float best_error = std::numeric_limits<float>::max();
+        for (std::uint32_t p = 0; p < 2; ++p) {
+            Bc7Endpoint candidate{ {}, p, {} };
+            float error = 0.0f;
+            for (std::size_t c = 0; c < 4; ++c) {
+                const auto q = static_cast<std::uint32_t>(std::clamp(std::lround((color[c] - static_cast<float>(p)) / 2.0f), 0l, 127l));
+                candidate.quantized[c] = q;
+                candidate.color[c] = static_cast<float>(q << 1 | p);
+                error += (candidate.color[c] - color[c]) * (candidate.color[c] - color[c]);
+            }
+            if (error < best_error) {
+                best_error = error;
+                best = candidate;
+            }
+        }
+        return best;
+    }
+
+    [[nodiscard]]
+    std::pair<BitWriter, float> encode_bc7_endpoints(
+        const BlockTexels& texels,
+        const std::array<float, 4>& a,
+        const std::array<float, 4>& b,
+        std::array<float, 16>& weights
+    ) {
+        auto e0 = quantize_bc7(a);
+        auto e1 = quantize_bc7(b);
+        std::array<std::array<float, 4>, 16> palette{};
+        for (std::size_t i = 0; i < 16; ++i) {
+            for (std::size_t c = 0; c < 4; ++c) {
+                const auto v0 = static_cast<std::uint32_t>(e0.color[c]);
+                const auto v1 = static_cast<std::uint32_t>(e1.color[c]);
+                palette[i][c] = static_cast<float>(((64 - BC7_WEIGHTS[i]) * v0 + BC7_WEIGHTS[i] * v1 + 32) >> 6);
+            }
+        }
+        std::array<std::uint32_t, 16> indices{};
+        const float error = select_indices<4>(texels, palette, indices);
+        for (std::size_t i = 0; i < 16; ++i) weights[i] = static_cast<float>(BC7_WEIGHTS[indices[i]]) / 64.0f;
+
+        // 第 0 个像素的索引最高位隐含为 0，不满足时交换端点并翻转索引
+        if (indices[0] & 8) {
+            std::swap(e0, e1);
+            for (auto& index : indices) index = 15 - index;
+        }
+
+        BitWriter writer;
+        writer.write(1u << 6, 7);
+        for (std::size_t c = 0; c < 4; ++c) {
+            writer.write(e0.quantized[c], 7);
+            writer.write(e1.quantized[c], 7);
+        }
+        writer.write(e0.p_bit, 1);
+        writer.write(e1.p_bit, 1);
+        writer.write(indices[0], 3);
+        for (std::size_t i = 1; i < 16; ++i) writer.write(indices[i], 4);
+        return { writer, error };
+    }
+
+    /**
+     * @brief 编码一个 BC7 块
+     * @details 只使用模式 6（单分区，RGBA 7.7.7.7 端点加 p 位，4 位索引），
+     * 主轴端点编码后用最小二乘重新拟合一次，保留误差较小的结果
+     */
+    void encode_bc7_block(const BlockTexels& texels, std::byte* out) {
+        const auto [low, high] = principal_endpoints<4>(texels);
+        std::array<float, 16> weights{};
+        auto [writer, error] = encode_bc7_endpoints(texels, low, high, weights);
+        if (const auto refit = refit_endpoints<4>(texels, weights)) {
+            std::array<float, 16> refit_weights{};
+            const auto [refit_writer, refit_error] = encode_bc7_endpoints(texels, refit->first, refit->second, refit_weights);
+            if (refit_error < error) writer = refit_writer;
+        }
+        std::memcpy(out, writer.words.data(), 16);
+    }
+
+    /**
+     * @brief 将块行分给多个线程编码
+     * @details 块之间没有依赖，每个线程按行交错处理，写入不重叠的输出区域
+     */
+    template<typename Function>
+    void parallel_rows(const std::uint32_t rows, Function&& function) {
+        // rows 为 0 时 std::clamp 的下界大于上界，先取最小值再保证至少一个线程
+        const std::uint32_t thread_count = std::max(1u, std::min(std::thread::hardware_concurrency(), rows));
+        if (thread_count == 1) {
+            for (std::uint32_t row = 0; row < rows; ++row) function(row);
+            return;
+        }
+        std::vector<std::jthread> workers;
+        workers.reserve(thread_count);
+        for (std::uint32_t t = 0; t < thread_count; ++t) {
+            workers.emplace_back([&function, rows, thread_count, t] {
+                for (std::uint32_t row = t; row < rows; row += thread_count) function(row);
+            });
+        }
+    }
+
+}
+
+export namespace vht {
+
+    // 压缩格式对应的 Vulkan 格式，颜色均按 sRGB 解释
+    [[nodiscard]]
+    vk::Format texture_format(const TextureCompression compression) {
+        switch (compression) {
+            case TextureCompression::eBC1: return vk::Format::eBc1RgbSrgbBlock;
+            case TextureCompression::eBC7: return vk::Format::eBc7SrgbBlock;
+            default: return vk::Format::eR8G8B8A8Srgb;
+        }
+    }
+
+    // 块压缩格式每个 4x4 块的字节数，非块压缩格式返回 0
+    [[nodiscard]]
+    std::uint32_t block_bytes(const vk::Format format) {
+        switch (format) {
+            case vk::Format::eBc1RgbSrgbBlock:
+            case vk::Format::eBc1RgbUnormBlock:
+                return 8;
+            case vk::Format::eBc7SrgbBlock:
+            case vk::Format::eBc7UnormBlock:
+                return 16;
+            default:
+                return 0;
+        }
+    }
+
+    [[nodiscard]]
+    bool is_block_compressed(const vk::Format format) {
+        return block_bytes(format) != 0;
+    }
+
+    /**
+     * @brief 一个层级的数据大小
+     * @details 块压缩格式按整块计算，尺寸不是 4 的倍数时向上取整；其余格式按 RGBA8 计算
+     */
+    [[nodiscard]]
+    std::uint64_t level_size(const vk::Format format, const std::uint32_t width, const std::uint32_t height) {
+        if (const auto bytes = block_bytes(format)) {
+            return static_cast<std::uint64_t>((width + 3) / 4) * ((height + 3) / 4) * bytes;
+        }
+        return static_cast<std::uint64_t>(width) * height * 4;
+    }
+
+    /**
+     * @brief 将一层 RGBA8 像素压缩为块压缩格式
+     * @details
+     * - BC1 忽略 alpha，只用于不透明纹理
+     * - BC7 只使用模式 6，质量与速度之间取折中
+     * - 块行在多个线程间并行编码；端点的协方差与索引选择的误差使用 SSE2/NEON 计算
+     * @param format eBc1RgbSrgbBlock 或 eBc7SrgbBlock
+     * @throw std::invalid_argument 不支持的格式或数据大小不匹配
+     */
+    [[nodiscard]]
+    std::vector<std::byte> compress_level(
+        const vk::Format format,
+        const std::span<const std::byte> rgba,
+        const std::uint32_t width,
+        const std::uint32_t height
+    ) {
+        const auto bytes = block_bytes(format);
+        if (bytes == 0) throw std::invalid_argument("unsupported block compression format!");
+        if (rgba.size() != static_cast<std::size_t>(width) * height * 4) {
+            throw std::invalid_argument("pixel data size does not match the level size!");
+        }
+        const std::uint32_t blocks_x = (width + 3) / 4;
+        const std::uint32_t blocks_y = (height + 3) / 4;
+        std::vector<std::byte> result(level_size(format, width, height));
+        const bool bc7 = bytes == 16;
+        parallel_rows(blocks_y, [&](const std::uint32_t block_y) {
+            for (std::uint32_t block_x = 0; block_x < blocks_x; ++block_x) {
+                const auto texels = load_block(rgba, width, height, block_x, block_y);
+                std::byte* out = result.data() + (static_cast<std::size_t>(block_y) * blocks_x + block_x) * bytes;
+                if (bc7) encode_bc7_block(texels, out);
+                else encode_bc1_block(texels, out);
+            }
+        });
+        return result;
+    }
+
+}
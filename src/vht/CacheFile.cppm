@@ -0,0 +1,103 @@
+export module CacheFile;
+
+import std;
+
+export namespace vht {
+
+    // FNV-1a，结果不依赖标准库实现，可以写入文件
+    [[nodiscard]]
+    std::uint64_t hash_string(const std::string_view text) {
+        std::uint64_t hash = 0xcbf29ce484222325ull;
+        for (const char c : text) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    [[nodiscard]]
+    std::uint64_t align_up(const std::uint64_t value, const std::uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    /**
+     * @brief 缓存对应的源文件的键，任一项变化时缓存失效
+     * @details
+     * - hash: 源文件绝对路径的哈希
+     * - size: 源文件大小
+     * - mtime: 源文件修改时间
+     */
+    struct SourceKey {
+        std::uint64_t hash{};
+        std::uint64_t size{};
+        std::int64_t mtime{};
+        bool operator==(const SourceKey&) const = default;
+    };
+
+    /**
+     * @brief 读取源文件的键
+     * @return 源文件不存在或无法读取时返回 std::nullopt，不抛出异常
+     */
+    [[nodiscard]]
+    std::optional<SourceKey> source_key(const std::filesystem::path& source) {
+        std::error_code ec;
+        const auto absolute = std::filesystem::absolute(source, ec);
+        if (ec) return std::nullopt;
+        const auto size = std::filesystem::file_size(source, ec);
+        if (ec) return std::nullopt;
+        const auto mtime = std::filesystem::last_write_time(source, ec);
+        if (ec) return std::nullopt;
+        return SourceKey{ hash_string(absolute.generic_string()), size, mtime.time_since_epoch().count() };
+    }
+
+    // 源文件对应的缓存文件路径：cache/<directory>/<文件名>-<路径哈希>.<extension>
+    [[nodiscard]]
+    std::filesystem::path cache_path(const std::filesystem::path& source, const std::string_view directory, const std::string_view extension) {
+        const std::string key = std::filesystem::absolute(source).generic_string();
+        return std::filesystem::path("cache") / directory /
+            std::format("{}-{:016x}.{}", source.stem().string(), hash_string(key), extension);
+    }
+
+    /**
+     * @brief 写入缓存文件
+     * @details 先写临时文件再重命名，中途失败不会留下损坏的缓存；临时文件名包含线程标识，
+     * 多个线程同时写入同一缓存时互不覆盖，最后重命名的生效；失败时只打印警告
+     * @param write 写入文件内容，返回后检查流状态
+     * @return 是否写入成功
+     */
+    bool write_cache_file(const std::filesystem::path& path, const std::function<void(std::ofstream&)>& write) {
+        auto temp_path = path;
+        temp_path += std::format(".{:x}.tmp", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                std::println("failed to write cache: {}", path.string());
+                return false;
+            }
+            write(file);
+            if (!file) {
+                file.close();
+                std::filesystem::remove(temp_path, ec);
+                std::println("failed to write cache: {}", path.string());
+                return false;
+            }
+        }
+        std::filesystem::rename(temp_path, path, ec);
+        if (ec) {
+            std::filesystem::remove(temp_path, ec);
+            std::println("failed to write cache: {}", path.string());
+            return false;
+        }
+        return true;
+    }
+
+    // 用 0 填充到 offset，offset 与当前位置之差不能超过 64 字节
+    void pad_to(std::ofstream& file, const std::uint64_t offset) {
+        static constexpr std::array<char, 64> zeros{};
+        const auto position = static_cast<std::uint64_t>(file.tellp());
+        file.write(zeros.data(), static_cast<std::streamsize>(offset - position));
+    }
+
+}
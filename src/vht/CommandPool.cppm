@@ -30,7 +30,7 @@ export namespace vht {
 
     private:
         void init() {
-            const auto [graphics_family, present_family] = m_device->queue_family_indices();
+            const auto [graphics_family, present_family, transfer_family] = m_device->queue_family_indices();
 
             vk::CommandPoolCreateInfo create_info;
             create_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
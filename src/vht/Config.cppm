@@ -3,6 +3,71 @@ export module Config;
 import std;
 
 export namespace vht {
+    /**
+     * @brief GPU 顶点布局
+     * @details
+     * - eFloat: 32 位浮点位置与纹理坐标
+     * - eCompact: 16 位 UNORM 位置与半精度纹理坐标
+     */
+    enum class VertexLayout {
+        eFloat,
+        eCompact
+    };
+    /**
+     * @brief 纹理压缩格式
+     * @details
+     * - eNone: 不压缩，RGBA8 sRGB
+     * - eBC1: 不透明 RGB，每 4x4 块 8 字节
+     * - eBC7: 高质量 RGBA，每 4x4 块 16 字节
+     */
+    enum class TextureCompression {
+        eNone,
+        eBC1,
+        eBC7
+    };
     // 飞行中的帧的数量
     constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+    // 设备内存块的大小，超过一半的资源单独分配
+    constexpr std::uint64_t MEMORY_BLOCK_SIZE = 64ull * 1024 * 1024;
+    // 上传暂存环的大小，单次上传不能超过它
+    constexpr std::uint64_t STAGING_RING_SIZE = 64ull * 1024 * 1024;
+    // 网格优化时模拟的后变换顶点缓存大小
+    constexpr std::uint32_t VERTEX_CACHE_SIZE = 16;
+    // 上传到 GPU 的顶点布局
+    constexpr VertexLayout VERTEX_LAYOUT = VertexLayout::eCompact;
+    // 上传纹理时是否生成完整的 mip 链，关闭后可对比缩小视图下的 GPU 帧时间
+    constexpr bool TEXTURE_MIPMAPS = true;
+    // 纹理的压缩格式，设备不支持时退回不压缩
+    constexpr TextureCompression TEXTURE_COMPRESSION = TextureCompression::eBC7;
+    // 是否按屏幕上的尺寸流送纹理的 mip 层级，只对完整 mip 链的纹理容器生效
+    constexpr bool TEXTURE_STREAMING = true;
+    // 流送纹理常驻层级的显存预算，超出时按最近使用时间降级
+    constexpr std::uint64_t TEXTURE_STREAMING_BUDGET = 256ull * 1024 * 1024;
+    // 流送纹理加载时常驻的最大尺寸，驱逐不会低于这个尺寸
+    constexpr std::uint32_t TEXTURE_STREAMING_INITIAL_SIZE = 128;
+    // 无绑定纹理表的纹理槽位与采样器槽位数量，采样器数量通过宏传给着色器
+    constexpr std::uint32_t BINDLESS_TEXTURE_CAPACITY = 4096;
+    constexpr std::uint32_t BINDLESS_SAMPLER_CAPACITY = 8;
+    // 设备支持 EXT_mesh_shader 时是否使用网格着色器渲染路径
+    constexpr bool ENABLE_MESH_SHADER = true;
+    // 是否读取与保存管线缓存，关闭后每次启动都从 SPIR-V 编译，用于对比冷启动
+    constexpr bool ENABLE_PIPELINE_CACHE = true;
+    // 管线缓存文件，与纹理缓存同在 cache 目录下
+    constexpr const char* PIPELINE_CACHE_FILE = "cache/pipelines.bin";
+    // 是否监视 shaders 目录，修改后在后台重新编译并替换管线
+    constexpr bool ENABLE_SHADER_HOT_RELOAD = true;
+    // 单个 meshlet 的最大顶点数与三角形数，需与 shaders/mesh.mesh.glsl 一致
+    constexpr std::uint32_t MESHLET_MAX_VERTICES = 64;
+    constexpr std::uint32_t MESHLET_MAX_TRIANGLES = 124;
+    // 每个网格的最大 LOD 层数，包括原始网格
+    constexpr std::uint32_t MESH_LOD_COUNT = 4;
+    // 相邻 LOD 的目标三角形数量之比
+    constexpr float MESH_LOD_RATIO = 0.5f;
+    // 选择 LOD 时允许的屏幕空间误差，单位为像素
+    constexpr float LOD_PIXEL_ERROR = 1.0f;
+    // 共享几何缓冲区的容量，后台加载的网格依次放入，不会重新分配
+    constexpr std::uint64_t GEOMETRY_VERTEX_CAPACITY = 1ull << 20;
+    constexpr std::uint64_t GEOMETRY_INDEX_BYTES = 32ull * 1024 * 1024;
+    // meshlet 缓冲区可容纳的 meshlet 数量
+    constexpr std::uint64_t MESHLET_CAPACITY = 1ull << 14;
 }
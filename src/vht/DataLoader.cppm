@@ -6,10 +6,12 @@ export module DataLoader;
 import std;
 import vulkan_hpp;
 import glm;
-import tinyobj;
 
-// 模型路径
-const std::string MODEL_PATH = "models/viking_room.obj";
+import Config;
+import MeshCache;
+import MeshOptimizer;
+import MeshSimplifier;
+import ObjParser;
 
 export namespace vht {
 
@@ -40,69 +42,361 @@ export namespace vht {
             descriptions[1].offset = offsetof(Vertex, texCoord);
             return descriptions;
         }
-        bool operator<(const Vertex& other) const {
-            return std::tie(pos.x, pos.y, pos.z, texCoord.x, texCoord.y)
-                 < std::tie(other.pos.x, other.pos.y, other.pos.z, other.texCoord.x, other.texCoord.y);
+    };
+
+}
+
+namespace vht {
+
+    // 顶点的原始位模式，作为去重哈希表的键
+    using VertexBits = std::array<std::uint32_t, sizeof(vht::Vertex) / sizeof(std::uint32_t)>;
+    static_assert(sizeof(VertexBits) == sizeof(vht::Vertex));
+
+    [[nodiscard]]
+    VertexBits vertex_bits(const vht::Vertex& vertex) {
+        return std::bit_cast<VertexBits>(vertex);
+    }
+
+    [[nodiscard]]
+    std::uint64_t hash_vertex(const VertexBits& bits) {
+        std::uint64_t hash = 0x9e3779b97f4a7c15ull;
+        for (const std::uint32_t word : bits) {
+            hash ^= word;
+            hash *= 0xff51afd7ed558ccdull;
+            hash ^= hash >> 32;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief 基于开放寻址的顶点去重表
+     * @details
+     * - 按顶点原始位比较，-0.0 与 0.0 视为不同顶点
+     * - 顶点按首次出现顺序存入 vertices，槽位只保存顶点编号
+     * - 线性探测，容量为 2 的幂，负载因子不超过 1/2
+     */
+    class VertexTable {
+        static constexpr std::uint32_t EMPTY = std::numeric_limits<std::uint32_t>::max();
+        std::vector<std::uint32_t> m_slots;
+        std::vector<VertexBits> m_keys;
+        std::size_t m_mask{};
+    public:
+        std::vector<vht::Vertex> vertices;
+
+        explicit VertexTable(const std::size_t expected) {
+            const std::size_t capacity = std::bit_ceil(std::max<std::size_t>(expected * 2, 16));
+            m_slots.assign(capacity, EMPTY);
+            m_mask = capacity - 1;
+            m_keys.reserve(expected);
+            vertices.reserve(expected);
+        }
+
+        // 查找顶点，不存在时插入，返回顶点编号
+        [[nodiscard]]
+        std::uint32_t insert(const vht::Vertex& vertex) {
+            if ((vertices.size() + 1) * 2 > m_slots.size()) grow();
+            const VertexBits bits = vertex_bits(vertex);
+            for (std::size_t slot = hash_vertex(bits) & m_mask; ; slot = (slot + 1) & m_mask) {
+                const std::uint32_t id = m_slots[slot];
+                if (id == EMPTY) {
+                    const auto new_id = static_cast<std::uint32_t>(vertices.size());
+                    m_slots[slot] = new_id;
+                    m_keys.push_back(bits);
+                    vertices.push_back(vertex);
+                    return new_id;
+                }
+                if (m_keys[id] == bits) return id;
+            }
+        }
+    private:
+        void grow() {
+            m_slots.assign(m_slots.size() * 2, EMPTY);
+            m_mask = m_slots.size() - 1;
+            for (std::uint32_t id = 0; id < m_keys.size(); ++id) {
+                std::size_t slot = hash_vertex(m_keys[id]) & m_mask;
+                while (m_slots[slot] != EMPTY) slot = (slot + 1) & m_mask;
+                m_slots[slot] = id;
+            }
         }
     };
 
+    // 单个线程负责的索引区间的局部去重结果
+    struct DedupChunk {
+        std::vector<vht::Vertex> vertices;  // 区间内首次出现顺序的唯一顶点
+        std::vector<std::uint32_t> indices; // 指向 vertices 的局部索引
+    };
+
+    /**
+     * @brief 并行顶点去重
+     * @details
+     * 将展开后的顶点流切分为连续区间，各线程先在区间内去重，
+     * 再按区间顺序合并到全局表并重映射局部索引。
+     * 全局表的插入顺序与顺序遍历时的首次出现顺序一致，因此输出与单线程结果完全相同。
+     * @param count 展开后的顶点数量
+     * @param fetch fetch(i) 返回第 i 个展开顶点，需可被多个线程并发调用
+     */
+    template<typename Fetch>
+    void deduplicate(
+        const std::size_t count,
+        Fetch&& fetch,
+        std::vector<vht::Vertex>& out_vertices,
+        std::vector<std::uint32_t>& out_indices
+    ) {
+        constexpr std::size_t MIN_CHUNK = 1 << 16;
+        const std::size_t threads = std::clamp<std::size_t>(
+            std::min<std::size_t>(std::thread::hardware_concurrency(), count / MIN_CHUNK), 1, 64
+        );
+        const std::size_t chunk_size = (count + threads - 1) / threads;
+
+        std::vector<DedupChunk> chunks(threads);
+        {
+            std::vector<std::jthread> workers;
+            workers.reserve(threads);
+            for (std::size_t t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t] {
+                    const std::size_t begin = std::min(count, t * chunk_size);
+                    const std::size_t end = std::min(count, begin + chunk_size);
+                    VertexTable table(end - begin);
+                    auto& chunk = chunks[t];
+                    chunk.indices.reserve(end - begin);
+                    for (std::size_t i = begin; i < end; ++i) {
+                        chunk.indices.push_back(table.insert(fetch(i)));
+                    }
+                    chunk.vertices = std::move(table.vertices);
+                });
+            }
+        }
+
+        // 按区间顺序合并，保证结果确定
+        std::size_t unique_sum = 0;
+        for (const auto& chunk : chunks) unique_sum += chunk.vertices.size();
+        VertexTable global(unique_sum);
+        std::vector<std::vector<std::uint32_t>> remaps(threads);
+        for (std::size_t t = 0; t < threads; ++t) {
+            remaps[t].reserve(chunks[t].vertices.size());
+            for (const auto& vertex : chunks[t].vertices) {
+                remaps[t].push_back(global.insert(vertex));
+            }
+        }
+
+        out_indices.resize(count);
+        {
+            std::vector<std::jthread> workers;
+            workers.reserve(threads);
+            for (std::size_t t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t] {
+                    const std::size_t begin = std::min(count, t * chunk_size);
+                    const auto& chunk = chunks[t];
+                    const auto& remap = remaps[t];
+                    for (std::size_t i = 0; i < chunk.indices.size(); ++i) {
+                        out_indices[begin + i] = remap[chunk.indices[i]];
+                    }
+                });
+            }
+        }
+        out_vertices = std::move(global.vertices);
+    }
+
+}
+
+export namespace vht {
 
     /**
      * @brief 数据加载器
      * @details
      * - 工作：
-     *  - 加载模型数据
-     *  - 存储顶点和索引数据
+     *  - 加载单个模型的数据，优先从二进制网格缓存加载
+     *  - 缓存命中时顶点和索引直接指向映射的缓存文件，不复制到中间容器
+     *  - 缓存未命中时解析 OBJ 文件，优化顶点缓存、过度绘制与顶点获取顺序，
+     *    简化生成 LOD 链后写入缓存
+     *  - 所有 LOD 的索引依次存放在同一个索引数组中，共用顶点数据
+     *  - 顶点数量不超过 65536 时使用 16 位索引
      * - 可访问成员：
+     *  - path(): 获取模型路径
      *  - vertices(): 获取顶点数据
-     *  - indices(): 获取索引数据
+     *  - index_data(): 获取索引数据的原始字节
+     *  - index_type(): 获取索引类型
+     *  - index_count(): 获取所有 LOD 的索引总数
+     *  - lods(): 获取 LOD 链，第 0 层为原始网格
+     *  - bounds(): 获取模型空间的包围球，xyz 为球心，w 为半径
      */
     class DataLoader {
-        std::vector<Vertex> m_vertices;
-        std::vector<std::uint32_t> m_indices;
+        std::filesystem::path m_path;
+        std::optional<MeshCache> m_cache;         // 缓存命中时持有映射
+        std::vector<Vertex> m_parsed_vertices;    // 缓存未命中时解析得到的数据
+        std::vector<std::uint32_t> m_parsed_indices;
+        std::vector<std::uint16_t> m_parsed_short_indices;
+        std::span<const Vertex> m_vertices;
+        std::span<const std::byte> m_index_data;
+        vk::IndexType m_index_type{ vk::IndexType::eUint32 };
+        std::size_t m_index_count{};
+        std::vector<MeshLod> m_lods;
+        glm::vec4 m_bounds{ 0.0f };
     public:
-        DataLoader() {
+        explicit DataLoader(std::filesystem::path path): m_path(std::move(path)) {
             load_model();
         }
 
         [[nodiscard]]
-        const std::vector<Vertex>& vertices() const { return m_vertices; }
+        const std::filesystem::path& path() const { return m_path; }
+        [[nodiscard]]
+        std::span<const Vertex> vertices() const { return m_vertices; }
+        [[nodiscard]]
+        std::span<const std::byte> index_data() const { return m_index_data; }
         [[nodiscard]]
-        const std::vector<std::uint32_t>& indices() const { return m_indices; }
+        vk::IndexType index_type() const { return m_index_type; }
+        [[nodiscard]]
+        std::size_t index_count() const { return m_index_count; }
+        [[nodiscard]]
+        std::span<const MeshLod> lods() const { return m_lods; }
+        [[nodiscard]]
+        const glm::vec4& bounds() const { return m_bounds; }
     private:
+        // 模型数据的缓存布局
+        [[nodiscard]]
+        static MeshLayout mesh_layout() {
+            const auto attributes = Vertex::get_attribute_description();
+            return { sizeof(Vertex), { attributes.begin(), attributes.end() } };
+        }
         // 加载模型数据
         void load_model() {
-            tinyobj::attrib_t attrib;
-            std::vector<tinyobj::shape_t> shapes;
-            std::vector<tinyobj::material_t> materials;
-            std::string warn, err;
-            if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str())) {
-                throw std::runtime_error(warn + err);
+            const auto start_time = std::chrono::steady_clock::now();
+            const bool cached = load_cache();
+            if (!cached) {
+                load_obj();
+                MeshCache::store(
+                    m_path, mesh_layout(),
+                    std::as_bytes(m_vertices), m_index_data,
+                    m_index_type == vk::IndexType::eUint16 ? sizeof(std::uint16_t) : sizeof(std::uint32_t),
+                    m_lods
+                );
             }
-            // 使用 unordered_map 进行顶点去重
-            std::map<Vertex, std::uint32_t> unique_vertices;
-
-            for (const auto& shape : shapes) {
-                for (const auto& index : shape.mesh.indices) {
-                    Vertex vertex{};
-                    vertex.pos = {
-                        attrib.vertices[3 * index.vertex_index + 0],
-                        attrib.vertices[3 * index.vertex_index + 1],
-                        attrib.vertices[3 * index.vertex_index + 2]
-                    };
+            compute_bounds();
+            const auto end_time = std::chrono::steady_clock::now();
+            std::println("model {} loaded{}: {} vertices, {} {}-bit indices, {} lods, {:.2f} ms",
+                m_path.generic_string(), cached ? " from cache" : "",
+                m_vertices.size(), m_index_count,
+                m_index_type == vk::IndexType::eUint16 ? 16 : 32,
+                m_lods.size(),
+                std::chrono::duration<double, std::milli>(end_time - start_time).count());
+        }
+        // 从网格缓存加载，失败时返回 false
+        bool load_cache() {
+            m_cache = MeshCache::load(m_path, mesh_layout());
+            if (!m_cache) return false;
+            // 缓存数据块按 16 字节对齐，可以直接视为顶点数组
+            m_vertices = {
+                reinterpret_cast<const Vertex*>(m_cache->vertex_data().data()),
+                static_cast<std::size_t>(m_cache->vertex_count())
+            };
+            m_index_data = m_cache->index_data();
+            m_index_count = static_cast<std::size_t>(m_cache->index_count());
+            m_index_type = m_cache->index_size() == sizeof(std::uint16_t) ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+            m_lods.assign(m_cache->lods().begin(), m_cache->lods().end());
+            return true;
+        }
+        // 解析 OBJ 文件并去重顶点
+        void load_obj() {
+            const ObjData obj = vht::parse_obj(m_path.string());
+            const auto fetch = [&](const std::size_t i) {
+                const ObjCorner& corner = obj.corners[i];
+                Vertex vertex{};
+                vertex.pos = {
+                    obj.positions[3 * corner.position + 0],
+                    obj.positions[3 * corner.position + 1],
+                    obj.positions[3 * corner.position + 2]
+                };
+                // 缺少纹理坐标时按 (0, 0) 处理
+                if (corner.texcoord >= 0) {
                     vertex.texCoord = {
-                        attrib.texcoords[2 * index.texcoord_index + 0],
-                        1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+                        obj.texcoords[2 * corner.texcoord + 0],
+                        1.0f - obj.texcoords[2 * corner.texcoord + 1]
                     };
-                    if(const auto it = unique_vertices.find(vertex); it == unique_vertices.end()) {
-                        unique_vertices.insert({vertex, static_cast<std::uint32_t>(m_vertices.size())});
-                        m_indices.push_back(static_cast<std::uint32_t>(m_vertices.size()));
-                        m_vertices.push_back(vertex);
-                    } else {
-                        m_indices.push_back(it->second);
-                    }
+                } else {
+                    vertex.texCoord = { 0.0f, 1.0f };
                 }
+                return vertex;
+            };
+            // 使用开放寻址哈希表并行去重，输出与顺序去重一致
+            deduplicate(obj.corners.size(), fetch, m_parsed_vertices, m_parsed_indices);
+            optimize_mesh();
+            build_lods();
+            m_vertices = m_parsed_vertices;
+            select_index_type();
+        }
+
+        // 顶点数量不超过 16 位索引的表示范围时收窄索引
+        void select_index_type() {
+            m_index_count = m_parsed_indices.size();
+            if (m_parsed_vertices.size() <= std::numeric_limits<std::uint16_t>::max() + 1ull) {
+                m_parsed_short_indices.assign(m_parsed_indices.begin(), m_parsed_indices.end());
+                m_parsed_indices = {};
+                m_index_data = std::as_bytes(std::span{ m_parsed_short_indices });
+                m_index_type = vk::IndexType::eUint16;
+            } else {
+                m_index_data = std::as_bytes(std::span{ m_parsed_indices });
+                m_index_type = vk::IndexType::eUint32;
+            }
+        }
+
+        // 优化索引顺序与顶点顺序，并打印顶点缓存统计
+        void optimize_mesh() {
+            const std::size_t vertex_count = m_parsed_vertices.size();
+            const auto before = analyze_vertex_cache(m_parsed_indices, vertex_count);
+            optimize_vertex_cache(m_parsed_indices, vertex_count);
+            optimize_overdraw(m_parsed_indices, vertex_count, [this](const std::uint32_t v) {
+                return m_parsed_vertices[v].pos;
+            });
+            optimize_vertex_fetch(m_parsed_vertices, m_parsed_indices);
+            const auto after = analyze_vertex_cache(m_parsed_indices, vertex_count);
+            std::println("vertex cache ({} entries): ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+                VERTEX_CACHE_SIZE, before.acmr, after.acmr, before.atvr, after.atvr);
+        }
+
+        /**
+         * @brief 生成 LOD 链
+         * @details
+         * 每一层都从原始网格简化，目标三角形数量按 MESH_LOD_RATIO 递减，误差取逐层最大值以保证单调。
+         * 简化结果只引用已有顶点，追加到索引数组末尾；锁定的顶点使简化无法明显减少三角形时提前结束
+         */
+        void build_lods() {
+            const std::size_t vertex_count = m_parsed_vertices.size();
+            const std::vector<std::uint32_t> base = m_parsed_indices;
+            m_lods = { MeshLod{ 0, static_cast<std::uint32_t>(base.size()), 0.0f } };
+            float ratio = 1.0f;
+            for (std::uint32_t level = 1; level < MESH_LOD_COUNT; ++level) {
+                ratio *= MESH_LOD_RATIO;
+                const auto target = static_cast<std::size_t>(static_cast<float>(base.size() / 3) * ratio) * 3;
+                auto [indices, error] = simplify_mesh(base, vertex_count, [this](const std::uint32_t v) {
+                    return m_parsed_vertices[v].pos;
+                }, target);
+                if (indices.empty() || indices.size() * 10 > static_cast<std::size_t>(m_lods.back().index_count) * 9) break;
+                optimize_vertex_cache(indices, vertex_count);
+                m_lods.push_back({
+                    static_cast<std::uint32_t>(m_parsed_indices.size()),
+                    static_cast<std::uint32_t>(indices.size()),
+                    std::max(error, m_lods.back().error)
+                });
+                m_parsed_indices.insert(m_parsed_indices.end(), indices.begin(), indices.end());
+            }
+            for (std::size_t level = 0; level < m_lods.size(); ++level) {
+                std::println("lod {}: {} triangles, error {:.5f}", level, m_lods[level].index_count / 3, m_lods[level].error);
+            }
+        }
+
+        // 由顶点的包围盒计算包围球
+        void compute_bounds() {
+            if (m_vertices.empty()) return;
+            glm::vec3 min_pos{ std::numeric_limits<float>::max() };
+            glm::vec3 max_pos{ std::numeric_limits<float>::lowest() };
+            for (const auto& vertex : m_vertices) {
+                min_pos = glm::min(min_pos, vertex.pos);
+                max_pos = glm::max(max_pos, vertex.pos);
             }
+            const glm::vec3 center = (min_pos + max_pos) * 0.5f;
+            float radius = 0.0f;
+            for (const auto& vertex : m_vertices) radius = std::max(radius, glm::length(vertex.pos - center));
+            m_bounds = glm::vec4(center, radius);
         }
 
     };
@@ -5,6 +5,7 @@ import vulkan_hpp;
 
 import Tools;
 import Device;
+import MemoryAllocator;
 import Swapchain;
 
 export namespace vht {
@@ -14,6 +15,7 @@ export namespace vht {
      * @details
      * - 依赖：
      *  - m_device: 物理/逻辑设备与队列
+     *  - m_allocator: 设备内存分配器
      *  - m_swapchain: 交换链
      * - 工作：
      *  - 创建深度图像
@@ -25,14 +27,19 @@ export namespace vht {
      */
     class DepthImage {
         std::shared_ptr<vht::Device> m_device{ nullptr };
+        std::shared_ptr<vht::MemoryAllocator> m_allocator{ nullptr };
         std::shared_ptr<vht::Swapchain> m_swapchain{ nullptr };
-        vk::raii::DeviceMemory m_memory{ nullptr };
+        vht::Allocation m_allocation{ nullptr };
         vk::raii::Image m_image{ nullptr };
         vk::raii::ImageView m_image_view{ nullptr };
         vk::Format m_format{};
     public:
-        explicit DepthImage(std::shared_ptr<vht::Device> device, std::shared_ptr<vht::Swapchain> swapchain)
-        :   m_device(std::move(device)),
+        explicit DepthImage(
+            std::shared_ptr<vht::Device> device,
+            std::shared_ptr<vht::MemoryAllocator> allocator,
+            std::shared_ptr<vht::Swapchain> swapchain
+        ):  m_device(std::move(device)),
+            m_allocator(std::move(allocator)),
             m_swapchain(std::move(swapchain)) {
             init();
         }
@@ -48,6 +55,7 @@ export namespace vht {
         void recreate() {
             m_image_view = nullptr;
             m_image = nullptr;
+            m_allocation = nullptr;
             create_depth_resources();
         }
     private:
@@ -71,9 +79,9 @@ export namespace vht {
         void create_depth_resources() {
             create_image(
                 m_image,
-                m_memory,
+                m_allocation,
                 m_device->device(),
-                m_device->physical_device(),
+                *m_allocator,
                 m_swapchain->extent().width,
                 m_swapchain->extent().height,
                 m_format,
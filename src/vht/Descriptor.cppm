@@ -7,7 +7,10 @@ import Config;
 import Device;
 import GraphicsPipeline;
 import UniformBuffer;
-import TextureSampler;
+import TextureTable;
+import InputAssembly;
+import MeshletAssembly;
+import MeshPipeline;
 
 export namespace vht {
 
@@ -18,32 +21,46 @@ export namespace vht {
      *  - m_device: 逻辑设备
      *  - m_graphics_pipeline: 图形管线
      *  - m_uniform_buffer: Uniform Buffer对象
-     *  - m_texture_sampler: 纹理采样器对象
+     *  - m_texture_table: 无绑定纹理表
+     *  - m_input_assembly: 顶点缓冲区
+     *  - m_meshlet_assembly: meshlet 缓冲区
+     *  - m_mesh_pipeline: 网格着色器管线
      * - 工作：
-     *  - 创建描述符池和描述符集
+     *  - 创建 UBO 描述符池和描述符集，纹理集合由 m_texture_table 持有
+     *  - 网格着色器管线可用时创建 meshlet 描述符集
      * - 可访问成员：
      *  - pool(): 获取描述符池
      *  - ubo_sets(): 获取UBO描述符集列表
-     *  - texture_set(): 获取纹理描述符集
+     *  - texture_set(): 获取无绑定纹理表的描述符集
+     *  - meshlet_set(): 获取 meshlet 描述符集，网格着色器不可用时为空
      */
     class Descriptor {
         std::shared_ptr<vht::Device> m_device;
         std::shared_ptr<vht::GraphicsPipeline> m_graphics_pipeline;
         std::shared_ptr<vht::UniformBuffer> m_uniform_buffer;
-        std::shared_ptr<vht::TextureSampler> m_texture_sampler;
+        std::shared_ptr<vht::TextureTable> m_texture_table;
+        std::shared_ptr<vht::InputAssembly> m_input_assembly;
+        std::shared_ptr<vht::MeshletAssembly> m_meshlet_assembly;
+        std::shared_ptr<vht::MeshPipeline> m_mesh_pipeline;
         vk::raii::DescriptorPool m_pool{ nullptr };
         std::vector<vk::raii::DescriptorSet> m_ubo_sets;
-        vk::raii::DescriptorSet m_texture_set{ nullptr };
+        vk::raii::DescriptorSet m_meshlet_set{ nullptr };
     public:
         explicit Descriptor(
             std::shared_ptr<vht::Device> device,
             std::shared_ptr<vht::GraphicsPipeline> m_graphics_pipeline,
             std::shared_ptr<vht::UniformBuffer> m_uniform_buffer,
-            std::shared_ptr<vht::TextureSampler> m_texture_sampler
+            std::shared_ptr<vht::TextureTable> texture_table,
+            std::shared_ptr<vht::InputAssembly> input_assembly,
+            std::shared_ptr<vht::MeshletAssembly> meshlet_assembly,
+            std::shared_ptr<vht::MeshPipeline> mesh_pipeline
         ):  m_device(std::move(device)),
             m_graphics_pipeline(std::move(m_graphics_pipeline)),
             m_uniform_buffer(std::move(m_uniform_buffer)),
-            m_texture_sampler(std::move(m_texture_sampler)) {
+            m_texture_table(std::move(texture_table)),
+            m_input_assembly(std::move(input_assembly)),
+            m_meshlet_assembly(std::move(meshlet_assembly)),
+            m_mesh_pipeline(std::move(mesh_pipeline)) {
             init();
         }
 
@@ -52,20 +69,23 @@ export namespace vht {
         [[nodiscard]]
         const std::vector<vk::raii::DescriptorSet>& ubo_sets() const { return m_ubo_sets; }
         [[nodiscard]]
-        const vk::raii::DescriptorSet& texture_set() const { return m_texture_set; }
+        const vk::raii::DescriptorSet& texture_set() const { return m_texture_table->set(); }
+        [[nodiscard]]
+        const vk::raii::DescriptorSet& meshlet_set() const { return m_meshlet_set; }
 
     private:
         void init() {
             create_descriptor_pool();
             create_descriptor_sets();
+            create_meshlet_set();
         }
         // 创建描述符池
         void create_descriptor_pool() {
             std::array<vk::DescriptorPoolSize, 2> pool_sizes;
             pool_sizes[0].type = vk::DescriptorType::eUniformBuffer;
             pool_sizes[0].descriptorCount = static_cast<std::uint32_t>(MAX_FRAMES_IN_FLIGHT);
-            pool_sizes[1].type = vk::DescriptorType::eCombinedImageSampler;
-            pool_sizes[1].descriptorCount = 1;
+            pool_sizes[1].type = vk::DescriptorType::eStorageBuffer;
+            pool_sizes[1].descriptorCount = 4;
 
             vk::DescriptorPoolCreateInfo poolInfo;
             poolInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
@@ -98,21 +118,27 @@ export namespace vht {
 
                 m_device->device().updateDescriptorSets(write, nullptr);
             }
-
-            alloc_info.setSetLayouts(*m_graphics_pipeline->descriptor_set_layouts().at(1));
-            m_texture_set =  std::move(m_device->device().allocateDescriptorSets(alloc_info).at(0));
-
-            vk::DescriptorImageInfo image_info;
-            image_info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-            image_info.imageView = m_texture_sampler->image_view();
-            image_info.sampler = m_texture_sampler->sampler();
-
+        }
+        // 创建 meshlet 描述符集，绑定顺序与 shaders/mesh.mesh.glsl 一致
+        void create_meshlet_set() {
+            if (!m_mesh_pipeline->supported()) return;
+            vk::DescriptorSetAllocateInfo alloc_info;
+            alloc_info.descriptorPool = m_pool;
+            alloc_info.setSetLayouts( *m_mesh_pipeline->descriptor_set_layout() );
+            m_meshlet_set = std::move(m_device->device().allocateDescriptorSets(alloc_info).at(0));
+
+            const std::array<vk::DescriptorBufferInfo, 4> buffer_infos {
+                vk::DescriptorBufferInfo{ m_input_assembly->vertex_buffer(), 0, vk::WholeSize },
+                vk::DescriptorBufferInfo{ m_meshlet_assembly->meshlet_buffer(), 0, vk::WholeSize },
+                vk::DescriptorBufferInfo{ m_meshlet_assembly->vertex_buffer(), 0, vk::WholeSize },
+                vk::DescriptorBufferInfo{ m_meshlet_assembly->triangle_buffer(), 0, vk::WholeSize }
+            };
             vk::WriteDescriptorSet write;
-            write.dstSet = m_texture_set;
+            write.dstSet = m_meshlet_set;
             write.dstBinding = 0;
             write.dstArrayElement = 0;
-            write.descriptorType = vk::DescriptorType::eCombinedImageSampler;
-            write.setImageInfo(image_info);
+            write.descriptorType = vk::DescriptorType::eStorageBuffer;
+            write.setBufferInfo( buffer_infos );
 
             m_device->device().updateDescriptorSets(write, nullptr);
         }
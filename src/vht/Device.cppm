@@ -3,6 +3,7 @@ export module Device;
 import std;
 import vulkan_hpp;
 
+import Config;
 import Context;
 import Window;
 
@@ -14,11 +15,13 @@ export namespace  vht {
      * @details
      * - graphics_family: 图形队列族索引
      * - present_family: 呈现队列族索引
+     * - transfer_family: 上传使用的队列族索引，没有独立的传输队列族时与图形队列族相同
      * - is_complete(): 检查是否已找到所需的队列族索引
      */
     struct QueueFamilyIndices {
         std::optional<std::uint32_t> graphics_family;
         std::optional<std::uint32_t> present_family;
+        std::optional<std::uint32_t> transfer_family;
         [[nodiscard]]
         bool is_complete() const {
             return graphics_family.has_value() && present_family.has_value();
@@ -51,8 +54,13 @@ export namespace  vht {
      *  - device(): 获取逻辑设备
      *  - graphics_queue(): 获取图形队列
      *  - present_queue(): 获取呈现队列
+     *  - transfer_queue(): 获取传输队列，没有独立的传输队列族时与图形队列相同
      *  - swapchain_support(): 获取交换链支持的详细信息
      *  - queue_family_indices(): 获取队列族索引
+     *  - mesh_shader_supported(): 是否启用了 EXT_mesh_shader 的任务与网格着色器
+     *  - format_supported(): 检查格式在最优平铺下是否支持给定的特性
+     *  - queue_mutex(): 队列互斥锁，多个线程提交命令或呈现时需持有
+     *  - wait_idle(): 持有队列互斥锁等待设备空闲
      */
     class Device {
         std::shared_ptr<vht::Context> m_context{ nullptr };
@@ -62,6 +70,10 @@ export namespace  vht {
         QueueFamilyIndices m_queue_family_indices{};
         vk::raii::Queue m_graphics_queue{ nullptr };
         vk::raii::Queue m_present_queue{ nullptr };
+        vk::raii::Queue m_transfer_queue{ nullptr };
+        bool m_mesh_shader_supported{ false };
+        bool m_texture_compression_bc{ false };
+        mutable std::mutex m_queue_mutex;
     public:
         explicit Device(std::shared_ptr<vht::Context> context, std::shared_ptr<vht::Window> window)
         :   m_context(std::move(context)),
@@ -79,9 +91,32 @@ export namespace  vht {
         [[nodiscard]]
         const vk::raii::Queue& present_queue() const { return m_present_queue; }
         [[nodiscard]]
+        const vk::raii::Queue& transfer_queue() const { return m_transfer_queue; }
+        [[nodiscard]]
         SwapchainSupportDetails swapchain_support() const { return query_swapchain_support(m_physical_device); }
         [[nodiscard]]
         QueueFamilyIndices queue_family_indices() const { return m_queue_family_indices; }
+        [[nodiscard]]
+        bool mesh_shader_supported() const { return m_mesh_shader_supported; }
+        [[nodiscard]]
+        std::mutex& queue_mutex() const { return m_queue_mutex; }
+
+        /**
+         * @brief 检查格式在最优平铺下是否支持给定的特性
+         * @details BC 格式还要求启用了 textureCompressionBC 特性
+         */
+        [[nodiscard]]
+        bool format_supported(const vk::Format format, const vk::FormatFeatureFlags features) const {
+            if (is_bc_format(format) && !m_texture_compression_bc) return false;
+            const auto supported = m_physical_device.getFormatProperties(format).optimalTilingFeatures;
+            return (supported & features) == features;
+        }
+
+        // vkDeviceWaitIdle 要求所有队列都被外部同步
+        void wait_idle() const {
+            const std::scoped_lock lock{ m_queue_mutex };
+            m_device.waitIdle();
+        }
     private:
         /**
          * @brief 挑选物理设备
@@ -115,6 +150,18 @@ export namespace  vht {
             if (const auto supports = query_swapchain_support(physical_device);
                 supports.formats.empty() || supports.present_modes.empty()
             ) return false;
+            // 无绑定纹理表需要的描述符索引特性，片段着色器用推送常量中的槽位索引纹理与采样器数组
+            const auto features = physical_device.getFeatures2<
+                vk::PhysicalDeviceFeatures2,
+                vk::PhysicalDeviceVulkan12Features
+            >();
+            if (!features.get<vk::PhysicalDeviceFeatures2>().features.shaderSampledImageArrayDynamicIndexing) return false;
+            if (const auto& vulkan12 = features.get<vk::PhysicalDeviceVulkan12Features>();
+                !vulkan12.runtimeDescriptorArray ||
+                !vulkan12.descriptorBindingPartiallyBound ||
+                !vulkan12.descriptorBindingSampledImageUpdateAfterBind ||
+                !vulkan12.descriptorBindingUpdateUnusedWhilePending
+            ) return false;
             // 队列族支持
             const auto indices = find_queue_families(physical_device);
             return indices.is_complete();
@@ -136,23 +183,34 @@ export namespace  vht {
 
         /**
          * @brief 查询需要的队列族索引
+         * @details
+         * 传输队列族优先选择只支持传输的专用队列族（通常对应 DMA 引擎），
+         * 其次选择不支持图形的队列族，都没有时使用图形队列族。
          * @param physical_device 物理设备
          * @return QueueFamilyIndices 队列族索引
          */
         [[nodiscard]]
         QueueFamilyIndices find_queue_families(const vk::raii::PhysicalDevice& physical_device) const {
             QueueFamilyIndices indices{};
+            std::optional<std::uint32_t> dedicated_transfer;
+            std::optional<std::uint32_t> separate_transfer;
             const auto queue_families = physical_device.getQueueFamilyProperties();
             for (std::uint32_t i = 0; const auto& queue_family : queue_families) {
-                if (queue_family.queueFlags & vk::QueueFlagBits::eGraphics) {
+                const auto flags = queue_family.queueFlags;
+                if (!indices.graphics_family && (flags & vk::QueueFlagBits::eGraphics)) {
                     indices.graphics_family = i;
                 }
-                if(physical_device.getSurfaceSupportKHR(i, m_window->surface())){
+                if(!indices.present_family && physical_device.getSurfaceSupportKHR(i, m_window->surface())){
                     indices.present_family = i;
                 }
-                if (indices.is_complete()) break;
+                if ((flags & vk::QueueFlagBits::eTransfer) && !(flags & vk::QueueFlagBits::eGraphics)) {
+                    if (!dedicated_transfer && !(flags & vk::QueueFlagBits::eCompute)) dedicated_transfer = i;
+                    if (!separate_transfer) separate_transfer = i;
+                }
                 ++i;
             }
+            indices.transfer_family = dedicated_transfer ? dedicated_transfer : separate_transfer;
+            if (!indices.transfer_family) indices.transfer_family = indices.graphics_family;
             return indices;
         }
 
@@ -162,9 +220,13 @@ export namespace  vht {
         void create_device() {
             // 已在物理设备创建时保证内容不为空
             m_queue_family_indices = find_queue_families(m_physical_device);
-            const auto [graphics_family, present_family] = m_queue_family_indices;
+            const auto [graphics_family, present_family, transfer_family] = m_queue_family_indices;
 
-            std::set<std::uint32_t> unique_queue_families { graphics_family.value(), present_family.value() };
+            std::set<std::uint32_t> unique_queue_families {
+                graphics_family.value(),
+                present_family.value(),
+                transfer_family.value()
+            };
 
             std::vector<vk::DeviceQueueCreateInfo> queue_create_infos;
             queue_create_infos.reserve(unique_queue_families.size());
@@ -176,27 +238,75 @@ export namespace  vht {
                 queue_create_infos.emplace_back( queue_create_info );
             }
 
+            // 可选扩展
+            std::vector<const char*> extensions( DEVICE_EXTENSIONS.begin(), DEVICE_EXTENSIONS.end() );
+            m_mesh_shader_supported = ENABLE_MESH_SHADER && check_mesh_shader_support();
+            if (m_mesh_shader_supported) extensions.push_back( vk::EXTMeshShaderExtensionName );
+
             vk::StructureChain<
                 vk::DeviceCreateInfo,
                 vk::PhysicalDeviceFeatures2,
                 vk::PhysicalDeviceVulkan11Features,
                 vk::PhysicalDeviceVulkan12Features,
-                vk::PhysicalDeviceVulkan13Features
+                vk::PhysicalDeviceVulkan13Features,
+                vk::PhysicalDeviceMeshShaderFeaturesEXT
             > device_create_info;
 
             device_create_info.get()
                 .setQueueCreateInfos( queue_create_infos )
-                .setPEnabledExtensionNames( DEVICE_EXTENSIONS );
+                .setPEnabledExtensionNames( extensions );
+            if (m_mesh_shader_supported) {
+                device_create_info.get<vk::PhysicalDeviceMeshShaderFeaturesEXT>()
+                    .setTaskShader( true )
+                    .setMeshShader( true );
+            } else {
+                device_create_info.unlink<vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+            }
+            m_texture_compression_bc = m_physical_device.getFeatures().textureCompressionBC;
             device_create_info.get<vk::PhysicalDeviceFeatures2>().features
-                .setSamplerAnisotropy( true );
+                .setSamplerAnisotropy( true )
+                .setShaderSampledImageArrayDynamicIndexing( true )
+                .setTextureCompressionBC( m_texture_compression_bc );
             device_create_info.get<vk::PhysicalDeviceVulkan12Features>()
-                .setTimelineSemaphore( true );
+                .setTimelineSemaphore( true )
+                .setRuntimeDescriptorArray( true )
+                .setDescriptorBindingPartiallyBound( true )
+                .setDescriptorBindingSampledImageUpdateAfterBind( true )
+                .setDescriptorBindingUpdateUnusedWhilePending( true );
             device_create_info.get<vk::PhysicalDeviceVulkan13Features>()
                 .setSynchronization2( true );
 
             m_device = m_physical_device.createDevice( device_create_info.get() );
             m_graphics_queue = m_device.getQueue( graphics_family.value(), 0 );
             m_present_queue = m_device.getQueue( present_family.value(), 0 );
+            m_transfer_queue = m_device.getQueue( transfer_family.value(), 0 );
+            std::println("transfer queue family: {}{}", transfer_family.value(),
+                transfer_family == graphics_family ? " (shared with graphics)" : "");
+            std::println("mesh shader: {}", m_mesh_shader_supported ? "enabled" : "unavailable, using vertex pipeline");
+        }
+
+        // BC1 ~ BC7 格式在枚举中连续排列
+        [[nodiscard]]
+        static bool is_bc_format(const vk::Format format) {
+            return format >= vk::Format::eBc1RgbUnormBlock && format <= vk::Format::eBc7SrgbBlock;
+        }
+
+        /**
+         * @brief 检查物理设备是否支持 EXT_mesh_shader 的任务与网格着色器
+         */
+        [[nodiscard]]
+        bool check_mesh_shader_support() const {
+            const auto extensions = m_physical_device.enumerateDeviceExtensionProperties();
+            const bool has_extension = std::ranges::any_of(extensions, [](const vk::ExtensionProperties& it) {
+                return std::string_view{ it.extensionName } == vk::EXTMeshShaderExtensionName;
+            });
+            if (!has_extension) return false;
+            const auto features = m_physical_device.getFeatures2<
+                vk::PhysicalDeviceFeatures2,
+                vk::PhysicalDeviceMeshShaderFeaturesEXT
+            >();
+            const auto& mesh_features = features.get<vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+            return mesh_features.taskShader && mesh_features.meshShader;
         }
 
     };
@@ -2,9 +2,9 @@ export module Drawer;
 
 import std;
 import vulkan_hpp;
+import glm;
 
 import Config;
-import DataLoader;
 import Window;
 import Device;
 import Swapchain;
@@ -14,6 +14,12 @@ import CommandPool;
 import InputAssembly;
 import UniformBuffer;
 import Descriptor;
+import VertexFormat;
+import MeshPipeline;
+import MeshletAssembly;
+import AssetLoader;
+import TextureStreamer;
+import ShaderReloader;
 
 export namespace vht {
 
@@ -21,23 +27,38 @@ export namespace vht {
      * @brief 绘制相关
      * @details
      * - 依赖：
-     *  - m_data_loader: 数据加载器
      *  - m_window: 窗口与表面
      *  - m_device: 物理/逻辑设备与队列
      *  - m_swapchain: 交换链
      *  - m_render_pass: 渲染通道与帧缓冲
      *  - m_graphics_pipeline: 图形管线与描述布局
      *  - m_command_pool: 命令池
-     *  - m_input_assembly: 输入装配（顶点缓冲和索引缓冲）
+     *  - m_input_assembly: 输入装配（共享的顶点缓冲和索引缓冲，以及每个网格的绘制参数）
      *  - m_uniform_buffer: uniform 缓冲区
      *  - m_descriptor: 描述符集与池
+     *  - m_mesh_pipeline: 网格着色器管线
+     *  - m_meshlet_assembly: meshlet 缓冲区
+     *  - m_asset_loader: 后台模型加载
+     *  - m_texture_streamer: 纹理 mip 流送
+     *  - m_shader_reloader: 着色器热重载
      * - 工作：
      *  - 创建同步对象（信号量和栅栏）
      *  - 创建命令缓冲区
-     *  - 绘制函数 draw()
+     *  - 绘制函数 draw()，网格着色器可用时使用 meshlet 路径，否则使用顶点着色器路径
+     *  - 每帧开始时把后台上传完成的网格加入绘制列表，从不等待正在进行的加载
+     *  - 每帧开始时替换后台重建完成的管线，从不等待正在进行的编译
+     *  - 缓冲区和描述符集每帧只绑定一次，每个网格只推送常量并发出一次绘制；
+     *    16 位与 32 位索引的网格分两组绘制，索引缓冲区最多绑定两次
+     *  - 每帧按投影到屏幕的几何误差为每个网格选择 LOD
+     *  - 每帧把相机与绘制列表交给 m_texture_streamer 调整纹理的常驻层级，推送常量时使用其当前槽位
+     *  - 队列支持时间戳时记录每帧渲染通道的 GPU 耗时，每 GPU_TIME_FRAMES 帧输出一次平均值，
+     *    可在缩小视图下对比 TEXTURE_MIPMAPS 开关前后的纹理带宽开销
+     * - 可访问成员：
+     *  - lods(): 当前帧每个网格使用的 LOD
+     *  - submitted_triangles(): 当前帧提交的三角形数量，网格着色器路径为剔除前的数量
+     *  - gpu_frame_time(): 最近一次统计的平均 GPU 帧时间，单位为毫秒
      */
     class Drawer {
-        std::shared_ptr<vht::DataLoader> m_data_loader{ nullptr };
         std::shared_ptr<vht::Window> m_window{ nullptr };
         std::shared_ptr<vht::Device> m_device{ nullptr };
         std::shared_ptr<vht::Swapchain> m_swapchain{ nullptr };
@@ -47,14 +68,27 @@ export namespace vht {
         std::shared_ptr<vht::InputAssembly> m_input_assembly{ nullptr };
         std::shared_ptr<vht::UniformBuffer> m_uniform_buffer{ nullptr };
         std::shared_ptr<vht::Descriptor> m_descriptor{ nullptr };
+        std::shared_ptr<vht::MeshPipeline> m_mesh_pipeline{ nullptr };
+        std::shared_ptr<vht::MeshletAssembly> m_meshlet_assembly{ nullptr };
+        std::shared_ptr<vht::AssetLoader> m_asset_loader{ nullptr };
+        std::shared_ptr<vht::TextureStreamer> m_texture_streamer{ nullptr };
+        std::shared_ptr<vht::ShaderReloader> m_shader_reloader{ nullptr };
         std::vector<vk::raii::Semaphore> m_present_semaphores;
         std::vector<vk::raii::Semaphore> m_image_semaphores;
         std::vector<vk::raii::Semaphore> m_time_semaphores;
         std::vector<vk::raii::CommandBuffer> m_command_buffers;
         int m_current_frame = 0;
+        std::vector<std::size_t> m_lods;
+        std::uint64_t m_submitted_triangles = 0;
+        static constexpr std::uint32_t GPU_TIME_FRAMES = 256;
+        vk::raii::QueryPool m_timestamp_pool{ nullptr };
+        std::array<bool, MAX_FRAMES_IN_FLIGHT> m_timestamp_written{};
+        double m_timestamp_period = 0.0;    // 每个时间戳计数的纳秒数
+        double m_gpu_time_sum = 0.0;
+        std::uint32_t m_gpu_time_count = 0;
+        double m_gpu_frame_time = 0.0;
     public:
         explicit Drawer(
-            std::shared_ptr<vht::DataLoader> data_loader,
             std::shared_ptr<vht::Window> window,
             std::shared_ptr<vht::Device> device,
             std::shared_ptr<vht::Swapchain> swapchain,
@@ -63,9 +97,13 @@ export namespace vht {
             std::shared_ptr<vht::CommandPool> command_pool,
             std::shared_ptr<vht::InputAssembly> input_assembly,
             std::shared_ptr<vht::UniformBuffer> uniform_buffer,
-            std::shared_ptr<vht::Descriptor> descriptor
-        ):  m_data_loader(std::move(data_loader)),
-            m_window(std::move(window)),
+            std::shared_ptr<vht::Descriptor> descriptor,
+            std::shared_ptr<vht::MeshPipeline> mesh_pipeline,
+            std::shared_ptr<vht::MeshletAssembly> meshlet_assembly,
+            std::shared_ptr<vht::AssetLoader> asset_loader,
+            std::shared_ptr<vht::TextureStreamer> texture_streamer,
+            std::shared_ptr<vht::ShaderReloader> shader_reloader
+        ):  m_window(std::move(window)),
             m_device(std::move(device)),
             m_swapchain(std::move(swapchain)),
             m_render_pass(std::move(render_pass)),
@@ -73,10 +111,21 @@ export namespace vht {
             m_command_pool(std::move(command_pool)),
             m_input_assembly(std::move(input_assembly)),
             m_uniform_buffer(std::move(uniform_buffer)),
-            m_descriptor(std::move(descriptor)) {
+            m_descriptor(std::move(descriptor)),
+            m_mesh_pipeline(std::move(mesh_pipeline)),
+            m_meshlet_assembly(std::move(meshlet_assembly)),
+            m_asset_loader(std::move(asset_loader)),
+            m_texture_streamer(std::move(texture_streamer)),
+            m_shader_reloader(std::move(shader_reloader)) {
             init();
         }
 
+        [[nodiscard]]
+        const std::vector<std::size_t>& lods() const { return m_lods; }
+        [[nodiscard]]
+        std::uint64_t submitted_triangles() const { return m_submitted_triangles; }
+        [[nodiscard]]
+        double gpu_frame_time() const { return m_gpu_frame_time; }
 
         void draw() {
             static std::array<std::uint64_t, MAX_FRAMES_IN_FLIGHT> time_counter{};
@@ -85,6 +134,7 @@ export namespace vht {
             first_wait.setSemaphores( *m_time_semaphores[m_current_frame] ); // 需要 * 转换至少一次类型
             first_wait.setValues( time_counter[m_current_frame] );
             std::ignore = m_device->device().waitSemaphores( first_wait, std::numeric_limits<std::uint64_t>::max() );
+            read_timestamps();
 
             // 获取交换链的下一个图像索引
             std::uint32_t image_index;
@@ -100,16 +150,31 @@ export namespace vht {
 
             // 更新 uniform 缓冲区
             m_uniform_buffer->update_uniform_buffer(m_current_frame);
+            m_asset_loader->poll();
+            m_shader_reloader->poll();
+            select_lods();
+            m_texture_streamer->update(m_input_assembly->draws(), m_uniform_buffer->ubo(), m_swapchain->extent());
             // 重置当前帧的命令缓冲区，并记录新的命令
             m_command_buffers[m_current_frame].reset();
             record_command_buffer(m_command_buffers[m_current_frame], image_index);
+            m_timestamp_written[m_current_frame] = static_cast<bool>(*m_timestamp_pool);
 
             ++time_counter[m_current_frame];  // 增加计数器的值，以便在渲染完成时增加时间线信号量
             // 等待图像准备完成
-            vk::SemaphoreSubmitInfo wait_image;
-            wait_image.setSemaphore( m_image_semaphores[m_current_frame] );
-            wait_image.setStageMask( vk::PipelineStageFlagBits2::eColorAttachmentOutput );
+            std::array<vk::SemaphoreSubmitInfo,3> wait_infos;
+            wait_infos[0].setSemaphore( m_image_semaphores[m_current_frame] );
+            wait_infos[0].setStageMask( vk::PipelineStageFlagBits2::eColorAttachmentOutput );
             // 二进制信号量，不需要设置值
+            // 绘制列表中网格的上传已经完成，此等待不会阻塞，只建立上传写入到几何读取的内存依赖
+            wait_infos[1].setSemaphore( m_asset_loader->semaphore() );
+            wait_infos[1].setValue( m_asset_loader->ready_value() );
+            wait_infos[1].setStageMask( m_device->mesh_shader_supported()
+                ? vk::PipelineStageFlagBits2::eTaskShaderEXT | vk::PipelineStageFlagBits2::eMeshShaderEXT
+                : vk::PipelineStageFlagBits2::eVertexInput );
+            // 已切换的流送纹理上传同样已经完成，只建立上传写入到纹理采样的内存依赖
+            wait_infos[2].setSemaphore( m_texture_streamer->semaphore() );
+            wait_infos[2].setValue( m_texture_streamer->ready_value() );
+            wait_infos[2].setStageMask( vk::PipelineStageFlagBits2::eFragmentShader );
 
             // 渲染完成时发出信号
             std::array<vk::SemaphoreSubmitInfo,2> signal_infos;
@@ -125,24 +190,31 @@ export namespace vht {
             command_info.setCommandBuffer( m_command_buffers[m_current_frame] );
 
             vk::SubmitInfo2 submit_info;
-            submit_info.setWaitSemaphoreInfos( wait_image );
+            submit_info.setWaitSemaphoreInfos( wait_infos );
             submit_info.setSignalSemaphoreInfos( signal_infos );
             submit_info.setCommandBufferInfos( command_info );
 
-            // 提交命令缓冲区到图形队列
-            m_device->graphics_queue().submit2( submit_info );
-
             // 设置呈现信息
             vk::PresentInfoKHR present_info;
             present_info.setWaitSemaphores( *m_present_semaphores[m_current_frame] );
             present_info.setSwapchains( *m_swapchain->swapchain() );
             present_info.pImageIndices = &image_index;
-            // 提交呈现命令
-            try{
-                if(  m_device->present_queue().presentKHR(present_info) == vk::Result::eSuboptimalKHR ) {
-                    m_render_pass->recreate();
+
+            bool out_of_date = false;
+            {
+                // 加载线程也会向队列提交，提交与呈现需持有队列互斥锁
+                const std::scoped_lock lock{ m_device->queue_mutex() };
+                // 提交命令缓冲区到图形队列
+                m_device->graphics_queue().submit2( submit_info );
+                // 提交呈现命令
+                try{
+                    out_of_date = m_device->present_queue().presentKHR(present_info) == vk::Result::eSuboptimalKHR;
+                } catch (const vk::OutOfDateKHRError&){
+                    out_of_date = true;
                 }
-            } catch (const vk::OutOfDateKHRError&){
+            }
+            // 重建交换链会等待设备空闲，需在释放队列互斥锁之后进行
+            if (out_of_date) {
                 m_render_pass->recreate();
             }
             // 检查窗口是否被调整大小
@@ -157,6 +229,37 @@ export namespace vht {
         void init() {
             create_sync_object();
             create_command_buffers();
+            create_timestamp_pool();
+        }
+        // 创建时间戳查询池，每个飞行中的帧使用两个查询
+        void create_timestamp_pool() {
+            const auto graphics_family = m_device->queue_family_indices().graphics_family.value();
+            const auto families = m_device->physical_device().getQueueFamilyProperties();
+            if (families[graphics_family].timestampValidBits == 0) {
+                std::println("graphics queue does not support timestamps, gpu frame time disabled");
+                return;
+            }
+            m_timestamp_period = m_device->physical_device().getProperties().limits.timestampPeriod;
+            vk::QueryPoolCreateInfo create_info;
+            create_info.queryType = vk::QueryType::eTimestamp;
+            create_info.queryCount = 2 * MAX_FRAMES_IN_FLIGHT;
+            m_timestamp_pool = m_device->device().createQueryPool( create_info );
+        }
+        // 读取当前帧上一次使用时写入的时间戳，帧已完成，不会等待
+        void read_timestamps() {
+            if (!m_timestamp_written[m_current_frame]) return;
+            m_timestamp_written[m_current_frame] = false;
+            const auto [result, values] = m_timestamp_pool.getResults<std::uint64_t>(
+                2 * m_current_frame, 2, 2 * sizeof(std::uint64_t), sizeof(std::uint64_t), vk::QueryResultFlagBits::e64
+            );
+            if (result != vk::Result::eSuccess) return;
+            m_gpu_time_sum += static_cast<double>(values[1] - values[0]) * m_timestamp_period * 1e-6;
+            if (++m_gpu_time_count == GPU_TIME_FRAMES) {
+                m_gpu_frame_time = m_gpu_time_sum / GPU_TIME_FRAMES;
+                std::println("gpu frame time: {:.3f} ms", m_gpu_frame_time);
+                m_gpu_time_sum = 0.0;
+                m_gpu_time_count = 0;
+            }
         }
         // 创建命令缓冲区
         void create_command_buffers() {
@@ -185,9 +288,57 @@ export namespace vht {
                 m_time_semaphores.emplace_back( m_device->device().createSemaphore(time_info.get()) );
             }
         }
+        /**
+         * @brief 按屏幕空间误差为每个网格选择 LOD
+         * @details
+         * LOD 的几何误差乘以网格的缩放后，按包围球到相机的最近距离投影到屏幕，
+         * 选择投影误差不超过 LOD_PIXEL_ERROR 像素的最粗糙层级。相机位于包围球内时使用原始网格
+         */
+        [[nodiscard]]
+        std::size_t select_lod(const MeshDraw& draw) const {
+            const auto& ubo = m_uniform_buffer->ubo();
+            const glm::mat4 model = ubo.model * draw.transform;
+            const float scale = std::max({
+                glm::length(glm::vec3(model[0])),
+                glm::length(glm::vec3(model[1])),
+                glm::length(glm::vec3(model[2]))
+            });
+            const glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(draw.bounds), 1.0f));
+            const glm::vec3 camera = glm::vec3(glm::inverse(ubo.view)[3]);
+            const float distance = glm::length(camera - center) - draw.bounds.w * scale;
+
+            std::size_t selected = 0;
+            if (distance > 0.0f) {
+                // proj[1][1] 为 cot(fov / 2)，距离 distance 处单位长度在屏幕上的像素数
+                const float pixels_per_unit = std::abs(ubo.proj[1][1]) * 0.5f *
+                    static_cast<float>(m_swapchain->extent().height) / distance;
+                for (std::size_t level = 0; level < draw.lods.size(); ++level) {
+                    if (draw.lods[level].error * scale * pixels_per_unit <= LOD_PIXEL_ERROR) selected = level;
+                }
+            }
+            return selected;
+        }
+        // 选择当前帧所有网格的 LOD，并统计提交的三角形数量
+        void select_lods() {
+            const auto& draws = m_input_assembly->draws();
+            std::vector<std::size_t> lods(draws.size(), 0);
+            std::uint64_t triangles = 0;
+            for (std::size_t i = 0; i < draws.size(); ++i) {
+                if (draws[i].lods.empty()) continue;
+                lods[i] = select_lod(draws[i]);
+                triangles += draws[i].lods[lods[i]].index_count / 3;
+            }
+            m_lods = std::move(lods);
+            m_submitted_triangles = triangles;
+        }
         // 记录命令缓冲区
         void record_command_buffer(const vk::raii::CommandBuffer& command_buffer, const std::uint32_t image_index) const {
             command_buffer.begin( vk::CommandBufferBeginInfo{} );
+            const auto first_query = static_cast<std::uint32_t>(2 * m_current_frame);
+            if (*m_timestamp_pool) {
+                command_buffer.resetQueryPool( m_timestamp_pool, first_query, 2 );
+                command_buffer.writeTimestamp2( vk::PipelineStageFlagBits2::eTopOfPipe, m_timestamp_pool, first_query );
+            }
 
             vk::RenderPassBeginInfo render_pass_begin_info;
             render_pass_begin_info.renderPass = m_render_pass->render_pass();
@@ -203,8 +354,6 @@ export namespace vht {
 
             command_buffer.beginRenderPass( render_pass_begin_info, vk::SubpassContents::eInline);
 
-            command_buffer.bindPipeline( vk::PipelineBindPoint::eGraphics, m_graphics_pipeline->pipeline() );
-
             const vk::Viewport viewport(
                 0.0f, 0.0f,         // x, y
                 static_cast<float>(m_swapchain->extent().width),    // width
@@ -219,8 +368,23 @@ export namespace vht {
             );
             command_buffer.setScissor(0, scissor);
 
+            if (m_mesh_pipeline->supported()) {
+                record_mesh_draw(command_buffer);
+            } else {
+                record_vertex_draw(command_buffer);
+            }
+
+            command_buffer.endRenderPass();
+            if (*m_timestamp_pool) {
+                command_buffer.writeTimestamp2( vk::PipelineStageFlagBits2::eBottomOfPipe, m_timestamp_pool, first_query + 1 );
+            }
+            command_buffer.end();
+        }
+        // 顶点着色器路径：索引绘制
+        void record_vertex_draw(const vk::raii::CommandBuffer& command_buffer) const {
+            command_buffer.bindPipeline( vk::PipelineBindPoint::eGraphics, m_graphics_pipeline->pipeline() );
+
             command_buffer.bindVertexBuffers( 0, *m_input_assembly->vertex_buffer(), vk::DeviceSize{ 0 } );
-            command_buffer.bindIndexBuffer( m_input_assembly->index_buffer(), 0, vk::IndexType::eUint32 );
 
             const std::array<vk::DescriptorSet,2> descriptor_sets = {
                 m_descriptor->ubo_sets()[m_current_frame],
@@ -235,10 +399,73 @@ export namespace vht {
                 nullptr
             );
 
-            command_buffer.drawIndexed(static_cast<std::uint32_t>(m_data_loader->indices().size()), 1, 0, 0, 0);
+            const auto& draws = m_input_assembly->draws();
+            for (const auto index_type : { vk::IndexType::eUint16, vk::IndexType::eUint32 }) {
+                bool bound = false;
+                for (std::size_t i = 0; i < draws.size(); ++i) {
+                    if (draws[i].index_type != index_type || draws[i].lods.empty()) continue;
+                    if (!bound) {
+                        command_buffer.bindIndexBuffer( m_input_assembly->index_buffer(), 0, index_type );
+                        bound = true;
+                    }
+                    // 纹理随推送常量切换，不重新绑定描述符集
+                    const vht::DrawConstants constants{
+                        draws[i].transform,
+                        draws[i].quantization,
+                        m_texture_streamer->resolve(draws[i].texture_index),
+                        draws[i].sampler_index
+                    };
+                    command_buffer.pushConstants<vht::DrawConstants>(
+                        m_graphics_pipeline->pipeline_layout(),
+                        vht::DRAW_CONSTANT_STAGES,
+                        0,
+                        constants
+                    );
+                    const auto& lod = draws[i].lods[m_lods[i]];
+                    command_buffer.drawIndexed(lod.index_count, 1, lod.index_offset, draws[i].vertex_offset, 0);
+                }
+            }
+        }
+        // 网格着色器路径：每个任务工作组处理 32 个 meshlet，剔除后再分发网格着色器
+        void record_mesh_draw(const vk::raii::CommandBuffer& command_buffer) const {
+            command_buffer.bindPipeline( vk::PipelineBindPoint::eGraphics, m_mesh_pipeline->pipeline() );
 
-            command_buffer.endRenderPass();
-            command_buffer.end();
+            const std::array<vk::DescriptorSet,3> descriptor_sets = {
+                m_descriptor->ubo_sets()[m_current_frame],
+                m_descriptor->texture_set(),
+                m_descriptor->meshlet_set()
+            };
+
+            command_buffer.bindDescriptorSets(
+                vk::PipelineBindPoint::eGraphics,
+                m_mesh_pipeline->pipeline_layout(),
+                0,
+                descriptor_sets,
+                nullptr
+            );
+
+            const auto& draws = m_input_assembly->draws();
+            for (std::size_t i = 0; i < draws.size(); ++i) {
+                if (draws[i].lods.empty()) continue;
+                const auto& range = m_meshlet_assembly->lod_ranges()[i][m_lods[i]];
+                if (range.count == 0) continue;
+                const vht::MeshletConstants constants{
+                    draws[i].transform,
+                    draws[i].quantization,
+                    m_texture_streamer->resolve(draws[i].texture_index),
+                    draws[i].sampler_index,
+                    range.offset,
+                    range.count,
+                    static_cast<std::uint32_t>(draws[i].vertex_offset)
+                };
+                command_buffer.pushConstants<vht::MeshletConstants>(
+                    m_mesh_pipeline->pipeline_layout(),
+                    vht::MESHLET_CONSTANT_STAGES,
+                    0,
+                    constants
+                );
+                command_buffer.drawMeshTasksEXT((range.count + 31) / 32, 1, 1);
+            }
         }
     };
 }
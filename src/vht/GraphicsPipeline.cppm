@@ -2,52 +2,113 @@ export module GraphicsPipeline;
 
 import std;
 import vulkan_hpp;
+import glm;
 
-import DataLoader;
+import VertexFormat;
 import Tools;
 import Device;
-import RenderPass;
+import PipelineRegistry;
+import PipelineBuilder;
+import TextureTable;
 
 export namespace vht {
 
+    /**
+     * @brief 顶点着色器路径的逐绘制推送常量，布局与 shaders/graphics.vert.glsl 一致
+     * @details
+     * - transform: 网格的模型空间到世界空间的变换
+     * - quantization: 网格反量化参数
+     * - texture_index/sampler_index: 纹理表中的槽位，片段着色器在偏移 TEXTURE_CONSTANTS_OFFSET 处读取
+     */
+    struct DrawConstants {
+        glm::mat4 transform{ 1.0f };
+        MeshQuantization quantization{};
+        std::uint32_t texture_index{};
+        std::uint32_t sampler_index{};
+        std::array<std::uint32_t, 2> padding{};
+    };
+    // 纹理槽位在推送常量中的偏移，两条渲染路径相同，与 shaders/graphics.frag.glsl 一致
+    constexpr std::uint32_t TEXTURE_CONSTANTS_OFFSET = 96;
+    static_assert(sizeof(glm::mat4) + sizeof(MeshQuantization) == TEXTURE_CONSTANTS_OFFSET);
+    // 推送 DrawConstants 时使用的着色器阶段，需与管线布局中的范围一致
+    constexpr vk::ShaderStageFlags DRAW_CONSTANT_STAGES = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+
     /**
      * @brief 图形管线相关
      * @details
      * - 依赖：
      *  - m_device: 逻辑设备与队列
-     *  - m_render_pass: 渲染通道
+     *  - m_pipeline_registry: 管线注册表
+     *  - m_texture_table: 无绑定纹理表，提供集合 1 的布局
      * - 工作：
-     *  - 创建描述符集布局
-     *  - 创建图形管线布局和图形管线
+     *  - 创建集合 0 的 UBO 描述符集布局
+     *  - 创建图形管线布局；管线由 PipelineBuilder 按 description() 向 m_pipeline_registry 请求后通过 replace() 设置
      * - 可访问成员：
-     *  - descriptor_set_layout(): 描述符集布局
+     *  - descriptor_set_layouts(): 集合 0 的描述符集布局
+     *  - set_layouts(): 管线布局使用的所有集合的布局，网格着色器管线在此基础上追加
      *  - pipeline_layout(): 管线布局
-     *  - pipeline(): 图形管线
+     *  - pipeline(): 图形管线，由 m_pipeline_registry 持有
+     *  - shader_sources(): 管线使用的着色器源文件
+     *  - description(): 创建管线的描述，提交给 PipelineBuilder 在工作线程中创建
+     *  - replace(): 设置创建完成的管线，着色器热重载时在帧边界替换
      */
     class GraphicsPipeline {
+        static constexpr std::array<std::string_view, 2> SHADER_SOURCES{
+            "shaders/graphics.vert.glsl",
+            "shaders/graphics.frag.glsl"
+        };
         std::shared_ptr<vht::Device> m_device;
-        std::shared_ptr<vht::RenderPass> m_render_pass;
+        std::shared_ptr<vht::PipelineRegistry> m_pipeline_registry;
+        std::shared_ptr<vht::TextureTable> m_texture_table;
         std::vector<vk::raii::DescriptorSetLayout> m_descriptor_set_layouts;
         vk::raii::PipelineLayout m_pipeline_layout{ nullptr };
-        vk::raii::Pipeline m_pipeline{ nullptr };
+        vk::Pipeline m_pipeline;
     public:
-        explicit GraphicsPipeline(std::shared_ptr<vht::Device> device, std::shared_ptr<vht::RenderPass> render_pass)
-        :   m_device(std::move(device)),
-            m_render_pass(std::move(render_pass)) {
+        explicit GraphicsPipeline(
+            std::shared_ptr<vht::Device> device,
+            std::shared_ptr<vht::PipelineRegistry> pipeline_registry,
+            std::shared_ptr<vht::TextureTable> texture_table
+        ):  m_device(std::move(device)),
+            m_pipeline_registry(std::move(pipeline_registry)),
+            m_texture_table(std::move(texture_table)) {
             init();
         }
 
         [[nodiscard]]
         const std::vector<vk::raii::DescriptorSetLayout>& descriptor_set_layouts() const { return m_descriptor_set_layouts; }
         [[nodiscard]]
+        std::vector<vk::DescriptorSetLayout> set_layouts() const {
+            // 将 raii 类型转换回 vk::DescriptorSetLayout
+            auto set_layouts = m_descriptor_set_layouts
+                | std::views::transform([](const auto& layout) -> vk::DescriptorSetLayout { return layout; })
+                | std::ranges::to<std::vector>();
+            set_layouts.push_back( m_texture_table->set_layout() );
+            return set_layouts;
+        }
+        [[nodiscard]]
         const vk::raii::PipelineLayout& pipeline_layout() const { return m_pipeline_layout; }
         [[nodiscard]]
-        const vk::raii::Pipeline& pipeline() const { return m_pipeline; }
+        vk::Pipeline pipeline() const { return m_pipeline; }
+        [[nodiscard]]
+        static std::span<const std::string_view> shader_sources() { return SHADER_SOURCES; }
+
+        /**
+         * @brief 用当前的着色器源码创建管线的描述
+         * @details 创建时只读取管线布局，可以在工作线程中执行；本对象需在管线创建完成前保持存在
+         */
+        [[nodiscard]]
+        PipelineDescription description() const { return { "graphics", [this] { return build_pipeline(); } }; }
+
+        /**
+         * @brief 设置或替换管线，只能在主线程中、不记录命令时调用
+         * @details 释放被替换管线的引用，m_pipeline_registry 等正在执行的帧结束后再销毁它
+         */
+        void replace(const vk::Pipeline pipeline) { m_pipeline_registry->release(std::exchange(m_pipeline, pipeline)); }
 
     private:
         void init() {
             create_descriptor_set_layout();
-            create_graphics_pipeline();
+            create_pipeline_layout();
         }
         // 创建描述符集布局
         void create_descriptor_set_layout() {
@@ -56,112 +117,40 @@ export namespace vht {
             uboLayoutBinding.descriptorType = vk::DescriptorType::eUniformBuffer;
             uboLayoutBinding.descriptorCount = 1;
             uboLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eVertex;
+            // 网格着色器路径与顶点着色器路径共用同一个 UBO 集合
+            if (m_device->mesh_shader_supported()) {
+                uboLayoutBinding.stageFlags |= vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
+            }
 
             vk::DescriptorSetLayoutCreateInfo uboLayoutInfo;
             uboLayoutInfo.setBindings( uboLayoutBinding );
             m_descriptor_set_layouts.emplace_back( m_device->device().createDescriptorSetLayout( uboLayoutInfo ) );
-
-            vk::DescriptorSetLayoutBinding samplerLayoutBinding;
-            samplerLayoutBinding.binding = 0;
-            samplerLayoutBinding.descriptorType = vk::DescriptorType::eCombinedImageSampler;
-            samplerLayoutBinding.descriptorCount = 1;
-            samplerLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eFragment;
-            vk::DescriptorSetLayoutCreateInfo samplerLayoutInfo;
-
-            samplerLayoutInfo.setBindings( samplerLayoutBinding );
-            m_descriptor_set_layouts.emplace_back( m_device->device().createDescriptorSetLayout( samplerLayoutInfo ) );
         }
-        // 创建图形管线
-        void create_graphics_pipeline() {
-            const auto vertex_shader_code = vht::read_shader("shaders/graphics.vert.spv");
-            const auto fragment_shader_code = vht::read_shader("shaders/graphics.frag.spv");
-            const auto vertex_shader_module = vht::create_shader_module(m_device->device(), vertex_shader_code);
-            const auto fragment_shader_module = vht::create_shader_module(m_device->device(), fragment_shader_code);
-            vk::PipelineShaderStageCreateInfo vertex_shader_create_info;
-            vertex_shader_create_info.stage = vk::ShaderStageFlagBits::eVertex;
-            vertex_shader_create_info.module = vertex_shader_module;
-            vertex_shader_create_info.pName = "main";
-
-            vk::PipelineShaderStageCreateInfo fragment_shader_create_info;
-            fragment_shader_create_info.stage = vk::ShaderStageFlagBits::eFragment;
-            fragment_shader_create_info.module = fragment_shader_module;
-            fragment_shader_create_info.pName = "main";
-
-            const auto shader_stages = { vertex_shader_create_info, fragment_shader_create_info };
-
-            const auto dynamic_states = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
-            vk::PipelineDynamicStateCreateInfo dynamic_state;
-            dynamic_state.setDynamicStates(dynamic_states);
-
-            const auto binding_description = vht::Vertex::get_binding_description();
-            const auto attribute_description = vht::Vertex::get_attribute_description();
-            vk::PipelineVertexInputStateCreateInfo vertex_input;
-            vertex_input.setVertexBindingDescriptions(binding_description);
-            vertex_input.setVertexAttributeDescriptions(attribute_description);
-
-            vk::PipelineInputAssemblyStateCreateInfo input_assembly;
-            input_assembly.topology = vk::PrimitiveTopology::eTriangleList;
-
-            vk::PipelineViewportStateCreateInfo viewport_state;
-            viewport_state.viewportCount = 1;
-            viewport_state.scissorCount = 1;
-
-            vk::PipelineDepthStencilStateCreateInfo depth_stencil;
-            depth_stencil.depthTestEnable = true;
-            depth_stencil.depthWriteEnable = true;
-            depth_stencil.depthCompareOp = vk::CompareOp::eLess;
-            depth_stencil.depthBoundsTestEnable = false; // Optional
-            depth_stencil.stencilTestEnable = false; // Optional
-
-            vk::PipelineRasterizationStateCreateInfo rasterizer;
-            rasterizer.depthClampEnable = false;
-            rasterizer.rasterizerDiscardEnable = false;
-            rasterizer.polygonMode = vk::PolygonMode::eFill;
-            rasterizer.lineWidth = 1.0f;
-            rasterizer.cullMode = vk::CullModeFlagBits::eBack;
-            rasterizer.frontFace = vk::FrontFace::eCounterClockwise;
-            rasterizer.depthBiasEnable = false;
-
-            vk::PipelineMultisampleStateCreateInfo multisampling;
-            multisampling.rasterizationSamples =  vk::SampleCountFlagBits::e1;
-            multisampling.sampleShadingEnable = false;  // default
-
-            vk::PipelineColorBlendAttachmentState color_blend_attachment;
-            color_blend_attachment.blendEnable = false; // default
-            color_blend_attachment.colorWriteMask = vk::FlagTraits<vk::ColorComponentFlagBits>::allFlags;
-
-            vk::PipelineColorBlendStateCreateInfo color_blend;
-            color_blend.logicOpEnable = false;
-            color_blend.logicOp = vk::LogicOp::eCopy;
-            color_blend.setAttachments( color_blend_attachment );
-
+        // 创建管线布局，重建管线时不变
+        void create_pipeline_layout() {
             vk::PipelineLayoutCreateInfo layout_create_info;
 
-            // 将 raii 类型转换回 vk::DescriptorSetLayout
-            const auto set_layouts = m_descriptor_set_layouts
-                | std::views::transform([](const auto& layout) -> vk::DescriptorSetLayout { return layout; })
-                | std::ranges::to<std::vector>();
-
+            const auto set_layouts = this->set_layouts();
             layout_create_info.setSetLayouts( set_layouts );
+            // 顶点着色器使用网格反量化参数，片段着色器使用纹理槽位
+            vk::PushConstantRange push_constant_range;
+            push_constant_range.stageFlags = DRAW_CONSTANT_STAGES;
+            push_constant_range.offset = 0;
+            push_constant_range.size = sizeof(vht::DrawConstants);
+            layout_create_info.setPushConstantRanges( push_constant_range );
             m_pipeline_layout = m_device->device().createPipelineLayout( layout_create_info );
-
-            vk::GraphicsPipelineCreateInfo create_info;
-            create_info.layout = m_pipeline_layout;
-
-            create_info.setStages( shader_stages );
-            create_info.pVertexInputState =  &vertex_input;
-            create_info.pInputAssemblyState = &input_assembly;
-            create_info.pDynamicState = &dynamic_state;
-            create_info.pViewportState = &viewport_state;
-            create_info.pDepthStencilState = &depth_stencil;
-            create_info.pRasterizationState = &rasterizer;
-            create_info.pMultisampleState = &multisampling;
-            create_info.pColorBlendState = &color_blend;
-
-            create_info.renderPass = m_render_pass->render_pass();
-            create_info.subpass = 0;
-
-            m_pipeline = m_device->device().createGraphicsPipeline( nullptr, create_info );
+        }
+        // 向注册表请求图形管线，固定功能状态使用默认值
+        [[nodiscard]]
+        vk::Pipeline build_pipeline() const {
+            PipelineState state;
+            state.name = "graphics";
+            state.shaders = {
+                { vk::ShaderStageFlagBits::eVertex, SHADER_SOURCES[0] },
+                { vk::ShaderStageFlagBits::eFragment, SHADER_SOURCES[1] }
+            };
+            state.layout = m_pipeline_layout;
+            return m_pipeline_registry->request(state);
         }
     };
 }
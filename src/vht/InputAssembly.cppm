@@ -2,131 +2,171 @@ export module InputAssembly;
 
 import std;
 import vulkan_hpp;
+import glm;
 
+import Config;
 import DataLoader;
+import MeshCache;
 import Tools;
 import Device;
-import CommandPool;
+import MemoryAllocator;
+import UploadBatcher;
+import VertexFormat;
 
 export namespace vht {
 
+    /**
+     * @brief 场景中一个网格的绘制参数
+     * @details
+     * - vertex_offset: 网格第一个顶点在顶点缓冲区中的位置，作为绘制命令的 vertexOffset
+     * - index_type: 网格的索引类型
+     * - lods: 网格的 LOD 链，index_offset 已换算为在索引缓冲区中以 index_type 为单位的位置，作为绘制命令的 firstIndex
+     * - bounds: 模型空间的包围球
+     * - transform: 模型空间到世界空间的变换
+     * - quantization: 网格的反量化参数
+     * - texture_index/sampler_index: 纹理表中的槽位，默认使用第一个注册的纹理与采样器
+     */
+    struct MeshDraw {
+        std::int32_t vertex_offset{};
+        vk::IndexType index_type{ vk::IndexType::eUint16 };
+        std::vector<MeshLod> lods;
+        glm::vec4 bounds{ 0.0f };
+        glm::mat4 transform{ 1.0f };
+        MeshQuantization quantization{};
+        std::uint32_t texture_index{};
+        std::uint32_t sampler_index{};
+    };
+
     /**
      * @brief 输入装配相关
      * @details
      * - 依赖：
-     *  - m_data_loader: 数据加载器
      *  - m_device: 逻辑设备与队列
-     *  - m_command_pool: 命令池
+     *  - m_allocator: 设备内存分配器
      * - 工作：
-     *  - 将模型数组载入缓冲区
+     *  - 创建固定容量的共享顶点缓冲区和索引缓冲区，场景中的网格依次放入其中
+     *  - upload_mesh() 为网格分配区域并记录上传命令，由加载线程调用，只能在一个线程中使用
+     *  - 顶点按 DeviceVertex 格式直接编码进暂存区，每个网格使用自己的反量化参数
+     *  - 索引保留网格自身的索引类型，16 位与 32 位索引共用同一个缓冲区，区域按 4 字节对齐
+     *  - 上传完成后由主线程调用 add_draw() 把网格加入绘制列表
+     *  - 缓冲区在队列族之间并发共享，上传与绘制之间由时间线信号量同步，不做所有权转移
      * - 可访问成员：
      *  - vertex_buffer(): 顶点缓冲区
      *  - index_buffer(): 索引缓冲区
+     *  - draws(): 可绘制网格的绘制参数
      */
     class InputAssembly {
-        std::shared_ptr<vht::DataLoader> m_data_loader{ nullptr };
         std::shared_ptr<vht::Device> m_device{ nullptr };
-        std::shared_ptr<vht::CommandPool> m_command_pool{ nullptr };
-        vk::raii::DeviceMemory m_vertex_memory{ nullptr };
+        std::shared_ptr<vht::MemoryAllocator> m_allocator{ nullptr };
+        vht::Allocation m_vertex_allocation{ nullptr };
         vk::raii::Buffer m_vertex_buffer{ nullptr };
-        vk::raii::DeviceMemory m_index_memory{ nullptr };
+        vht::Allocation m_index_allocation{ nullptr };
         vk::raii::Buffer m_index_buffer{ nullptr };
+        std::uint64_t m_vertex_head{ 0 };   // 已分配的顶点数量，只由加载线程访问
+        std::uint64_t m_index_head{ 0 };    // 已分配的索引字节数，只由加载线程访问
+        std::vector<MeshDraw> m_draws;      // 只由主线程访问
     public:
         explicit InputAssembly(
-            std::shared_ptr<vht::DataLoader> data_loader,
             std::shared_ptr<vht::Device> device,
-            std::shared_ptr<vht::CommandPool> command_pool
-        ):  m_data_loader(std::move(data_loader)),
-            m_device(std::move(device)),
-            m_command_pool(std::move(command_pool)) {
+            std::shared_ptr<vht::MemoryAllocator> allocator
+        ):  m_device(std::move(device)),
+            m_allocator(std::move(allocator)) {
             init();
         }
         [[nodiscard]]
         const vk::raii::Buffer& vertex_buffer() const { return m_vertex_buffer; }
         [[nodiscard]]
         const vk::raii::Buffer& index_buffer() const { return m_index_buffer; }
+        [[nodiscard]]
+        const std::vector<MeshDraw>& draws() const { return m_draws; }
+
+        /**
+         * @brief 为网格分配顶点与索引区域，并记录上传命令
+         * @return 网格的绘制参数，transform 由调用者设置
+         * @throw std::runtime_error 共享缓冲区容量不足
+         */
+        [[nodiscard]]
+        MeshDraw upload_mesh(const vht::DataLoader& data, vht::UploadBatcher& upload_batcher) {
+            const auto vertices = data.vertices();
+            const auto index_data = data.index_data();
+            const std::uint64_t index_size = data.index_type() == vk::IndexType::eUint16 ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+            const std::uint64_t index_offset = (m_index_head + 3) & ~std::uint64_t{ 3 };
+            if (m_vertex_head + vertices.size() > GEOMETRY_VERTEX_CAPACITY ||
+                index_offset + index_data.size() > GEOMETRY_INDEX_BYTES) {
+                throw std::runtime_error("geometry buffers are full!");
+            }
+
+            MeshDraw draw;
+            draw.vertex_offset = static_cast<std::int32_t>(m_vertex_head);
+            draw.index_type = data.index_type();
+            for (MeshLod lod : data.lods()) {
+                lod.index_offset += static_cast<std::uint32_t>(index_offset / index_size);
+                draw.lods.push_back(lod);
+            }
+            draw.bounds = data.bounds();
+            draw.quantization = vht::DeviceVertex::quantization(vertices);
+
+            // 在暂存区中直接编码，不经过中间数组
+            if (!vertices.empty()) {
+                const vk::DeviceSize size = sizeof(vht::DeviceVertex) * vertices.size();
+                const auto region = upload_batcher.reserve(size);
+                const auto encoded = static_cast<vht::DeviceVertex*>(region.data);
+                for (std::size_t i = 0; i < vertices.size(); ++i) {
+                    encoded[i] = vht::DeviceVertex::encode(vertices[i], draw.quantization);
+                }
+                upload_batcher.copy_buffer(region, m_vertex_buffer, sizeof(vht::DeviceVertex) * m_vertex_head, size);
+            }
+            if (!index_data.empty()) {
+                upload_batcher.upload_buffer(index_data.data(), index_data.size(), m_index_buffer, index_offset);
+            }
+            m_vertex_head += vertices.size();
+            m_index_head = index_offset + index_data.size();
+            return draw;
+        }
+
+        // 把上传完成的网格加入绘制列表，只能在主线程调用
+        void add_draw(MeshDraw draw) { m_draws.push_back(std::move(draw)); }
 
     private:
         void init() {
             create_vertex_buffer();
             create_index_buffer();
         }
+        // 上传在传输队列族上进行，绘制在图形队列族上进行
+        [[nodiscard]]
+        std::array<std::uint32_t, 2> queue_families() const {
+            const auto indices = m_device->queue_family_indices();
+            return { indices.graphics_family.value(), indices.transfer_family.value() };
+        }
         // 创建顶点缓冲区
         void create_vertex_buffer() {
-            const vk::DeviceSize buffer_size = sizeof(vht::Vertex) * m_data_loader->vertices().size();
-            vk::raii::DeviceMemory staging_memory{ nullptr };
-            vk::raii::Buffer staging_buffer{ nullptr };
-            vht::create_buffer(
-                staging_buffer,
-                staging_memory,
-                m_device->device(),
-                m_device->physical_device(),
-                buffer_size,
-                vk::BufferUsageFlagBits::eTransferSrc,
-                vk::MemoryPropertyFlagBits::eHostVisible |
-                vk::MemoryPropertyFlagBits::eHostCoherent
-            );
-            void* data = staging_memory.mapMemory(0, buffer_size);
-            std::memcpy(data, m_data_loader->vertices().data(), buffer_size);
-            staging_memory.unmapMemory();
             vht::create_buffer(
                 m_vertex_buffer,
-                m_vertex_memory,
+                m_vertex_allocation,
                 m_device->device(),
-                m_device->physical_device(),
-                buffer_size,
+                *m_allocator,
+                sizeof(vht::DeviceVertex) * GEOMETRY_VERTEX_CAPACITY,
                 vk::BufferUsageFlagBits::eTransferDst |
-                vk::BufferUsageFlagBits::eVertexBuffer,
-                vk::MemoryPropertyFlagBits::eDeviceLocal
-            );
-            vht::copy_buffer(
-                m_command_pool->pool(),
-                m_device->device(),
-                m_device->graphics_queue(),
-                staging_buffer,
-                m_vertex_buffer,
-                buffer_size
+                vk::BufferUsageFlagBits::eVertexBuffer |
+                vk::BufferUsageFlagBits::eStorageBuffer, // 网格着色器以存储缓冲区读取顶点
+                vk::MemoryPropertyFlagBits::eDeviceLocal,
+                queue_families()
             );
         }
         // 创建索引缓冲区
         void create_index_buffer() {
-            const vk::DeviceSize buffer_size = sizeof(std::uint32_t) * m_data_loader->indices().size();
-            vk::raii::DeviceMemory staging_memory{ nullptr };
-            vk::raii::Buffer staging_buffer{ nullptr };
-            vht::create_buffer(
-                staging_buffer,
-                staging_memory,
-                m_device->device(),
-                m_device->physical_device(),
-                buffer_size,
-                vk::BufferUsageFlagBits::eTransferSrc,
-                vk::MemoryPropertyFlagBits::eHostVisible |
-                vk::MemoryPropertyFlagBits::eHostCoherent
-
-            );
-            void* data = staging_memory.mapMemory(0, buffer_size);
-            std::memcpy(data, m_data_loader->indices().data(), static_cast<std::size_t>(buffer_size));
-            staging_memory.unmapMemory();
             vht::create_buffer(
                 m_index_buffer,
-                m_index_memory,
+                m_index_allocation,
                 m_device->device(),
-                m_device->physical_device(),
-                buffer_size,
+                *m_allocator,
+                GEOMETRY_INDEX_BYTES,
                 vk::BufferUsageFlagBits::eTransferDst |
                 vk::BufferUsageFlagBits::eIndexBuffer,
-                vk::MemoryPropertyFlagBits::eDeviceLocal
-            );
-            vht::copy_buffer(
-                m_command_pool->pool(),
-                m_device->device(),
-                m_device->graphics_queue(),
-                staging_buffer,
-                m_index_buffer,
-                buffer_size
+                vk::MemoryPropertyFlagBits::eDeviceLocal,
+                queue_families()
             );
         }
 
     };
 }
-
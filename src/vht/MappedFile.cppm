@@ -0,0 +1,115 @@
+module;
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+export module MappedFile;
+
+import std;
+
+export namespace vht {
+
+    /**
+     * @brief 只读内存映射文件
+     * @details
+     * - 工作：
+     *  - 将整个文件映射到进程地址空间，避免逐块读取和额外复制
+     *  - 析构时解除映射并关闭文件
+     *  - 空文件不进行映射，data() 返回 nullptr
+     * - 可访问成员：
+     *  - data(): 文件内容的起始地址
+     *  - size(): 文件大小
+     *  - view(): 以字符串视图访问文件内容
+     */
+    class MappedFile {
+        const char* m_data{ nullptr };
+        std::size_t m_size{ 0 };
+#ifdef _WIN32
+        HANDLE m_file{ INVALID_HANDLE_VALUE };
+        HANDLE m_mapping{ nullptr };
+#endif
+    public:
+        explicit MappedFile(const std::string& path) {
+            init(path);
+        }
+        ~MappedFile() { close(); }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        [[nodiscard]]
+        const char* data() const { return m_data; }
+        [[nodiscard]]
+        std::size_t size() const { return m_size; }
+        [[nodiscard]]
+        std::string_view view() const { return { m_data, m_size }; }
+
+    private:
+#ifdef _WIN32
+        void init(const std::string& path) {
+            m_file = CreateFileA(
+                path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr
+            );
+            if (m_file == INVALID_HANDLE_VALUE) throw std::runtime_error("failed to open file: " + path);
+            LARGE_INTEGER size{};
+            if (!GetFileSizeEx(m_file, &size)) {
+                close();
+                throw std::runtime_error("failed to get file size: " + path);
+            }
+            m_size = static_cast<std::size_t>(size.QuadPart);
+            if (m_size == 0) return;
+            m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (m_mapping != nullptr) {
+                m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+            }
+            if (m_data == nullptr) {
+                close();
+                throw std::runtime_error("failed to map file: " + path);
+            }
+        }
+        void close() {
+            if (m_data != nullptr) UnmapViewOfFile(m_data);
+            if (m_mapping != nullptr) CloseHandle(m_mapping);
+            if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+            m_data = nullptr;
+            m_mapping = nullptr;
+            m_file = INVALID_HANDLE_VALUE;
+        }
+#else
+        void init(const std::string& path) {
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) throw std::runtime_error("failed to open file: " + path);
+            struct stat info{};
+            if (::fstat(fd, &info) != 0) {
+                ::close(fd);
+                throw std::runtime_error("failed to get file size: " + path);
+            }
+            m_size = static_cast<std::size_t>(info.st_size);
+            if (m_size == 0) {
+                ::close(fd);
+                return;
+            }
+            void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            // 映射建立后文件描述符可以立即关闭
+            ::close(fd);
+            if (data == MAP_FAILED) throw std::runtime_error("failed to map file: " + path);
+            ::madvise(data, m_size, MADV_SEQUENTIAL);
+            m_data = static_cast<const char*>(data);
+        }
+        void close() {
+            if (m_data != nullptr) ::munmap(const_cast<char*>(m_data), m_size);
+            m_data = nullptr;
+        }
+#endif
+    };
+
+}
@@ -0,0 +1,384 @@
+export module MemoryAllocator;
+
+import std;
+import vulkan_hpp;
+
+import Config;
+import Device;
+
+namespace vht {
+
+    /**
+     * @brief 一块真实的设备内存，内部按空闲链表进行子分配
+     * @details
+     * - free_ranges: 空闲区间，键为偏移，值为大小，相邻区间在释放时合并
+     * - mapped: 主机可见内存在创建时持久映射，其余为 nullptr
+     * - dedicated: 为大资源单独分配的内存块，归还后立即释放
+     */
+    struct MemoryBlock {
+        vk::raii::DeviceMemory memory{ nullptr };
+        vk::DeviceSize size{};
+        vk::DeviceSize used{};
+        void* mapped{ nullptr };
+        std::map<vk::DeviceSize, vk::DeviceSize> free_ranges;
+        std::uint32_t allocation_count{};
+        bool dedicated{ false };
+    };
+
+    /**
+     * @brief 同一内存类型、同一资源种类的内存块集合
+     */
+    struct MemoryPool {
+        std::uint32_t memory_type_index{};
+        std::uint32_t heap_index{};
+        bool host_visible{ false };
+        std::vector<std::unique_ptr<MemoryBlock>> blocks;
+    };
+
+}
+
+export namespace vht {
+
+    /**
+     * @brief 资源种类
+     * @details
+     * bufferImageGranularity 要求线性资源（缓冲区、线性图像）与最优平铺图像
+     * 在同一内存中相邻时按粒度隔开。不同种类使用不同的内存块，从而不会相邻。
+     */
+    enum class ResourceKind : std::uint8_t {
+        eLinear,
+        eOptimal
+    };
+
+    /**
+     * @brief 单个内存池的统计信息
+     * @details
+     * - reserved: 已向驱动申请的字节数
+     * - used: 已分配给资源的字节数
+     * - largest_free: 最大的连续空闲区间，与 reserved - used 对比可看出碎片程度
+     */
+    struct MemoryStats {
+        std::uint32_t memory_type_index{};
+        std::uint32_t heap_index{};
+        ResourceKind kind{};
+        std::uint32_t block_count{};
+        std::uint32_t allocation_count{};
+        vk::DeviceSize reserved{};
+        vk::DeviceSize used{};
+        vk::DeviceSize largest_free{};
+    };
+
+    class MemoryAllocator;
+
+    /**
+     * @brief 子分配得到的一段设备内存
+     * @details
+     * 与 vk::raii 类型一样只能移动，析构时自动归还给分配器。
+     * - memory(): 所在的设备内存
+     * - offset(): 在设备内存中的偏移
+     * - size(): 分配的大小
+     * - mapped(): 持久映射的地址，非主机可见内存为 nullptr
+     */
+    class Allocation {
+        friend class MemoryAllocator;
+        MemoryAllocator* m_allocator{ nullptr };
+        MemoryBlock* m_block{ nullptr };
+        std::size_t m_pool_index{};
+        vk::DeviceSize m_offset{};
+        vk::DeviceSize m_size{};
+    public:
+        Allocation() = default;
+        Allocation(std::nullptr_t) {}
+        Allocation(const Allocation&) = delete;
+        Allocation& operator=(const Allocation&) = delete;
+        Allocation(Allocation&& other) noexcept { swap(other); }
+        Allocation& operator=(Allocation&& other) noexcept {
+            if (this != &other) {
+                release();
+                swap(other);
+            }
+            return *this;
+        }
+        ~Allocation() { release(); }
+
+        [[nodiscard]]
+        vk::DeviceMemory memory() const { return m_block ? *m_block->memory : vk::DeviceMemory{}; }
+        [[nodiscard]]
+        vk::DeviceSize offset() const { return m_offset; }
+        [[nodiscard]]
+        vk::DeviceSize size() const { return m_size; }
+        [[nodiscard]]
+        void* mapped() const {
+            if (!m_block || !m_block->mapped) return nullptr;
+            return static_cast<std::byte*>(m_block->mapped) + m_offset;
+        }
+
+        // 提前归还内存
+        void release();
+    private:
+        void swap(Allocation& other) noexcept {
+            std::swap(m_allocator, other.m_allocator);
+            std::swap(m_block, other.m_block);
+            std::swap(m_pool_index, other.m_pool_index);
+            std::swap(m_offset, other.m_offset);
+            std::swap(m_size, other.m_size);
+        }
+    };
+
+    /**
+     * @brief 设备内存子分配器
+     * @details
+     * - 依赖：
+     *  - m_device: 物理/逻辑设备
+     * - 工作：
+     *  - 按内存类型和资源种类维护内存块，每块 MEMORY_BLOCK_SIZE 字节
+     *  - 在内存块内部用空闲链表（首次适配）进行带对齐的子分配
+     *  - 超过半个内存块的资源单独分配
+     *  - 主机可见内存块持久映射
+     * - 可访问成员：
+     *  - allocate(): 按内存需求分配
+     *  - stats(): 各内存池的统计信息
+     *  - print_stats(): 打印统计信息
+     * @warning 分配器必须比它分配出的所有 Allocation 存活得更久
+     */
+    class MemoryAllocator {
+        friend class Allocation;
+        std::shared_ptr<vht::Device> m_device{ nullptr };
+        vk::PhysicalDeviceMemoryProperties m_memory_properties{};
+        vk::DeviceSize m_granularity{ 1 };
+        std::uint32_t m_max_allocation_count{};
+        std::uint32_t m_device_allocation_count{};
+        std::vector<MemoryPool> m_pools;
+        mutable std::mutex m_mutex;
+    public:
+        explicit MemoryAllocator(std::shared_ptr<vht::Device> device)
+        :   m_device(std::move(device)) {
+            init();
+        }
+
+        MemoryAllocator(const MemoryAllocator&) = delete;
+        MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+        /**
+         * @brief 分配内存
+         * @param requirements 资源的内存需求
+         * @param properties 需要的内存属性
+         * @param kind 资源种类，用于满足 bufferImageGranularity
+         */
+        [[nodiscard]]
+        Allocation allocate(
+            const vk::MemoryRequirements& requirements,
+            const vk::MemoryPropertyFlags properties,
+            const ResourceKind kind
+        ) {
+            const std::uint32_t type_index = find_memory_type(requirements.memoryTypeBits, properties);
+            const std::size_t pool_index = pool_index_of(type_index, kind);
+            const vk::DeviceSize alignment = std::max<vk::DeviceSize>(requirements.alignment, 1);
+
+            std::lock_guard lock{ m_mutex };
+            MemoryPool& pool = m_pools[pool_index];
+
+            MemoryBlock* block = nullptr;
+            vk::DeviceSize offset = 0;
+            // 大资源单独分配，避免把内存块切得过碎
+            if (requirements.size > MEMORY_BLOCK_SIZE / 2) {
+                block = &create_block(pool, requirements.size);
+                block->dedicated = true;
+                block->free_ranges.clear();
+                block->used = requirements.size;
+                block->allocation_count = 1;
+            } else {
+                for (const auto& it : pool.blocks) {
+                    if (it->dedicated) continue;
+                    if (const auto result = allocate_in_block(*it, requirements.size, alignment)) {
+                        block = it.get();
+                        offset = *result;
+                        break;
+                    }
+                }
+                if (!block) {
+                    block = &create_block(pool, MEMORY_BLOCK_SIZE);
+                    offset = allocate_in_block(*block, requirements.size, alignment).value();
+                }
+            }
+
+            Allocation allocation;
+            allocation.m_allocator = this;
+            allocation.m_block = block;
+            allocation.m_pool_index = pool_index;
+            allocation.m_offset = offset;
+            allocation.m_size = requirements.size;
+            return allocation;
+        }
+
+        // 获取各内存池的统计信息，空池不计入
+        [[nodiscard]]
+        std::vector<MemoryStats> stats() const {
+            std::lock_guard lock{ m_mutex };
+            std::vector<MemoryStats> result;
+            for (std::size_t i = 0; const auto& pool : m_pools) {
+                if (!pool.blocks.empty()) {
+                    MemoryStats stat;
+                    stat.memory_type_index = pool.memory_type_index;
+                    stat.heap_index = pool.heap_index;
+                    stat.kind = static_cast<ResourceKind>(i % 2);
+                    stat.block_count = static_cast<std::uint32_t>(pool.blocks.size());
+                    for (const auto& block : pool.blocks) {
+                        stat.allocation_count += block->allocation_count;
+                        stat.reserved += block->size;
+                        stat.used += block->used;
+                        for (const auto& [offset, size] : block->free_ranges) {
+                            stat.largest_free = std::max(stat.largest_free, size);
+                        }
+                    }
+                    result.emplace_back( stat );
+                }
+                ++i;
+            }
+            return result;
+        }
+
+        // 打印各内存池的统计信息
+        void print_stats() const {
+            std::println("Device memory: {} / {} allocations", m_device_allocation_count, m_max_allocation_count);
+            for (const auto& it : stats()) {
+                std::println(
+                    "\ttype {} heap {} {}: {} blocks, {} allocations, {} / {} KiB used, largest free {} KiB",
+                    it.memory_type_index,
+                    it.heap_index,
+                    m_granularity <= 1 ? "shared" : it.kind == ResourceKind::eLinear ? "linear" : "optimal",
+                    it.block_count,
+                    it.allocation_count,
+                    it.used / 1024,
+                    it.reserved / 1024,
+                    it.largest_free / 1024
+                );
+            }
+        }
+
+    private:
+        void init() {
+            m_memory_properties = m_device->physical_device().getMemoryProperties();
+            const auto limits = m_device->physical_device().getProperties().limits;
+            m_granularity = limits.bufferImageGranularity;
+            m_max_allocation_count = limits.maxMemoryAllocationCount;
+            // 每个内存类型两个池：线性资源与最优平铺图像
+            m_pools.resize(m_memory_properties.memoryTypeCount * 2);
+            for (std::uint32_t i = 0; i < m_memory_properties.memoryTypeCount; ++i) {
+                const auto& type = m_memory_properties.memoryTypes[i];
+                for (std::size_t k = 0; k < 2; ++k) {
+                    m_pools[i * 2 + k].memory_type_index = i;
+                    m_pools[i * 2 + k].heap_index = type.heapIndex;
+                    m_pools[i * 2 + k].host_visible = static_cast<bool>(type.propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible);
+                }
+            }
+        }
+
+        // 查找满足条件的内存类型
+        [[nodiscard]]
+        std::uint32_t find_memory_type(const std::uint32_t type_filter, const vk::MemoryPropertyFlags properties) const {
+            for (std::uint32_t i = 0; i < m_memory_properties.memoryTypeCount; ++i) {
+                if ((type_filter & (1 << i)) &&
+                    (m_memory_properties.memoryTypes[i].propertyFlags & properties) == properties
+                ) return i;
+            }
+            throw std::runtime_error("failed to find suitable memory type!");
+        }
+
+        // 粒度为 1 时不同种类的资源可以共用内存块
+        [[nodiscard]]
+        std::size_t pool_index_of(const std::uint32_t type_index, const ResourceKind kind) const {
+            const std::size_t kind_index = m_granularity > 1 ? static_cast<std::size_t>(kind) : 0;
+            return type_index * 2 + kind_index;
+        }
+
+        // 向驱动申请新的内存块，需持有锁
+        MemoryBlock& create_block(MemoryPool& pool, const vk::DeviceSize size) {
+            if (m_device_allocation_count >= m_max_allocation_count) {
+                throw std::runtime_error("exceeded maxMemoryAllocationCount!");
+            }
+            vk::MemoryAllocateInfo alloc_info;
+            alloc_info.allocationSize = size;
+            alloc_info.memoryTypeIndex = pool.memory_type_index;
+
+            auto block = std::make_unique<MemoryBlock>();
+            block->memory = m_device->device().allocateMemory( alloc_info );
+            block->size = size;
+            block->free_ranges.emplace(0, size);
+            if (pool.host_visible) {
+                block->mapped = block->memory.mapMemory(0, vk::WholeSize);
+            }
+            ++m_device_allocation_count;
+            return *pool.blocks.emplace_back( std::move(block) );
+        }
+
+        // 在内存块中首次适配，成功时返回偏移，需持有锁
+        [[nodiscard]]
+        static std::optional<vk::DeviceSize> allocate_in_block(
+            MemoryBlock& block,
+            const vk::DeviceSize size,
+            const vk::DeviceSize alignment
+        ) {
+            for (auto it = block.free_ranges.begin(); it != block.free_ranges.end(); ++it) {
+                const auto [range_offset, range_size] = *it;
+                const vk::DeviceSize offset = (range_offset + alignment - 1) / alignment * alignment;
+                if (offset + size > range_offset + range_size) continue;
+
+                block.free_ranges.erase(it);
+                if (offset > range_offset) {
+                    block.free_ranges.emplace(range_offset, offset - range_offset);
+                }
+                if (const vk::DeviceSize end = range_offset + range_size; offset + size < end) {
+                    block.free_ranges.emplace(offset + size, end - offset - size);
+                }
+                block.used += size;
+                ++block.allocation_count;
+                return offset;
+            }
+            return std::nullopt;
+        }
+
+        // 归还内存，合并相邻空闲区间，必要时释放空的内存块
+        void free(const Allocation& allocation) {
+            std::lock_guard lock{ m_mutex };
+            MemoryPool& pool = m_pools[allocation.m_pool_index];
+            MemoryBlock& block = *allocation.m_block;
+
+            block.used -= allocation.m_size;
+            --block.allocation_count;
+            if (!block.dedicated) {
+                vk::DeviceSize offset = allocation.m_offset;
+                vk::DeviceSize size = allocation.m_size;
+                auto next = block.free_ranges.lower_bound(offset);
+                if (next != block.free_ranges.begin()) {
+                    if (const auto prev = std::prev(next); prev->first + prev->second == offset) {
+                        offset = prev->first;
+                        size += prev->second;
+                        block.free_ranges.erase(prev);
+                    }
+                }
+                if (next != block.free_ranges.end() && offset + size == next->first) {
+                    size += next->second;
+                    block.free_ranges.erase(next);
+                }
+                block.free_ranges.emplace(offset, size);
+            }
+
+            if (block.allocation_count != 0) return;
+            // 保留最后一个普通内存块，避免反复申请与释放
+            const auto non_dedicated = std::ranges::count_if(pool.blocks, [](const auto& it) { return !it->dedicated; });
+            if (!block.dedicated && non_dedicated <= 1) return;
+            std::erase_if(pool.blocks, [&block](const auto& it) { return it.get() == &block; });
+            --m_device_allocation_count;
+        }
+    };
+
+    void Allocation::release() {
+        if (m_allocator) m_allocator->free(*this);
+        m_allocator = nullptr;
+        m_block = nullptr;
+        m_offset = 0;
+        m_size = 0;
+    }
+
+}
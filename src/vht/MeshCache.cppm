@@ -0,0 +1,234 @@
+export module MeshCache;
+
+import std;
+import vulkan_hpp;
+
+import MappedFile;
+import CacheFile;
+
+export namespace vht {
+
+    /**
+     * @brief 网格的一个细节层级
+     * @details
+     * - index_offset/index_count: 在索引数据中的范围
+     * - error: 相对原始网格的几何误差，与顶点位置单位相同
+     */
+    struct MeshLod {
+        std::uint32_t index_offset{};
+        std::uint32_t index_count{};
+        float error{};
+    };
+
+}
+
+namespace vht {
+
+    constexpr std::array<char, 4> MESH_MAGIC{ 'V', 'H', 'T', 'M' };
+    constexpr std::uint32_t MESH_VERSION = 4;
+    constexpr std::uint32_t MAX_MESH_ATTRIBUTES = 8;
+    constexpr std::uint32_t MAX_MESH_LODS = 8;
+    constexpr std::uint64_t MESH_BLOB_ALIGNMENT = 16;
+
+    // 顶点属性描述，与 vk::VertexInputAttributeDescription 一一对应
+    struct MeshAttribute {
+        std::uint32_t location{};
+        std::uint32_t binding{};
+        std::uint32_t format{};
+        std::uint32_t offset{};
+        bool operator==(const MeshAttribute&) const = default;
+    };
+
+    /**
+     * @brief 网格缓存文件头
+     * @details 文件布局：文件头 | 顶点数据 | 索引数据，数据块按 MESH_BLOB_ALIGNMENT 对齐
+     */
+    struct MeshHeader {
+        std::array<char, 4> magic{ MESH_MAGIC };
+        std::uint32_t version{ MESH_VERSION };
+        std::uint64_t source_hash{};        // 源文件路径的哈希
+        std::uint64_t source_size{};        // 源文件大小
+        std::int64_t source_mtime{};        // 源文件修改时间
+        std::uint32_t vertex_stride{};
+        std::uint32_t index_size{};         // 2 或 4，由网格的顶点数量决定
+        std::uint32_t attribute_count{};
+        std::uint32_t lod_count{};
+        std::array<MeshAttribute, MAX_MESH_ATTRIBUTES> attributes{};
+        std::array<MeshLod, MAX_MESH_LODS> lods{};
+        std::uint64_t vertex_count{};
+        std::uint64_t vertex_offset{};
+        std::uint64_t index_count{};
+        std::uint64_t index_offset{};
+    };
+    static_assert(std::is_trivially_copyable_v<MeshHeader>);
+
+}
+
+export namespace vht {
+
+    /**
+     * @brief 网格的顶点与索引布局
+     * @details
+     * - vertex_stride: 单个顶点的字节数
+     * - attributes: 顶点属性，布局不同的缓存会被视为失效
+     */
+    struct MeshLayout {
+        std::uint32_t vertex_stride{};
+        std::vector<vk::VertexInputAttributeDescription> attributes;
+    };
+
+    /**
+     * @brief 预烘焙的二进制网格缓存
+     * @details
+     * - 工作：
+     *  - 以源文件路径、大小和修改时间作为键，缓存去重后的顶点和索引数据，以及各 LOD 的索引范围；
+     *    源文件不存在时直接使用缓存，与 TextureCache 一致
+     *  - 读取时内存映射缓存文件，直接返回指向映射内存的视图，不做任何复制
+     *  - 写入时先写临时文件再重命名，中途失败不会留下损坏的缓存
+     * - 可访问成员：
+     *  - vertex_data(): 顶点数据
+     *  - index_data(): 索引数据
+     *  - vertex_count(): 顶点数量
+     *  - index_count(): 索引数量
+     *  - index_size(): 单个索引的字节数
+     *  - lods(): LOD 链
+     */
+    class MeshCache {
+        std::unique_ptr<MappedFile> m_file{ nullptr };
+        MeshHeader m_header{};
+    public:
+        [[nodiscard]]
+        std::span<const std::byte> vertex_data() const {
+            return { reinterpret_cast<const std::byte*>(m_file->data()) + m_header.vertex_offset,
+                     m_header.vertex_count * m_header.vertex_stride };
+        }
+        [[nodiscard]]
+        std::span<const std::byte> index_data() const {
+            return { reinterpret_cast<const std::byte*>(m_file->data()) + m_header.index_offset,
+                     m_header.index_count * m_header.index_size };
+        }
+        [[nodiscard]]
+        std::uint64_t vertex_count() const { return m_header.vertex_count; }
+        [[nodiscard]]
+        std::uint64_t index_count() const { return m_header.index_count; }
+        [[nodiscard]]
+        std::uint32_t index_size() const { return m_header.index_size; }
+        [[nodiscard]]
+        std::span<const MeshLod> lods() const { return { m_header.lods.data(), m_header.lod_count }; }
+
+        // 源文件对应的缓存文件路径
+        [[nodiscard]]
+        static std::filesystem::path cache_path(const std::filesystem::path& source) {
+            return vht::cache_path(source, "meshes", "vmesh");
+        }
+
+        /**
+         * @brief 打开源文件对应的缓存
+         * @return 缓存不存在、与源文件不一致或布局不匹配时返回 std::nullopt
+         */
+        [[nodiscard]]
+        static std::optional<MeshCache> load(const std::filesystem::path& source, const MeshLayout& layout) {
+            const auto path = cache_path(source);
+            std::error_code ec;
+            if (!std::filesystem::exists(path, ec)) return std::nullopt;
+
+            MeshCache cache;
+            try {
+                cache.m_file = std::make_unique<MappedFile>(path.string());
+            } catch (const std::runtime_error&) {
+                return std::nullopt;
+            }
+            const std::uint64_t file_size = cache.m_file->size();
+            if (file_size < sizeof(MeshHeader)) return std::nullopt;
+            std::memcpy(&cache.m_header, cache.m_file->data(), sizeof(MeshHeader));
+
+            const MeshHeader& header = cache.m_header;
+            // 源文件不存在时不校验源文件的键，与 TextureCache 相同
+            const auto key = vht::source_key(source);
+            const MeshHeader expected = make_header(key.value_or(SourceKey{}), layout);
+            if (header.magic != MESH_MAGIC || header.version != MESH_VERSION) return std::nullopt;
+            if (key && (header.source_hash != expected.source_hash ||
+                header.source_size != expected.source_size ||
+                header.source_mtime != expected.source_mtime)) return std::nullopt;
+            if (header.vertex_stride != expected.vertex_stride ||
+                (header.index_size != 2 && header.index_size != 4) ||
+                header.attribute_count != expected.attribute_count ||
+                header.attributes != expected.attributes) return std::nullopt;
+            if (header.vertex_offset % MESH_BLOB_ALIGNMENT != 0 ||
+                header.index_offset % MESH_BLOB_ALIGNMENT != 0 ||
+                header.vertex_offset + header.vertex_count * header.vertex_stride > file_size ||
+                header.index_offset + header.index_count * header.index_size > file_size) return std::nullopt;
+            if (header.lod_count == 0 || header.lod_count > MAX_MESH_LODS) return std::nullopt;
+            for (const auto& lod : cache.lods()) {
+                if (static_cast<std::uint64_t>(lod.index_offset) + lod.index_count > header.index_count) return std::nullopt;
+            }
+            return cache;
+        }
+
+        /**
+         * @brief 写入源文件对应的缓存
+         * @details 写入失败或源文件已无法读取时只打印警告，不影响已加载的数据
+         */
+        static void store(
+            const std::filesystem::path& source,
+            const MeshLayout& layout,
+            const std::span<const std::byte> vertices,
+            const std::span<const std::byte> indices,
+            const std::uint32_t index_size,
+            const std::span<const MeshLod> lods
+        ) {
+            if (lods.empty() || lods.size() > MAX_MESH_LODS) {
+                throw std::invalid_argument("invalid lod count for mesh cache!");
+            }
+            const auto key = vht::source_key(source);
+            if (!key) {
+                std::println("failed to write cache: {} is unavailable", source.string());
+                return;
+            }
+            MeshHeader header = make_header(*key, layout);
+            header.lod_count = static_cast<std::uint32_t>(lods.size());
+            std::ranges::copy(lods, header.lods.begin());
+            header.vertex_count = vertices.size() / layout.vertex_stride;
+            header.vertex_offset = align_up(sizeof(MeshHeader), MESH_BLOB_ALIGNMENT);
+            header.index_size = index_size;
+            header.index_count = indices.size() / index_size;
+            header.index_offset = align_up(header.vertex_offset + vertices.size(), MESH_BLOB_ALIGNMENT);
+
+            vht::write_cache_file(cache_path(source), [&](std::ofstream& file) {
+                file.write(reinterpret_cast<const char*>(&header), sizeof(MeshHeader));
+                vht::pad_to(file, header.vertex_offset);
+                file.write(reinterpret_cast<const char*>(vertices.data()), static_cast<std::streamsize>(vertices.size()));
+                vht::pad_to(file, header.index_offset);
+                file.write(reinterpret_cast<const char*>(indices.data()), static_cast<std::streamsize>(indices.size()));
+            });
+        }
+
+    private:
+        MeshCache() = default;
+
+        // 由源文件的键和布局生成文件头中的键
+        [[nodiscard]]
+        static MeshHeader make_header(const SourceKey& key, const MeshLayout& layout) {
+            if (layout.attributes.size() > MAX_MESH_ATTRIBUTES) {
+                throw std::invalid_argument("too many vertex attributes for mesh cache!");
+            }
+            MeshHeader header{};
+            header.source_hash = key.hash;
+            header.source_size = key.size;
+            header.source_mtime = key.mtime;
+            header.vertex_stride = layout.vertex_stride;
+            header.attribute_count = static_cast<std::uint32_t>(layout.attributes.size());
+            for (std::size_t i = 0; i < layout.attributes.size(); ++i) {
+                const auto& attribute = layout.attributes[i];
+                header.attributes[i] = {
+                    attribute.location,
+                    attribute.binding,
+                    static_cast<std::uint32_t>(attribute.format),
+                    attribute.offset
+                };
+            }
+            return header;
+        }
+    };
+
+}
@@ -0,0 +1,297 @@
+export module MeshOptimizer;
+
+import std;
+import glm;
+
+import Config;
+
+namespace vht {
+
+    constexpr std::uint32_t INVALID_INDEX = std::numeric_limits<std::uint32_t>::max();
+
+    /**
+     * @brief 顶点到三角形的邻接表
+     * @details offsets[v] 到 offsets[v + 1] 为顶点 v 所在的三角形
+     */
+    struct Adjacency {
+        std::vector<std::uint32_t> offsets;
+        std::vector<std::uint32_t> triangles;
+    };
+
+    [[nodiscard]]
+    Adjacency build_adjacency(const std::span<const std::uint32_t> indices, const std::size_t vertex_count) {
+        Adjacency adjacency;
+        adjacency.offsets.assign(vertex_count + 1, 0);
+        for (const std::uint32_t index : indices) ++adjacency.offsets[index + 1];
+        for (std::size_t v = 0; v < vertex_count; ++v) adjacency.offsets[v + 1] += adjacency.offsets[v];
+        adjacency.triangles.resize(indices.size());
+        std::vector<std::uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+        for (std::size_t i = 0; i < indices.size(); ++i) {
+            adjacency.triangles[fill[indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+        }
+        return adjacency;
+    }
+
+    /**
+     * @brief FIFO 顶点缓存模拟
+     * @details 与大多数 GPU 的后变换缓存行为相近，用时间戳代替队列
+     */
+    class FifoCache {
+        std::vector<std::uint32_t> m_timestamps;
+        std::uint32_t m_size;
+        std::uint32_t m_time;
+    public:
+        FifoCache(const std::size_t vertex_count, const std::uint32_t size)
+        :   m_timestamps(vertex_count, 0), m_size(size), m_time(size + 1) {}
+
+        // 访问顶点，未命中时返回 true
+        bool access(const std::uint32_t vertex) {
+            if (m_time - m_timestamps[vertex] > m_size) {
+                m_timestamps[vertex] = m_time++;
+                return true;
+            }
+            return false;
+        }
+        // 清空缓存
+        void reset() { m_time += m_size + 1; }
+    };
+
+}
+
+export namespace vht {
+
+    /**
+     * @brief 顶点缓存统计
+     * @details
+     * - acmr: 平均每个三角形的缓存未命中次数，最优约为 0.5
+     * - atvr: 未命中次数与顶点数之比，最优为 1.0
+     */
+    struct VertexCacheStats {
+        double acmr{};
+        double atvr{};
+    };
+
+    /**
+     * @brief 模拟 FIFO 顶点缓存，统计 ACMR 与 ATVR
+     */
+    [[nodiscard]]
+    VertexCacheStats analyze_vertex_cache(
+        const std::span<const std::uint32_t> indices,
+        const std::size_t vertex_count,
+        const std::uint32_t cache_size = VERTEX_CACHE_SIZE
+    ) {
+        if (indices.empty() || vertex_count == 0) return {};
+        FifoCache cache(vertex_count, cache_size);
+        std::size_t misses = 0;
+        for (const std::uint32_t index : indices) misses += cache.access(index);
+        return {
+            static_cast<double>(misses) / static_cast<double>(indices.size() / 3),
+            static_cast<double>(misses) / static_cast<double>(vertex_count)
+        };
+    }
+
+    /**
+     * @brief Tipsify 顶点缓存优化
+     * @details
+     * 按 Sander 等人的 Tipsify 算法重排三角形：围绕扇形顶点输出其所有剩余三角形，
+     * 下一个扇形顶点优先选择仍在缓存中且剩余三角形较多的顶点，
+     * 没有候选时依次回退到死端栈和顺序游标。
+     * @param indices 三角形列表索引，原地重排
+     */
+    void optimize_vertex_cache(
+        const std::span<std::uint32_t> indices,
+        const std::size_t vertex_count,
+        const std::uint32_t cache_size = VERTEX_CACHE_SIZE
+    ) {
+        const std::size_t triangle_count = indices.size() / 3;
+        if (triangle_count == 0) return;
+        const Adjacency adjacency = build_adjacency(indices, vertex_count);
+
+        std::vector<std::uint32_t> live(vertex_count);
+        for (std::size_t v = 0; v < vertex_count; ++v) {
+            live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+        }
+        std::vector<std::uint32_t> cache_time(vertex_count, 0);
+        std::vector<bool> emitted(triangle_count, false);
+        std::vector<std::uint32_t> dead_end;
+        std::vector<std::uint32_t> candidates;
+        std::vector<std::uint32_t> result;
+        result.reserve(indices.size());
+
+        std::uint32_t time = cache_size + 1;
+        std::size_t cursor = 0;
+        std::uint32_t fan = indices[0];
+        while (fan != INVALID_INDEX) {
+            candidates.clear();
+            for (std::uint32_t k = adjacency.offsets[fan]; k < adjacency.offsets[fan + 1]; ++k) {
+                const std::uint32_t triangle = adjacency.triangles[k];
+                if (emitted[triangle]) continue;
+                emitted[triangle] = true;
+                for (std::uint32_t c = 0; c < 3; ++c) {
+                    const std::uint32_t v = indices[triangle * 3 + c];
+                    result.push_back(v);
+                    dead_end.push_back(v);
+                    candidates.push_back(v);
+                    --live[v];
+                    if (time - cache_time[v] > cache_size) cache_time[v] = time++;
+                }
+            }
+
+            // 选择仍在缓存中、且输出其剩余三角形后不会被挤出缓存的顶点
+            fan = INVALID_INDEX;
+            std::uint32_t best_priority = 0;
+            for (const std::uint32_t v : candidates) {
+                if (live[v] == 0) continue;
+                std::uint32_t priority = 0;
+                if (time - cache_time[v] + 2 * live[v] <= cache_size) priority = time - cache_time[v];
+                if (fan == INVALID_INDEX || priority > best_priority) {
+                    best_priority = priority;
+                    fan = v;
+                }
+            }
+            if (fan != INVALID_INDEX) continue;
+
+            while (!dead_end.empty()) {
+                const std::uint32_t v = dead_end.back();
+                dead_end.pop_back();
+                if (live[v] > 0) {
+                    fan = v;
+                    break;
+                }
+            }
+            if (fan != INVALID_INDEX) continue;
+
+            for (; cursor < vertex_count; ++cursor) {
+                if (live[cursor] > 0) {
+                    fan = static_cast<std::uint32_t>(cursor);
+                    break;
+                }
+            }
+        }
+        std::ranges::copy(result, indices.begin());
+    }
+
+    /**
+     * @brief 面向过度绘制的簇排序
+     * @details
+     * - 在缓存优化后的三角形序列中，所有顶点都未命中缓存的三角形作为硬边界
+     * - 硬边界内局部 ACMR 不超过整体 ACMR 的 threshold 倍时切出软边界，保证排序后缓存效率损失有限
+     * - 每个簇按面积加权的法线与其中心到网格中心的方向的点积从大到小排序，
+     *   朝外的簇先绘制，更容易遮挡后绘制的簇
+     * @param indices 缓存优化后的三角形列表索引，原地重排
+     * @param position position(v) 返回顶点 v 的位置
+     * @param threshold 允许的 ACMR 放大倍数
+     */
+    template<typename Position>
+    void optimize_overdraw(
+        const std::span<std::uint32_t> indices,
+        const std::size_t vertex_count,
+        Position&& position,
+        const double threshold = 1.05,
+        const std::uint32_t cache_size = VERTEX_CACHE_SIZE
+    ) {
+        const std::size_t triangle_count = indices.size() / 3;
+        if (triangle_count == 0) return;
+
+        // 硬边界：三个顶点都未命中缓存的三角形
+        std::vector<std::size_t> hard{ 0 };
+        {
+            FifoCache cache(vertex_count, cache_size);
+            for (std::size_t t = 0; t < triangle_count; ++t) {
+                std::uint32_t misses = 0;
+                for (std::size_t c = 0; c < 3; ++c) misses += cache.access(indices[t * 3 + c]);
+                if (t > 0 && misses == 3) hard.push_back(t);
+            }
+            hard.push_back(triangle_count);
+        }
+
+        // 软边界：局部 ACMR 足够低时提前结束当前簇
+        std::vector<std::size_t> clusters;
+        for (std::size_t h = 0; h + 1 < hard.size(); ++h) {
+            const std::size_t begin = hard[h];
+            const std::size_t end = hard[h + 1];
+            FifoCache cache(vertex_count, cache_size);
+            std::size_t cluster_misses = 0;
+            for (std::size_t i = begin * 3; i < end * 3; ++i) cluster_misses += cache.access(indices[i]);
+            const double limit = threshold * static_cast<double>(cluster_misses) / static_cast<double>(end - begin);
+
+            cache.reset();
+            std::size_t start = begin;
+            std::size_t misses = 0;
+            clusters.push_back(begin);
+            for (std::size_t t = begin; t < end; ++t) {
+                for (std::size_t c = 0; c < 3; ++c) misses += cache.access(indices[t * 3 + c]);
+                const double local = static_cast<double>(misses) / static_cast<double>(t - start + 1);
+                if (t + 1 < end && local <= limit) {
+                    clusters.push_back(t + 1);
+                    start = t + 1;
+                    misses = 0;
+                    cache.reset();
+                }
+            }
+        }
+        clusters.push_back(triangle_count);
+
+        // 网格中心
+        glm::dvec3 mesh_center{ 0.0 };
+        for (const std::uint32_t index : indices) mesh_center += glm::dvec3(position(index));
+        mesh_center /= static_cast<double>(indices.size());
+
+        const std::size_t cluster_count = clusters.size() - 1;
+        std::vector<double> sort_keys(cluster_count);
+        for (std::size_t k = 0; k < cluster_count; ++k) {
+            glm::dvec3 center{ 0.0 };
+            glm::dvec3 normal{ 0.0 };
+            double area_sum = 0.0;
+            for (std::size_t t = clusters[k]; t < clusters[k + 1]; ++t) {
+                const glm::dvec3 p0 = position(indices[t * 3 + 0]);
+                const glm::dvec3 p1 = position(indices[t * 3 + 1]);
+                const glm::dvec3 p2 = position(indices[t * 3 + 2]);
+                const glm::dvec3 cross = glm::cross(p1 - p0, p2 - p0);
+                const double area = glm::length(cross);
+                center += (p0 + p1 + p2) * (area / 3.0);
+                normal += cross;
+                area_sum += area;
+            }
+            const double normal_length = glm::length(normal);
+            if (area_sum > 0.0) center /= area_sum;
+            if (normal_length > 0.0) normal /= normal_length;
+            sort_keys[k] = glm::dot(center - mesh_center, normal);
+        }
+
+        std::vector<std::size_t> order(cluster_count);
+        std::iota(order.begin(), order.end(), 0);
+        std::ranges::stable_sort(order, [&](const std::size_t a, const std::size_t b) {
+            return sort_keys[a] > sort_keys[b];
+        });
+
+        std::vector<std::uint32_t> result;
+        result.reserve(indices.size());
+        for (const std::size_t k : order) {
+            result.insert(result.end(), indices.begin() + clusters[k] * 3, indices.begin() + clusters[k + 1] * 3);
+        }
+        std::ranges::copy(result, indices.begin());
+    }
+
+    /**
+     * @brief 顶点获取优化
+     * @details 按索引中首次使用的顺序重排顶点，并重映射索引，未被引用的顶点会被移除
+     * @return 重排后的顶点数量
+     */
+    template<typename Vertex>
+    std::size_t optimize_vertex_fetch(std::vector<Vertex>& vertices, const std::span<std::uint32_t> indices) {
+        std::vector<std::uint32_t> remap(vertices.size(), INVALID_INDEX);
+        std::vector<Vertex> result;
+        result.reserve(vertices.size());
+        for (std::uint32_t& index : indices) {
+            if (remap[index] == INVALID_INDEX) {
+                remap[index] = static_cast<std::uint32_t>(result.size());
+                result.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices = std::move(result);
+        return vertices.size();
+    }
+
+}
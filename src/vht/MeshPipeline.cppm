@@ -0,0 +1,165 @@
+export module MeshPipeline;
+
+import std;
+import vulkan_hpp;
+import glm;
+
+import Config;
+import Tools;
+import Device;
+import PipelineRegistry;
+import PipelineBuilder;
+import GraphicsPipeline;
+import VertexFormat;
+
+export namespace vht {
+
+    /**
+     * @brief 网格着色器路径的逐绘制推送常量，布局与 shaders/mesh.*.glsl 一致
+     * @details
+     * - transform: 网格的模型空间到世界空间的变换
+     * - quantization: 网格反量化参数
+     * - texture_index/sampler_index: 纹理表中的槽位，与 DrawConstants 位于相同偏移，两条路径共用片段着色器
+     * - meshlet_offset: 所选 LOD 的第一个 meshlet
+     * - meshlet_count: 所选 LOD 的 meshlet 数量，任务着色器据此丢弃越界调用
+     * - vertex_offset: 网格第一个顶点在顶点缓冲区中的位置，meshlet 顶点表中的索引相对于它
+     */
+    struct MeshletConstants {
+        glm::mat4 transform{ 1.0f };
+        MeshQuantization quantization{};
+        std::uint32_t texture_index{};
+        std::uint32_t sampler_index{};
+        std::uint32_t meshlet_offset{};
+        std::uint32_t meshlet_count{};
+        std::uint32_t vertex_offset{};
+        std::array<std::uint32_t, 3> padding{};
+    };
+    static_assert(sizeof(glm::mat4) + sizeof(MeshQuantization) == TEXTURE_CONSTANTS_OFFSET);
+    static_assert(sizeof(MeshletConstants) <= 128, "exceeds the guaranteed push constant size");
+    // 推送 MeshletConstants 时使用的着色器阶段，需与管线布局中的范围一致
+    constexpr vk::ShaderStageFlags MESHLET_CONSTANT_STAGES =
+        vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT | vk::ShaderStageFlagBits::eFragment;
+
+    /**
+     * @brief 任务/网格着色器管线
+     * @details
+     * - 依赖：
+     *  - m_device: 逻辑设备与队列
+     *  - m_pipeline_registry: 管线注册表
+     *  - m_graphics_pipeline: 顶点着色器管线，共用其 UBO 与纹理描述符集布局
+     * - 工作：
+     *  - 设备启用网格着色器时，创建 meshlet 存储缓冲区的描述符集布局（集合 2）
+     *  - 创建任务、网格、片段三阶段的图形管线布局，任务着色器逐 meshlet 做视锥与法线锥剔除；
+     *    管线由 PipelineBuilder 按 description() 向 m_pipeline_registry 请求后通过 replace() 设置
+     *  - 设备不支持时不创建任何对象，supported() 返回 false，绘制时回退到顶点着色器管线
+     * - 可访问成员：
+     *  - supported(): 是否可用
+     *  - descriptor_set_layout(): meshlet 描述符集布局
+     *  - pipeline_layout(): 管线布局
+     *  - pipeline(): 图形管线，由 m_pipeline_registry 持有
+     *  - shader_sources(): 管线使用的着色器源文件
+     *  - description(): 创建管线的描述，提交给 PipelineBuilder 在工作线程中创建
+     *  - replace(): 设置创建完成的管线，着色器热重载时在帧边界替换
+     */
+    class MeshPipeline {
+        static constexpr std::array<std::string_view, 3> SHADER_SOURCES{
+            "shaders/mesh.task.glsl",
+            "shaders/mesh.mesh.glsl",
+            "shaders/graphics.frag.glsl"
+        };
+        std::shared_ptr<vht::Device> m_device;
+        std::shared_ptr<vht::PipelineRegistry> m_pipeline_registry;
+        std::shared_ptr<vht::GraphicsPipeline> m_graphics_pipeline;
+        vk::raii::DescriptorSetLayout m_descriptor_set_layout{ nullptr };
+        vk::raii::PipelineLayout m_pipeline_layout{ nullptr };
+        vk::Pipeline m_pipeline;
+    public:
+        explicit MeshPipeline(
+            std::shared_ptr<vht::Device> device,
+            std::shared_ptr<vht::PipelineRegistry> pipeline_registry,
+            std::shared_ptr<vht::GraphicsPipeline> graphics_pipeline
+        ):  m_device(std::move(device)),
+            m_pipeline_registry(std::move(pipeline_registry)),
+            m_graphics_pipeline(std::move(graphics_pipeline)) {
+            init();
+        }
+
+        [[nodiscard]]
+        bool supported() const { return m_device->mesh_shader_supported(); }
+        [[nodiscard]]
+        const vk::raii::DescriptorSetLayout& descriptor_set_layout() const { return m_descriptor_set_layout; }
+        [[nodiscard]]
+        const vk::raii::PipelineLayout& pipeline_layout() const { return m_pipeline_layout; }
+        [[nodiscard]]
+        vk::Pipeline pipeline() const { return m_pipeline; }
+        [[nodiscard]]
+        static std::span<const std::string_view> shader_sources() { return SHADER_SOURCES; }
+
+        /**
+         * @brief 用当前的着色器源码创建管线的描述
+         * @details 创建时只读取管线布局，可以在工作线程中执行；本对象需在管线创建完成前保持存在
+         */
+        [[nodiscard]]
+        PipelineDescription description() const { return { "mesh", [this] { return build_pipeline(); } }; }
+
+        /**
+         * @brief 设置或替换管线，只能在主线程中、不记录命令时调用
+         * @details 释放被替换管线的引用，m_pipeline_registry 等正在执行的帧结束后再销毁它
+         */
+        void replace(const vk::Pipeline pipeline) { m_pipeline_registry->release(std::exchange(m_pipeline, pipeline)); }
+
+    private:
+        void init() {
+            if (!supported()) return;
+            create_descriptor_set_layout();
+            create_pipeline_layout();
+        }
+        // 创建描述符集布局：顶点、meshlet、meshlet 顶点表、meshlet 三角形表
+        void create_descriptor_set_layout() {
+            std::array<vk::DescriptorSetLayoutBinding, 4> bindings;
+            for (std::uint32_t i = 0; i < bindings.size(); ++i) {
+                bindings[i].binding = i;
+                bindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+                bindings[i].descriptorCount = 1;
+                bindings[i].stageFlags = vk::ShaderStageFlagBits::eMeshEXT;
+            }
+            bindings[1].stageFlags |= vk::ShaderStageFlagBits::eTaskEXT;
+
+            vk::DescriptorSetLayoutCreateInfo create_info;
+            create_info.setBindings( bindings );
+            m_descriptor_set_layout = m_device->device().createDescriptorSetLayout( create_info );
+        }
+        // 创建管线布局，重建管线时不变
+        void create_pipeline_layout() {
+            // 集合 0、1 与顶点着色器管线相同，集合 2 为 meshlet 数据
+            std::vector<vk::DescriptorSetLayout> set_layouts = m_graphics_pipeline->set_layouts();
+            set_layouts.push_back( m_descriptor_set_layout );
+
+            vk::PushConstantRange push_constant_range;
+            push_constant_range.stageFlags = MESHLET_CONSTANT_STAGES;
+            push_constant_range.offset = 0;
+            push_constant_range.size = sizeof(MeshletConstants);
+
+            vk::PipelineLayoutCreateInfo layout_create_info;
+            layout_create_info.setSetLayouts( set_layouts );
+            layout_create_info.setPushConstantRanges( push_constant_range );
+            m_pipeline_layout = m_device->device().createPipelineLayout( layout_create_info );
+        }
+        // 向注册表请求网格着色器管线，不使用顶点输入与图元装配状态
+        [[nodiscard]]
+        vk::Pipeline build_pipeline() const {
+            PipelineState state;
+            state.name = "mesh";
+            state.shaders = {
+                { vk::ShaderStageFlagBits::eTaskEXT, SHADER_SOURCES[0] },
+                // 网格着色器按 VERTEX_LAYOUT 解码顶点
+                { vk::ShaderStageFlagBits::eMeshEXT, SHADER_SOURCES[1], static_cast<std::uint32_t>(VERTEX_LAYOUT) },
+                { vk::ShaderStageFlagBits::eFragment, SHADER_SOURCES[2] }
+            };
+            state.fixed.vertex_input = false;
+            state.layout = m_pipeline_layout;
+            return m_pipeline_registry->request(state);
+        }
+    };
+
+}
@@ -0,0 +1,423 @@
+export module MeshSimplifier;
+
+import std;
+import glm;
+
+namespace vht {
+
+    /**
+     * @brief 二次误差矩阵
+     * @details
+     * 累加平面 n·p + d = 0 的 (n·p + d)^2，按面积加权，对称矩阵只保存上三角。
+     * weight 为累加的权重，evaluate(p) / weight 为到各平面的加权平均平方距离
+     */
+    struct Quadric {
+        double a00{}, a01{}, a02{}, a11{}, a12{}, a22{};
+        double b0{}, b1{}, b2{};
+        double c{};
+        double weight{};
+
+        void add_plane(const glm::dvec3& n, const double d, const double w) {
+            a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+            a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+            b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+            c += w * d * d;
+            weight += w;
+        }
+        [[nodiscard]]
+        double evaluate(const glm::dvec3& p) const {
+            const double value =
+                a00 * p.x * p.x + 2.0 * a01 * p.x * p.y + 2.0 * a02 * p.x * p.z +
+                a11 * p.y * p.y + 2.0 * a12 * p.y * p.z + a22 * p.z * p.z +
+                2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+            return std::max(value, 0.0);
+        }
+        Quadric& operator+=(const Quadric& other) {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02;
+            a11 += other.a11; a12 += other.a12; a22 += other.a22;
+            b0 += other.b0; b1 += other.b1; b2 += other.b2;
+            c += other.c;
+            weight += other.weight;
+            return *this;
+        }
+    };
+
+    constexpr std::uint32_t NO_VERTEX = std::numeric_limits<std::uint32_t>::max();
+    // 开放边平面相对于三角形平面的权重，越大越倾向于保持边界与接缝的形状
+    constexpr double BORDER_WEIGHT = 10.0;
+
+    /**
+     * @brief 顶点类型，决定顶点能否折叠以及折叠方向
+     * @details
+     * - eManifold: 内部顶点，可以折叠到任意相邻顶点
+     * - eBorder: 网格边界上的顶点，只能沿边界折叠
+     * - eSeam: 纹理接缝上的顶点，同一位置有两个顶点，两侧沿接缝同时折叠
+     * - eLocked: 其他情况（非流形、多个接缝交汇等），不折叠
+     */
+    enum class VertexKind : std::uint8_t {
+        eManifold,
+        eBorder,
+        eSeam,
+        eLocked
+    };
+
+    /**
+     * @brief 当前索引的拓扑
+     * @details
+     * - 开放边为没有反向边的有向边，按顶点编号判断，因此纹理接缝也是开放边
+     * - open_out[v]/open_in[v]: 从 v 出发/到达 v 的开放边的另一端
+     * - wedge[v]: 与 v 位置相同的下一个存活顶点，构成循环链表
+     */
+    struct Topology {
+        std::vector<std::uint32_t> open_out;
+        std::vector<std::uint32_t> open_in;
+        std::vector<std::uint32_t> wedge;
+        std::vector<VertexKind> kind;
+    };
+
+    [[nodiscard]]
+    std::uint64_t edge_key(const std::uint64_t a, const std::uint64_t b) {
+        return a << 32 | b;
+    }
+
+    // 按有向边排序后的三角形边
+    [[nodiscard]]
+    std::vector<std::uint64_t> directed_edges(const std::span<const std::uint32_t> indices) {
+        std::vector<std::uint64_t> edges;
+        edges.reserve(indices.size());
+        for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+            for (std::size_t c = 0; c < 3; ++c) {
+                edges.push_back(edge_key(indices[i + c], indices[i + (c + 1) % 3]));
+            }
+        }
+        std::ranges::sort(edges);
+        return edges;
+    }
+
+    /**
+     * @brief 分析当前索引的拓扑并确定顶点类型
+     * @param position_ids position_ids[v] 为与 v 位置相同的最小顶点编号
+     */
+    [[nodiscard]]
+    Topology classify(const std::span<const std::uint32_t> indices, const std::span<const std::uint32_t> position_ids) {
+        const std::size_t vertex_count = position_ids.size();
+        Topology topology;
+        topology.open_out.assign(vertex_count, NO_VERTEX);
+        topology.open_in.assign(vertex_count, NO_VERTEX);
+        topology.wedge.assign(vertex_count, NO_VERTEX);
+        topology.kind.assign(vertex_count, VertexKind::eLocked);
+
+        std::vector<bool> alive(vertex_count, false);
+        std::vector<bool> complex(vertex_count, false);
+        for (const std::uint32_t index : indices) alive[index] = true;
+
+        const auto edges = directed_edges(indices);
+        for (std::size_t i = 0; i < edges.size(); ++i) {
+            const auto a = static_cast<std::uint32_t>(edges[i] >> 32);
+            const auto b = static_cast<std::uint32_t>(edges[i] & 0xffffffffull);
+            // 重复的有向边说明是非流形边
+            if (i + 1 < edges.size() && edges[i + 1] == edges[i]) {
+                complex[a] = complex[b] = true;
+                continue;
+            }
+            if (i > 0 && edges[i - 1] == edges[i]) continue;
+            if (std::ranges::binary_search(edges, edge_key(b, a))) continue;
+            if (topology.open_out[a] != NO_VERTEX) complex[a] = true;
+            if (topology.open_in[b] != NO_VERTEX) complex[b] = true;
+            topology.open_out[a] = b;
+            topology.open_in[b] = a;
+        }
+
+        // 位置相同的存活顶点串成循环链表
+        std::vector<std::uint32_t> first(vertex_count, NO_VERTEX);
+        std::vector<std::uint32_t> last(vertex_count, NO_VERTEX);
+        for (std::uint32_t v = 0; v < vertex_count; ++v) {
+            if (!alive[v]) continue;
+            const std::uint32_t p = position_ids[v];
+            if (first[p] == NO_VERTEX) first[p] = v;
+            else topology.wedge[last[p]] = v;
+            last[p] = v;
+        }
+        for (std::uint32_t p = 0; p < vertex_count; ++p) {
+            if (first[p] != NO_VERTEX) topology.wedge[last[p]] = first[p];
+        }
+
+        const auto has_loop = [&](const std::uint32_t v) {
+            return topology.open_out[v] != NO_VERTEX && topology.open_in[v] != NO_VERTEX;
+        };
+        for (std::uint32_t v = 0; v < vertex_count; ++v) {
+            if (!alive[v] || complex[v]) continue;
+            const std::uint32_t w = topology.wedge[v];
+            const bool open = topology.open_out[v] != NO_VERTEX || topology.open_in[v] != NO_VERTEX;
+            if (w == v) {
+                if (!open) topology.kind[v] = VertexKind::eManifold;
+                else if (has_loop(v)) topology.kind[v] = VertexKind::eBorder;
+            } else if (topology.wedge[w] == v && !complex[w] && has_loop(v) && has_loop(w) &&
+                position_ids[topology.open_out[v]] == position_ids[topology.open_in[w]] &&
+                position_ids[topology.open_in[v]] == position_ids[topology.open_out[w]]) {
+                topology.kind[v] = VertexKind::eSeam;
+            }
+        }
+        return topology;
+    }
+
+    // 候选的边折叠：from 合并到 to，顶点位置取 to 的位置，error 为折叠后的平均平方距离
+    struct Collapse {
+        std::uint32_t from;
+        std::uint32_t to;
+        double error;
+    };
+
+}
+
+export namespace vht {
+
+    /**
+     * @brief 网格简化结果
+     * @details
+     * - indices: 简化后的三角形列表索引，引用原顶点缓冲区中的顶点
+     * - error: 简化引入的几何误差，与顶点位置单位相同
+     */
+    struct SimplifyResult {
+        std::vector<std::uint32_t> indices;
+        float error{};
+    };
+
+    /**
+     * @brief 基于二次误差的边折叠简化
+     * @details
+     * - 只把顶点折叠到相邻的已有顶点上，不生成新顶点，简化结果可以与原网格共用顶点缓冲区
+     * - 位置相同的顶点共用误差矩阵；边界顶点只沿边界折叠，纹理接缝两侧的顶点沿接缝同时折叠，
+     *   避免产生裂缝和纹理错位，无法归类的顶点不折叠
+     * - 每轮重新分析拓扑，收集所有候选边并按代价排序，选择互不相邻的折叠同时执行，拒绝会翻转三角形的折叠
+     * - 三角形数量达到目标、误差超过上限或没有可执行的折叠时停止
+     * @param indices 三角形列表索引
+     * @param position position(v) 返回顶点 v 的位置
+     * @param target_index_count 目标索引数量
+     * @param target_error 允许的最大误差，与顶点位置单位相同
+     */
+    template<typename Position>
+    [[nodiscard]]
+    SimplifyResult simplify_mesh(
+        const std::span<const std::uint32_t> indices,
+        const std::size_t vertex_count,
+        Position&& position,
+        const std::size_t target_index_count,
+        const float target_error = std::numeric_limits<float>::max()
+    ) {
+        SimplifyResult result{ { indices.begin(), indices.end() }, 0.0f };
+        if (indices.size() <= target_index_count) return result;
+
+        std::vector<glm::dvec3> positions(vertex_count);
+        for (std::size_t v = 0; v < vertex_count; ++v) positions[v] = glm::dvec3(position(static_cast<std::uint32_t>(v)));
+
+        // 位置相同的顶点共用同一个编号和二次误差矩阵
+        std::vector<std::uint32_t> position_ids(vertex_count);
+        {
+            std::vector<std::uint32_t> order(vertex_count);
+            std::iota(order.begin(), order.end(), 0u);
+            const auto less = [&](const std::uint32_t a, const std::uint32_t b) {
+                const auto& pa = positions[a];
+                const auto& pb = positions[b];
+                return std::tie(pa.x, pa.y, pa.z, a) < std::tie(pb.x, pb.y, pb.z, b);
+            };
+            std::ranges::sort(order, less);
+            for (std::size_t i = 0; i < vertex_count; ++i) {
+                const std::uint32_t v = order[i];
+                const bool same = i > 0 && positions[order[i - 1]] == positions[v];
+                position_ids[v] = same ? position_ids[order[i - 1]] : v;
+            }
+        }
+
+        // 三角形平面按面积加权；开放边额外加入过边且垂直于三角形的平面，约束边界与接缝
+        std::vector<Quadric> quadrics(vertex_count);
+        {
+            const auto edges = directed_edges(indices);
+            for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+                const glm::dvec3& p0 = positions[indices[i]];
+                const glm::dvec3 normal = glm::cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+                const double length = glm::length(normal);
+                if (length <= 0.0) continue;
+                const glm::dvec3 unit = normal / length;
+                Quadric quadric;
+                quadric.add_plane(unit, -glm::dot(unit, p0), length * 0.5);
+                for (std::size_t c = 0; c < 3; ++c) {
+                    const std::uint32_t a = indices[i + c];
+                    const std::uint32_t b = indices[i + (c + 1) % 3];
+                    quadrics[position_ids[a]] += quadric;
+                    if (std::ranges::binary_search(edges, edge_key(b, a))) continue;
+                    const glm::dvec3 edge = positions[b] - positions[a];
+                    const glm::dvec3 edge_normal = glm::cross(edge, unit);
+                    const double edge_length = glm::length(edge_normal);
+                    if (edge_length <= 0.0) continue;
+                    Quadric border;
+                    border.add_plane(edge_normal / edge_length, -glm::dot(edge_normal / edge_length, positions[a]),
+                        glm::dot(edge, edge) * BORDER_WEIGHT);
+                    quadrics[position_ids[a]] += border;
+                    quadrics[position_ids[b]] += border;
+                }
+            }
+        }
+
+        const double error_limit = static_cast<double>(target_error) * static_cast<double>(target_error);
+        double max_error = 0.0;
+        std::vector<std::uint32_t> remap(vertex_count);
+        std::iota(remap.begin(), remap.end(), 0u);
+        std::vector<bool> touched;
+        std::vector<Collapse> collapses;
+        std::vector<std::uint32_t> offsets;
+        std::vector<std::uint32_t> adjacency;
+        std::vector<std::uint32_t> fill;
+        bool relaxed = false;
+
+        while (result.indices.size() > target_index_count) {
+            auto& current = result.indices;
+            const Topology topology = classify(current, position_ids);
+
+            // 顶点到三角形的邻接表
+            offsets.assign(vertex_count + 1, 0);
+            for (const std::uint32_t index : current) ++offsets[index + 1];
+            for (std::size_t v = 0; v < vertex_count; ++v) offsets[v + 1] += offsets[v];
+            adjacency.resize(current.size());
+            fill.assign(offsets.begin(), offsets.end() - 1);
+            for (std::size_t i = 0; i < current.size(); ++i) {
+                adjacency[fill[current[i]]++] = static_cast<std::uint32_t>(i / 3);
+            }
+
+            // 边界与接缝顶点只能沿开放边折叠
+            const auto allowed = [&](const std::uint32_t from, const std::uint32_t to) {
+                switch (topology.kind[from]) {
+                    case VertexKind::eManifold: return true;
+                    case VertexKind::eBorder:
+                    case VertexKind::eSeam: return to == topology.open_out[from] || to == topology.open_in[from];
+                    default: return false;
+                }
+            };
+            // 接缝另一侧的顶点随之折叠到的顶点
+            const auto sibling_target = [&](const std::uint32_t from, const std::uint32_t to) {
+                const std::uint32_t sibling = topology.wedge[from];
+                return to == topology.open_out[from] ? topology.open_in[sibling] : topology.open_out[sibling];
+            };
+            const auto merged = [&](const std::uint32_t from, const std::uint32_t to) {
+                Quadric quadric = quadrics[position_ids[from]];
+                quadric += quadrics[position_ids[to]];
+                return quadric;
+            };
+
+            collapses.clear();
+            for (std::size_t i = 0; i + 2 < current.size(); i += 3) {
+                for (std::size_t c = 0; c < 3; ++c) {
+                    const std::uint32_t a = current[i + c];
+                    const std::uint32_t b = current[i + (c + 1) % 3];
+                    for (const auto [from, to] : { std::pair{ a, b }, std::pair{ b, a } }) {
+                        if (!allowed(from, to)) continue;
+                        const Quadric quadric = merged(from, to);
+                        const double error = quadric.weight > 0.0 ? quadric.evaluate(positions[to]) / quadric.weight : 0.0;
+                        collapses.push_back({ from, to, error });
+                    }
+                }
+            }
+            std::ranges::sort(collapses, [](const Collapse& lhs, const Collapse& rhs) {
+                if (lhs.error != rhs.error) return lhs.error < rhs.error;
+                if (lhs.from != rhs.from) return lhs.from < rhs.from;
+                return lhs.to < rhs.to;
+            });
+            // 同一条边被两个三角形共用，去掉重复的候选
+            const auto duplicates = std::ranges::unique(collapses, [](const Collapse& lhs, const Collapse& rhs) {
+                return lhs.from == rhs.from && lhs.to == rhs.to;
+            });
+            collapses.erase(duplicates.begin(), duplicates.end());
+
+            // 折叠后是否有三角形翻转，包含 to 的三角形会退化，不参与检查
+            const auto flips = [&](const std::uint32_t from, const std::uint32_t to) {
+                for (std::uint32_t k = offsets[from]; k < offsets[from + 1]; ++k) {
+                    const std::size_t base = adjacency[k] * 3;
+                    std::array<std::uint32_t, 3> triangle{ current[base], current[base + 1], current[base + 2] };
+                    if (std::ranges::contains(triangle, to)) continue;
+                    const glm::dvec3 before = glm::cross(
+                        positions[triangle[1]] - positions[triangle[0]],
+                        positions[triangle[2]] - positions[triangle[0]]
+                    );
+                    for (auto& v : triangle) if (v == from) v = to;
+                    const glm::dvec3 after = glm::cross(
+                        positions[triangle[1]] - positions[triangle[0]],
+                        positions[triangle[2]] - positions[triangle[0]]
+                    );
+                    if (glm::dot(before, after) <= 0.0) return true;
+                }
+                return false;
+            };
+            // 标记 from 周围的顶点，返回会退化的三角形数量
+            const auto touch = [&](const std::uint32_t from, const std::uint32_t to) {
+                std::size_t removed = 0;
+                for (std::uint32_t k = offsets[from]; k < offsets[from + 1]; ++k) {
+                    const std::size_t base = adjacency[k] * 3;
+                    bool shared = false;
+                    for (std::size_t c = 0; c < 3; ++c) {
+                        touched[current[base + c]] = true;
+                        shared |= current[base + c] == to;
+                    }
+                    removed += shared;
+                }
+                return removed;
+            };
+
+            touched.assign(vertex_count, false);
+            std::size_t triangle_count = current.size() / 3;
+            const std::size_t target_triangles = target_index_count / 3;
+            // 每次折叠约减少两个三角形；本轮只接受误差接近最优的前一部分折叠，
+            // 由于相邻的折叠会互相排斥，按 1.5 倍放宽，避免一轮中接受误差过大的折叠
+            const std::size_t goal = (triangle_count - target_triangles) / 2;
+            // 上一轮没有可执行的折叠时不再限制本轮误差
+            const double pass_limit = relaxed ? error_limit : std::min(
+                error_limit,
+                goal < collapses.size() ? collapses[goal].error * 1.5 : std::numeric_limits<double>::max()
+            );
+            std::size_t collapsed = 0;
+            for (const auto& [from, to, error] : collapses) {
+                if (triangle_count <= target_triangles || error > pass_limit) break;
+                if (touched[from] || touched[to]) continue;
+                const bool seam = topology.kind[from] == VertexKind::eSeam;
+                const std::uint32_t sibling = seam ? topology.wedge[from] : from;
+                const std::uint32_t sibling_to = seam ? sibling_target(from, to) : to;
+                if (seam && (touched[sibling] || touched[sibling_to])) continue;
+                if (flips(from, to) || (seam && flips(sibling, sibling_to))) continue;
+
+                // 同一轮中 from 周围的顶点不再参与折叠，保证翻转检查使用的三角形保持不变
+                std::size_t removed = touch(from, to);
+                remap[from] = to;
+                if (seam) {
+                    removed += touch(sibling, sibling_to);
+                    remap[sibling] = sibling_to;
+                }
+                quadrics[position_ids[to]] = merged(from, to);
+                max_error = std::max(max_error, error);
+                triangle_count -= std::min(removed, triangle_count);
+                ++collapsed;
+            }
+            if (collapsed == 0) {
+                if (relaxed) break;
+                relaxed = true;
+                continue;
+            }
+            relaxed = false;
+
+            // 应用本轮的折叠并移除退化三角形
+            std::size_t write = 0;
+            for (std::size_t i = 0; i + 2 < current.size(); i += 3) {
+                const std::uint32_t a = remap[current[i]];
+                const std::uint32_t b = remap[current[i + 1]];
+                const std::uint32_t c = remap[current[i + 2]];
+                if (a == b || b == c || a == c) continue;
+                current[write++] = a;
+                current[write++] = b;
+                current[write++] = c;
+            }
+            current.resize(write);
+            std::iota(remap.begin(), remap.end(), 0u);
+        }
+        result.error = static_cast<float>(std::sqrt(max_error));
+        return result;
+    }
+
+}
@@ -0,0 +1,190 @@
+export module Meshlet;
+
+import std;
+import glm;
+
+import Config;
+import DataLoader;
+
+namespace vht {
+
+    constexpr std::uint32_t NO_SLOT = std::numeric_limits<std::uint32_t>::max();
+
+    // Ritter 包围球：先取近似直径，再逐点扩张
+    [[nodiscard]]
+    glm::vec4 bounding_sphere(const std::span<const glm::vec3> points) {
+        if (points.empty()) return glm::vec4{ 0.0f };
+        const glm::vec3 first = points[0];
+        const auto farthest = [&](const glm::vec3 from) {
+            glm::vec3 best = from;
+            float best_distance = -1.0f;
+            for (const auto& point : points) {
+                const float d = glm::dot(point - from, point - from);
+                if (d > best_distance) {
+                    best_distance = d;
+                    best = point;
+                }
+            }
+            return best;
+        };
+        const glm::vec3 a = farthest(first);
+        const glm::vec3 b = farthest(a);
+        glm::vec3 center = (a + b) * 0.5f;
+        float radius = glm::length(b - a) * 0.5f;
+        for (const auto& point : points) {
+            const float d = glm::length(point - center);
+            if (d > radius) {
+                const float new_radius = (radius + d) * 0.5f;
+                center += (point - center) * ((new_radius - radius) / d);
+                radius = new_radius;
+            }
+        }
+        return { center, radius };
+    }
+
+}
+
+export namespace vht {
+
+    /**
+     * @brief GPU 中的 meshlet 描述，布局与着色器中的 std430 结构一致
+     * @details
+     * - sphere: 包围球，xyz 为球心，w 为半径
+     * - cone: 法线锥，xyz 为轴，w 为截断值；w 为 1 时不做背面剔除
+     * - vertex_offset/vertex_count: 在 meshlet 顶点表中的范围
+     * - triangle_offset/triangle_count: 在 meshlet 三角形表中的范围
+     */
+    struct GpuMeshlet {
+        glm::vec4 sphere;
+        glm::vec4 cone;
+        std::uint32_t vertex_offset;
+        std::uint32_t triangle_offset;
+        std::uint32_t vertex_count;
+        std::uint32_t triangle_count;
+    };
+    static_assert(sizeof(GpuMeshlet) == 48);
+
+    /**
+     * @brief meshlet 构建结果
+     * @details
+     * - meshlets: meshlet 描述
+     * - vertices: meshlet 局部顶点到网格顶点的映射
+     * - triangles: 局部三角形，每个三角形的三个 8 位局部索引打包为一个 uint32
+     */
+    struct MeshletData {
+        std::vector<GpuMeshlet> meshlets;
+        std::vector<std::uint32_t> vertices;
+        std::vector<std::uint32_t> triangles;
+    };
+
+    /**
+     * @brief 一段连续的 meshlet，对应网格的一个 LOD
+     */
+    struct MeshletRange {
+        std::uint32_t offset{};
+        std::uint32_t count{};
+    };
+
+    /**
+     * @brief 将 source 追加到 target 末尾，并修正顶点表和三角形表的偏移
+     * @return 追加的 meshlet 在 target 中的范围
+     */
+    MeshletRange append_meshlets(MeshletData& target, const MeshletData& source) {
+        const MeshletRange range{
+            static_cast<std::uint32_t>(target.meshlets.size()),
+            static_cast<std::uint32_t>(source.meshlets.size())
+        };
+        const auto vertex_base = static_cast<std::uint32_t>(target.vertices.size());
+        const auto triangle_base = static_cast<std::uint32_t>(target.triangles.size());
+        for (GpuMeshlet meshlet : source.meshlets) {
+            meshlet.vertex_offset += vertex_base;
+            meshlet.triangle_offset += triangle_base;
+            target.meshlets.push_back(meshlet);
+        }
+        target.vertices.insert(target.vertices.end(), source.vertices.begin(), source.vertices.end());
+        target.triangles.insert(target.triangles.end(), source.triangles.begin(), source.triangles.end());
+        return range;
+    }
+
+    /**
+     * @brief 构建 meshlet
+     * @details
+     * - 按索引顺序贪心地填充 meshlet，直到顶点或三角形达到上限；
+     *   索引已经过顶点缓存优化，相邻三角形共享顶点较多
+     * - 为每个 meshlet 计算包围球和法线锥，法线锥的截断值与 meshoptimizer 的约定相同：
+     *   dot(center - camera, axis) >= cutoff * length(center - camera) + radius 时整个 meshlet 背向相机
+     */
+    template<typename Index>
+    [[nodiscard]]
+    MeshletData build_meshlets(const std::span<const Vertex> vertices, const std::span<const Index> indices) {
+        MeshletData result;
+        std::vector<std::uint32_t> slots(vertices.size(), NO_SLOT);
+        GpuMeshlet current{};
+
+        const auto finish = [&] {
+            if (current.triangle_count == 0) return;
+            const std::span meshlet_vertices{ result.vertices.data() + current.vertex_offset, current.vertex_count };
+            std::vector<glm::vec3> points;
+            points.reserve(meshlet_vertices.size());
+            for (const std::uint32_t v : meshlet_vertices) {
+                points.push_back(vertices[v].pos);
+                slots[v] = NO_SLOT;
+            }
+            current.sphere = bounding_sphere(points);
+
+            std::vector<glm::vec3> normals;
+            normals.reserve(current.triangle_count);
+            glm::vec3 axis{ 0.0f };
+            for (std::uint32_t t = 0; t < current.triangle_count; ++t) {
+                const std::uint32_t packed = result.triangles[current.triangle_offset + t];
+                const glm::vec3 p0 = points[packed & 0xff];
+                const glm::vec3 p1 = points[(packed >> 8) & 0xff];
+                const glm::vec3 p2 = points[(packed >> 16) & 0xff];
+                const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                const float length = glm::length(normal);
+                if (length <= 0.0f) continue;
+                normals.push_back(normal / length);
+                axis += normal / length;
+            }
+            current.cone = { 0.0f, 0.0f, 0.0f, 1.0f };
+            if (const float axis_length = glm::length(axis); axis_length > 0.0f && !normals.empty()) {
+                axis /= axis_length;
+                float min_dot = 1.0f;
+                for (const auto& normal : normals) min_dot = std::min(min_dot, glm::dot(normal, axis));
+                // 法线分布过宽时无法整体剔除
+                if (min_dot > 0.1f) current.cone = { axis, std::sqrt(1.0f - min_dot * min_dot) };
+            }
+            result.meshlets.push_back(current);
+            current = {};
+            current.vertex_offset = static_cast<std::uint32_t>(result.vertices.size());
+            current.triangle_offset = static_cast<std::uint32_t>(result.triangles.size());
+        };
+
+        for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+            const std::array<std::uint32_t, 3> triangle{ indices[i], indices[i + 1], indices[i + 2] };
+            std::uint32_t new_vertices = 0;
+            for (std::size_t c = 0; c < 3; ++c) {
+                const bool repeated = (c > 0 && triangle[c] == triangle[0]) || (c > 1 && triangle[c] == triangle[1]);
+                if (slots[triangle[c]] == NO_SLOT && !repeated) ++new_vertices;
+            }
+            if (current.vertex_count + new_vertices > MESHLET_MAX_VERTICES ||
+                current.triangle_count + 1 > MESHLET_MAX_TRIANGLES) {
+                finish();
+            }
+            std::uint32_t packed = 0;
+            for (std::size_t c = 0; c < 3; ++c) {
+                std::uint32_t& slot = slots[triangle[c]];
+                if (slot == NO_SLOT) {
+                    slot = current.vertex_count++;
+                    result.vertices.push_back(triangle[c]);
+                }
+                packed |= slot << (8 * c);
+            }
+            result.triangles.push_back(packed);
+            ++current.triangle_count;
+        }
+        finish();
+        return result;
+    }
+
+}
@@ -0,0 +1,171 @@
+export module MeshletAssembly;
+
+import std;
+import vulkan_hpp;
+
+import Config;
+import DataLoader;
+import Tools;
+import Device;
+import MemoryAllocator;
+import UploadBatcher;
+import Meshlet;
+
+export namespace vht {
+
+    // 已构建并确认容量足够的 meshlet，ranges 为相对于网格自身的范围
+    struct PreparedMeshlets {
+        MeshletData data;
+        std::vector<MeshletRange> ranges;
+    };
+
+    /**
+     * @brief meshlet 数据与缓冲区
+     * @details
+     * - 依赖：
+     *  - m_device: 逻辑设备与队列
+     *  - m_allocator: 设备内存分配器
+     * - 工作：
+     *  - 设备启用网格着色器时，创建可容纳 MESHLET_CAPACITY 个 meshlet 的存储缓冲区
+     *  - prepare_mesh() 为网格的每个 LOD 构建 meshlet 并检查容量，upload_mesh() 依次追加到缓冲区并记录上传命令，
+     *    都由加载线程调用；先检查容量，其他缓冲区预留空间之前就能发现放不下
+     *  - meshlet 顶点表中的索引相对于网格自身的第一个顶点，与索引缓冲区一致
+     *  - 上传完成后由主线程调用 add_ranges() 登记网格的 meshlet 范围，与 InputAssembly 的绘制列表一一对应
+     *  - 未启用时不做任何工作，upload_mesh() 返回空范围
+     * - 可访问成员：
+     *  - meshlet_buffer(): meshlet 描述
+     *  - vertex_buffer(): meshlet 顶点表
+     *  - triangle_buffer(): meshlet 三角形表
+     *  - lod_ranges(): lod_ranges()[网格][LOD] 为对应的 meshlet 范围
+     */
+    class MeshletAssembly {
+        std::shared_ptr<vht::Device> m_device{ nullptr };
+        std::shared_ptr<vht::MemoryAllocator> m_allocator{ nullptr };
+        vht::Allocation m_meshlet_allocation{ nullptr };
+        vk::raii::Buffer m_meshlet_buffer{ nullptr };
+        vht::Allocation m_vertex_allocation{ nullptr };
+        vk::raii::Buffer m_vertex_buffer{ nullptr };
+        vht::Allocation m_triangle_allocation{ nullptr };
+        vk::raii::Buffer m_triangle_buffer{ nullptr };
+        // 已写入的元素数量，只由加载线程访问
+        std::uint64_t m_meshlet_head{ 0 };
+        std::uint64_t m_vertex_head{ 0 };
+        std::uint64_t m_triangle_head{ 0 };
+        std::vector<std::vector<MeshletRange>> m_lod_ranges; // 只由主线程访问
+    public:
+        explicit MeshletAssembly(
+            std::shared_ptr<vht::Device> device,
+            std::shared_ptr<vht::MemoryAllocator> allocator
+        ):  m_device(std::move(device)),
+            m_allocator(std::move(allocator)) {
+            init();
+        }
+
+        [[nodiscard]]
+        const vk::raii::Buffer& meshlet_buffer() const { return m_meshlet_buffer; }
+        [[nodiscard]]
+        const vk::raii::Buffer& vertex_buffer() const { return m_vertex_buffer; }
+        [[nodiscard]]
+        const vk::raii::Buffer& triangle_buffer() const { return m_triangle_buffer; }
+        [[nodiscard]]
+        const std::vector<std::vector<MeshletRange>>& lod_ranges() const { return m_lod_ranges; }
+
+        /**
+         * @brief 为网格的每个 LOD 构建 meshlet，并检查缓冲区剩余容量，不修改缓冲区
+         * @throw std::runtime_error meshlet 缓冲区容量不足
+         */
+        [[nodiscard]]
+        PreparedMeshlets prepare_mesh(const vht::DataLoader& mesh) const {
+            if (!m_device->mesh_shader_supported()) return {};
+            auto [data, ranges] = build(mesh);
+            if (m_meshlet_head + data.meshlets.size() > MESHLET_CAPACITY ||
+                m_vertex_head + data.vertices.size() > MESHLET_CAPACITY * MESHLET_MAX_VERTICES ||
+                m_triangle_head + data.triangles.size() > MESHLET_CAPACITY * MESHLET_MAX_TRIANGLES) {
+                throw std::runtime_error("meshlet buffers are full!");
+            }
+            return { std::move(data), std::move(ranges) };
+        }
+
+        /**
+         * @brief 把 prepare_mesh() 的结果追加到缓冲区，并记录上传命令
+         * @return 每个 LOD 在 meshlet 缓冲区中的范围
+         */
+        [[nodiscard]]
+        std::vector<MeshletRange> upload_mesh(PreparedMeshlets prepared, vht::UploadBatcher& upload_batcher) {
+            if (!m_device->mesh_shader_supported()) return {};
+            auto& [data, ranges] = prepared;
+            // 换算为在整个缓冲区中的位置
+            for (auto& meshlet : data.meshlets) {
+                meshlet.vertex_offset += static_cast<std::uint32_t>(m_vertex_head);
+                meshlet.triangle_offset += static_cast<std::uint32_t>(m_triangle_head);
+            }
+            for (auto& range : ranges) range.offset += static_cast<std::uint32_t>(m_meshlet_head);
+
+            upload(upload_batcher, m_meshlet_buffer, m_meshlet_head, std::span<const GpuMeshlet>{ data.meshlets });
+            upload(upload_batcher, m_vertex_buffer, m_vertex_head, std::span<const std::uint32_t>{ data.vertices });
+            upload(upload_batcher, m_triangle_buffer, m_triangle_head, std::span<const std::uint32_t>{ data.triangles });
+            return std::move(ranges);
+        }
+
+        // 登记上传完成的网格的 meshlet 范围，只能在主线程调用
+        void add_ranges(std::vector<MeshletRange> ranges) { m_lod_ranges.push_back(std::move(ranges)); }
+
+    private:
+        void init() {
+            if (!m_device->mesh_shader_supported()) return;
+            create_storage_buffer(m_meshlet_buffer, m_meshlet_allocation, sizeof(GpuMeshlet) * MESHLET_CAPACITY);
+            create_storage_buffer(m_vertex_buffer, m_vertex_allocation, sizeof(std::uint32_t) * MESHLET_CAPACITY * MESHLET_MAX_VERTICES);
+            create_storage_buffer(m_triangle_buffer, m_triangle_allocation, sizeof(std::uint32_t) * MESHLET_CAPACITY * MESHLET_MAX_TRIANGLES);
+        }
+        // 按网格的索引类型为网格的每个 LOD 构建 meshlet
+        [[nodiscard]]
+        std::pair<MeshletData, std::vector<MeshletRange>> build(const vht::DataLoader& mesh) const {
+            const auto start_time = std::chrono::steady_clock::now();
+            MeshletData data;
+            std::vector<MeshletRange> ranges;
+            const auto vertices = mesh.vertices();
+            const auto index_data = mesh.index_data();
+            for (const auto& lod : mesh.lods()) {
+                MeshletData part;
+                if (mesh.index_type() == vk::IndexType::eUint16) {
+                    part = vht::build_meshlets(vertices, std::span{
+                        reinterpret_cast<const std::uint16_t*>(index_data.data()) + lod.index_offset, lod.index_count
+                    });
+                } else {
+                    part = vht::build_meshlets(vertices, std::span{
+                        reinterpret_cast<const std::uint32_t*>(index_data.data()) + lod.index_offset, lod.index_count
+                    });
+                }
+                ranges.push_back(vht::append_meshlets(data, part));
+            }
+            const auto end_time = std::chrono::steady_clock::now();
+            std::println("meshlets built for {}: {} meshlets, {:.2f} ms", mesh.path().generic_string(), data.meshlets.size(),
+                std::chrono::duration<double, std::milli>(end_time - start_time).count());
+            return { std::move(data), std::move(ranges) };
+        }
+        // 把元素追加到缓冲区的 head 处
+        template<typename T>
+        void upload(vht::UploadBatcher& upload_batcher, const vk::raii::Buffer& buffer, std::uint64_t& head, const std::span<const T> data) {
+            if (data.empty()) return;
+            upload_batcher.upload_buffer(data.data(), data.size_bytes(), buffer, sizeof(T) * head);
+            head += data.size();
+        }
+        // 创建存储缓冲区，上传与绘制之间由时间线信号量同步，在队列族之间并发共享
+        void create_storage_buffer(vk::raii::Buffer& buffer, vht::Allocation& allocation, const vk::DeviceSize size) {
+            const auto indices = m_device->queue_family_indices();
+            const std::array queue_families{ indices.graphics_family.value(), indices.transfer_family.value() };
+            vht::create_buffer(
+                buffer,
+                allocation,
+                m_device->device(),
+                *m_allocator,
+                size,
+                vk::BufferUsageFlagBits::eTransferDst |
+                vk::BufferUsageFlagBits::eStorageBuffer,
+                vk::MemoryPropertyFlagBits::eDeviceLocal,
+                queue_families
+            );
+        }
+    };
+
+}
@@ -0,0 +1,307 @@
+export module MipmapGenerator;
+
+import std;
+import vulkan_hpp;
+
+import Tools;
+import Device;
+import PipelineCache;
+import ShaderManager;
+
+export namespace vht {
+
+    /**
+     * @brief 计算完整 mip 链的层数
+     */
+    [[nodiscard]]
+    std::uint32_t mip_level_count(const std::uint32_t width, const std::uint32_t height) {
+        return static_cast<std::uint32_t>(std::bit_width(std::max({ width, height, 1u })));
+    }
+
+    /**
+     * @brief mip 链生成
+     * @details
+     * - 依赖：
+     *  - m_device: 物理/逻辑设备
+     *  - m_pipeline_cache: 管线缓存
+     *  - m_shader_manager: 着色器编译
+     * - 工作：
+     *  - 格式支持线性过滤的 blit 时，用 vkCmdBlitImage 逐级缩小
+     *  - 否则用计算着色器做 2x2 盒式滤波，图像以 UNORM 存储视图访问，sRGB 在着色器中转换；
+     *    计算管线在第一次需要时创建
+     *  - 命令需记录在图形队列族的命令缓冲区中，调用前所有层级处于 TransferDstOptimal 且第 0 级已写入，
+     *    完成后所有层级处于 ShaderReadOnlyOptimal，可供片段着色器采样
+     *  - 计算路径使用的视图与描述符集保留到本对象销毁
+     * - 可访问成员：
+     *  - blit_supported(): 格式是否支持线性过滤的 blit
+     *  - image_usage(): 生成 mip 链所需的额外图像用途
+     *  - image_flags(): 生成 mip 链所需的图像创建标志
+     */
+    class MipmapGenerator {
+        struct ComputeResources {
+            vk::raii::DescriptorPool pool{ nullptr };
+            std::vector<vk::raii::ImageView> views;
+            std::vector<vk::raii::DescriptorSet> sets;
+        };
+        std::shared_ptr<vht::Device> m_device;
+        std::shared_ptr<vht::PipelineCache> m_pipeline_cache;
+        std::shared_ptr<vht::ShaderManager> m_shader_manager;
+        vk::raii::DescriptorSetLayout m_descriptor_set_layout{ nullptr };
+        vk::raii::PipelineLayout m_pipeline_layout{ nullptr };
+        vk::raii::Pipeline m_pipeline{ nullptr };
+        std::vector<ComputeResources> m_resources;
+    public:
+        explicit MipmapGenerator(
+            std::shared_ptr<vht::Device> device,
+            std::shared_ptr<vht::PipelineCache> pipeline_cache,
+            std::shared_ptr<vht::ShaderManager> shader_manager
+        ):  m_device(std::move(device)),
+            m_pipeline_cache(std::move(pipeline_cache)),
+            m_shader_manager(std::move(shader_manager)) {}
+
+        [[nodiscard]]
+        bool blit_supported(const vk::Format format) const {
+            const auto features = m_device->physical_device().getFormatProperties(format).optimalTilingFeatures;
+            constexpr auto required = vk::FormatFeatureFlagBits::eBlitSrc |
+                                      vk::FormatFeatureFlagBits::eBlitDst |
+                                      vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+            return (features & required) == required;
+        }
+        [[nodiscard]]
+        vk::ImageUsageFlags image_usage(const vk::Format format) const {
+            return blit_supported(format) ? vk::ImageUsageFlagBits::eTransferSrc : vk::ImageUsageFlagBits::eStorage;
+        }
+        // 存储视图使用 UNORM 格式，图像需允许以不同格式创建视图
+        [[nodiscard]]
+        vk::ImageCreateFlags image_flags(const vk::Format format) const {
+            if (blit_supported(format)) return {};
+            return vk::ImageCreateFlagBits::eMutableFormat | vk::ImageCreateFlagBits::eExtendedUsage;
+        }
+
+        /**
+         * @brief 记录生成 mip 链的命令
+         * @param command_buffer 图形队列族的命令缓冲区
+         */
+        void generate(
+            const vk::raii::CommandBuffer& command_buffer,
+            const vk::Image image,
+            const vk::Format format,
+            const std::uint32_t width,
+            const std::uint32_t height,
+            const std::uint32_t mip_levels
+        ) {
+            if (blit_supported(format)) {
+                generate_blit(command_buffer, image, width, height, mip_levels);
+            } else {
+                generate_compute(command_buffer, image, format, width, height, mip_levels);
+            }
+        }
+
+    private:
+        // 逐级 blit，每一级读完后立即转为着色器只读布局
+        static void generate_blit(
+            const vk::raii::CommandBuffer& command_buffer,
+            const vk::Image image,
+            const std::uint32_t width,
+            const std::uint32_t height,
+            const std::uint32_t mip_levels
+        ) {
+            vk::ImageMemoryBarrier2 barrier;
+            barrier.image = image;
+            barrier.srcQueueFamilyIndex = vk::QueueFamilyIgnored;
+            barrier.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
+            barrier.subresourceRange = { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+
+            auto mip_width = static_cast<std::int32_t>(width);
+            auto mip_height = static_cast<std::int32_t>(height);
+            for (std::uint32_t level = 1; level < mip_levels; ++level) {
+                // 上一级由复制或 blit 写入，转为 blit 源
+                barrier.subresourceRange.baseMipLevel = level - 1;
+                barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+                barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+                barrier.srcStageMask = vk::PipelineStageFlagBits2::eTransfer;
+                barrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+                barrier.dstStageMask = vk::PipelineStageFlagBits2::eBlit;
+                barrier.dstAccessMask = vk::AccessFlagBits2::eTransferRead;
+                command_buffer.pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( barrier ) );
+
+                const std::int32_t next_width = std::max(mip_width / 2, 1);
+                const std::int32_t next_height = std::max(mip_height / 2, 1);
+                vk::ImageBlit2 region;
+                region.srcSubresource = { vk::ImageAspectFlagBits::eColor, level - 1, 0, 1 };
+                region.srcOffsets[1] = vk::Offset3D{ mip_width, mip_height, 1 };
+                region.dstSubresource = { vk::ImageAspectFlagBits::eColor, level, 0, 1 };
+                region.dstOffsets[1] = vk::Offset3D{ next_width, next_height, 1 };
+                vk::BlitImageInfo2 blit_info;
+                blit_info.srcImage = image;
+                blit_info.srcImageLayout = vk::ImageLayout::eTransferSrcOptimal;
+                blit_info.dstImage = image;
+                blit_info.dstImageLayout = vk::ImageLayout::eTransferDstOptimal;
+                blit_info.filter = vk::Filter::eLinear;
+                blit_info.setRegions( region );
+                command_buffer.blitImage2( blit_info );
+
+                // 上一级不再使用，交给片段着色器
+                barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+                barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+                barrier.srcStageMask = vk::PipelineStageFlagBits2::eBlit;
+                barrier.srcAccessMask = vk::AccessFlagBits2::eNone;
+                barrier.dstStageMask = vk::PipelineStageFlagBits2::eFragmentShader;
+                barrier.dstAccessMask = vk::AccessFlagBits2::eShaderSampledRead;
+                command_buffer.pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( barrier ) );
+
+                mip_width = next_width;
+                mip_height = next_height;
+            }
+            // 最后一级只被写入
+            barrier.subresourceRange.baseMipLevel = mip_levels - 1;
+            barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+            barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+            barrier.srcStageMask = vk::PipelineStageFlagBits2::eTransfer;
+            barrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+            barrier.dstStageMask = vk::PipelineStageFlagBits2::eFragmentShader;
+            barrier.dstAccessMask = vk::AccessFlagBits2::eShaderSampledRead;
+            command_buffer.pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( barrier ) );
+        }
+
+        // 计算着色器逐级缩小，所有层级在 General 布局下读写
+        void generate_compute(
+            const vk::raii::CommandBuffer& command_buffer,
+            const vk::Image image,
+            const vk::Format format,
+            const std::uint32_t width,
+            const std::uint32_t height,
+            const std::uint32_t mip_levels
+        ) {
+            const auto [view_format, srgb] = storage_format(format);
+            if (!*m_pipeline) create_pipeline();
+            auto& resources = allocate_resources(image, view_format, mip_levels);
+
+            vk::ImageMemoryBarrier2 barrier;
+            barrier.image = image;
+            barrier.srcQueueFamilyIndex = vk::QueueFamilyIgnored;
+            barrier.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
+            barrier.subresourceRange = { vk::ImageAspectFlagBits::eColor, 0, mip_levels, 0, 1 };
+            barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+            barrier.newLayout = vk::ImageLayout::eGeneral;
+            barrier.srcStageMask = vk::PipelineStageFlagBits2::eTransfer;
+            barrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+            barrier.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+            barrier.dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite;
+            command_buffer.pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( barrier ) );
+
+            command_buffer.bindPipeline( vk::PipelineBindPoint::eCompute, m_pipeline );
+            const std::uint32_t srgb_flag = srgb ? 1 : 0;
+            command_buffer.pushConstants<std::uint32_t>( m_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, srgb_flag );
+
+            barrier.oldLayout = vk::ImageLayout::eGeneral;
+            barrier.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+            barrier.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite;
+            barrier.subresourceRange.levelCount = 1;
+            for (std::uint32_t level = 1; level < mip_levels; ++level) {
+                command_buffer.bindDescriptorSets(
+                    vk::PipelineBindPoint::eCompute,
+                    m_pipeline_layout,
+                    0,
+                    *resources.sets[level - 1],
+                    nullptr
+                );
+                const std::uint32_t level_width = std::max(width >> level, 1u);
+                const std::uint32_t level_height = std::max(height >> level, 1u);
+                command_buffer.dispatch((level_width + 7) / 8, (level_height + 7) / 8, 1);
+
+                // 下一次调度读取刚写入的层级
+                barrier.subresourceRange.baseMipLevel = level;
+                barrier.newLayout = vk::ImageLayout::eGeneral;
+                barrier.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+                barrier.dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead;
+                command_buffer.pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( barrier ) );
+            }
+
+            barrier.subresourceRange = { vk::ImageAspectFlagBits::eColor, 0, mip_levels, 0, 1 };
+            barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+            barrier.dstStageMask = vk::PipelineStageFlagBits2::eFragmentShader;
+            barrier.dstAccessMask = vk::AccessFlagBits2::eShaderSampledRead;
+            command_buffer.pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( barrier ) );
+        }
+
+        // 存储视图的格式，以及是否需要在着色器中做 sRGB 转换
+        [[nodiscard]]
+        static std::pair<vk::Format, bool> storage_format(const vk::Format format) {
+            switch (format) {
+                case vk::Format::eR8G8B8A8Srgb: return { vk::Format::eR8G8B8A8Unorm, true };
+                case vk::Format::eR8G8B8A8Unorm: return { vk::Format::eR8G8B8A8Unorm, false };
+                default: throw std::runtime_error("unsupported format for compute mipmap generation!");
+            }
+        }
+
+        // 为每一级创建存储视图，并为每次调度分配描述符集：绑定 0 为上一级，绑定 1 为当前级
+        [[nodiscard]]
+        ComputeResources& allocate_resources(const vk::Image image, const vk::Format view_format, const std::uint32_t mip_levels) {
+            ComputeResources resources;
+            const std::uint32_t dispatch_count = std::max(mip_levels, 2u) - 1;
+
+            const vk::DescriptorPoolSize pool_size{ vk::DescriptorType::eStorageImage, 2 * dispatch_count };
+            vk::DescriptorPoolCreateInfo pool_info;
+            pool_info.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+            pool_info.maxSets = dispatch_count;
+            pool_info.setPoolSizes( pool_size );
+            resources.pool = m_device->device().createDescriptorPool( pool_info );
+
+            for (std::uint32_t level = 0; level < mip_levels; ++level) {
+                resources.views.emplace_back( vht::create_image_view(
+                    m_device->device(), image, view_format, vk::ImageAspectFlagBits::eColor, 1, level
+                ) );
+            }
+
+            const std::vector<vk::DescriptorSetLayout> layouts(dispatch_count, *m_descriptor_set_layout);
+            vk::DescriptorSetAllocateInfo alloc_info;
+            alloc_info.descriptorPool = resources.pool;
+            alloc_info.setSetLayouts( layouts );
+            resources.sets = m_device->device().allocateDescriptorSets( alloc_info );
+
+            for (std::uint32_t level = 1; level < mip_levels; ++level) {
+                const std::array<vk::DescriptorImageInfo, 2> image_infos{
+                    vk::DescriptorImageInfo{ nullptr, resources.views[level - 1], vk::ImageLayout::eGeneral },
+                    vk::DescriptorImageInfo{ nullptr, resources.views[level], vk::ImageLayout::eGeneral }
+                };
+                vk::WriteDescriptorSet write;
+                write.dstSet = resources.sets[level - 1];
+                write.dstBinding = 0;
+                write.descriptorType = vk::DescriptorType::eStorageImage;
+                write.setImageInfo( image_infos );
+                m_device->device().updateDescriptorSets( write, nullptr );
+            }
+            return m_resources.emplace_back( std::move(resources) );
+        }
+
+        // 创建计算管线
+        void create_pipeline() {
+            std::array<vk::DescriptorSetLayoutBinding, 2> bindings;
+            for (std::uint32_t i = 0; i < bindings.size(); ++i) {
+                bindings[i].binding = i;
+                bindings[i].descriptorType = vk::DescriptorType::eStorageImage;
+                bindings[i].descriptorCount = 1;
+                bindings[i].stageFlags = vk::ShaderStageFlagBits::eCompute;
+            }
+            vk::DescriptorSetLayoutCreateInfo layout_info;
+            layout_info.setBindings( bindings );
+            m_descriptor_set_layout = m_device->device().createDescriptorSetLayout( layout_info );
+
+            const vk::PushConstantRange push_constant_range{ vk::ShaderStageFlagBits::eCompute, 0, sizeof(std::uint32_t) };
+            vk::PipelineLayoutCreateInfo pipeline_layout_info;
+            pipeline_layout_info.setSetLayouts( *m_descriptor_set_layout );
+            pipeline_layout_info.setPushConstantRanges( push_constant_range );
+            m_pipeline_layout = m_device->device().createPipelineLayout( pipeline_layout_info );
+
+            const auto shader_module = m_shader_manager->create_module("shaders/mipmap.comp.glsl");
+            vk::ComputePipelineCreateInfo create_info;
+            create_info.stage.stage = vk::ShaderStageFlagBits::eCompute;
+            create_info.stage.module = shader_module;
+            create_info.stage.pName = "main";
+            create_info.layout = m_pipeline_layout;
+            m_pipeline = m_pipeline_cache->create_compute_pipeline( "mipmap", create_info );
+        }
+    };
+
+}
@@ -0,0 +1,348 @@
+export module ObjParser;
+
+import std;
+
+import MappedFile;
+
+namespace vht {
+
+    /**
+     * @brief 解析实数
+     * @details
+     * 与 tinyobjloader 的 tryParseDouble 使用完全相同的运算顺序，
+     * 保证与旧的 tinyobj 路径得到逐位相同的结果。不依赖区域设置，也不分配内存。
+     * 解析失败时返回 0，与 tinyobj 的默认值一致。
+     */
+    [[nodiscard]]
+    float parse_real(const char* curr, const char* const end) {
+        constexpr std::array<double, 8> pow_lut{ 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+        const auto is_digit = [](const char c) { return c >= '0' && c <= '9'; };
+        if (curr >= end) return 0.0f;
+
+        double mantissa = 0.0;
+        int exponent = 0;
+        bool negative = false;
+        bool leading_dot = false;
+        if (*curr == '+' || *curr == '-') {
+            negative = *curr == '-';
+            ++curr;
+            leading_dot = curr != end && *curr == '.';
+        } else if (*curr == '.') {
+            leading_dot = true;
+        } else if (!is_digit(*curr)) {
+            return 0.0f;
+        }
+
+        if (!leading_dot) {
+            int read = 0;
+            for (; curr != end && is_digit(*curr); ++curr, ++read) {
+                mantissa *= 10;
+                mantissa += static_cast<int>(*curr - '0');
+            }
+            if (read == 0) return 0.0f;
+        }
+        if (curr != end && *curr == '.') {
+            ++curr;
+            for (int read = 1; curr != end && is_digit(*curr); ++curr, ++read) {
+                mantissa += static_cast<int>(*curr - '0') *
+                    (read < static_cast<int>(pow_lut.size()) ? pow_lut[read] : std::pow(10.0, -read));
+            }
+        }
+        if (curr != end && (*curr == 'e' || *curr == 'E')) {
+            ++curr;
+            bool exp_negative = false;
+            if (curr != end && (*curr == '+' || *curr == '-')) {
+                exp_negative = *curr == '-';
+                ++curr;
+            }
+            int read = 0;
+            for (; curr != end && is_digit(*curr); ++curr, ++read) {
+                if (exponent > std::numeric_limits<int>::max() / 10) return 0.0f;
+                exponent *= 10;
+                exponent += static_cast<int>(*curr - '0');
+            }
+            if (read == 0) return 0.0f;
+            if (exp_negative) exponent = -exponent;
+        }
+        const double value = (negative ? -1 : 1) *
+            (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+        return static_cast<float>(value);
+    }
+
+    [[nodiscard]]
+    bool is_space(const char c) { return c == ' ' || c == '\t'; }
+    [[nodiscard]]
+    bool is_token_end(const char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    // 跳过空白并返回下一个词的结束位置
+    [[nodiscard]]
+    const char* next_token(const char*& curr, const char* const end) {
+        while (curr != end && is_space(*curr)) ++curr;
+        const char* token_end = curr;
+        while (token_end != end && !is_token_end(*token_end)) ++token_end;
+        return token_end;
+    }
+
+    // 解析 n 个实数，缺少的分量为 0
+    void parse_reals(const char* curr, const char* const end, float* out, const int n) {
+        for (int i = 0; i < n; ++i) {
+            const char* token_end = next_token(curr, end);
+            out[i] = parse_real(curr, token_end);
+            curr = token_end;
+        }
+    }
+
+    // 面的一个角点，相对索引在合并阶段加上前面分块的元素数量
+    struct RawCorner {
+        std::int32_t position{};
+        std::int32_t texcoord{};
+        bool position_relative{};
+        bool texcoord_relative{};
+    };
+
+    // 单个分块的解析结果
+    struct ObjChunk {
+        std::vector<float> positions;
+        std::vector<float> texcoords;
+        std::vector<RawCorner> corners;
+        std::vector<std::uint32_t> face_sizes;
+        std::size_t triangle_count{};
+    };
+
+    constexpr std::int32_t NO_INDEX = std::numeric_limits<std::int32_t>::min();
+
+    /**
+     * @brief 将 OBJ 索引转换为从 0 开始的索引
+     * @details 负索引相对于当前已读取的元素数量，在分块内只能先记录为局部值
+     */
+    [[nodiscard]]
+    std::int32_t fix_index(const int index, const std::size_t local_count, bool& relative) {
+        if (index > 0) return index - 1;
+        if (index == 0) throw std::runtime_error("OBJ index 0 is not allowed!");
+        relative = true;
+        return static_cast<std::int32_t>(local_count) + index;
+    }
+
+    // 解析 f 行，只保留位置和纹理坐标索引
+    void parse_face(const char* curr, const char* const end, ObjChunk& chunk) {
+        std::uint32_t count = 0;
+        while (true) {
+            const char* token_end = next_token(curr, end);
+            if (curr == token_end) break;
+            RawCorner corner{};
+            corner.texcoord = NO_INDEX;
+            int value = 0;
+            auto [ptr, ec] = std::from_chars(curr, token_end, value);
+            if (ec != std::errc{}) throw std::runtime_error("invalid face in OBJ file!");
+            corner.position = fix_index(value, chunk.positions.size() / 3, corner.position_relative);
+            if (ptr != token_end && *ptr == '/') {
+                ++ptr;
+                if (ptr != token_end && *ptr != '/') {
+                    const auto texcoord_result = std::from_chars(ptr, token_end, value);
+                    if (texcoord_result.ec != std::errc{}) throw std::runtime_error("invalid face in OBJ file!");
+                    corner.texcoord = fix_index(value, chunk.texcoords.size() / 2, corner.texcoord_relative);
+                }
+            }
+            chunk.corners.push_back(corner);
+            ++count;
+            curr = token_end;
+        }
+        chunk.face_sizes.push_back(count);
+        if (count >= 3) chunk.triangle_count += count - 2;
+    }
+
+    // 解析 [begin, end) 内的所有行，begin 与 end 均位于行首
+    void parse_chunk(const char* curr, const char* const end, ObjChunk& chunk) {
+        while (curr != end) {
+            const char* line_end = static_cast<const char*>(std::memchr(curr, '\n', end - curr));
+            if (line_end == nullptr) line_end = end;
+            while (curr != line_end && is_space(*curr)) ++curr;
+            if (line_end - curr >= 2 && is_space(curr[1])) {
+                if (curr[0] == 'v') {
+                    float xyz[3];
+                    parse_reals(curr + 2, line_end, xyz, 3);
+                    chunk.positions.insert(chunk.positions.end(), xyz, xyz + 3);
+                } else if (curr[0] == 'f') {
+                    parse_face(curr + 2, line_end, chunk);
+                }
+            } else if (line_end - curr >= 3 && curr[0] == 'v' && curr[1] == 't' && is_space(curr[2])) {
+                float uv[2];
+                parse_reals(curr + 3, line_end, uv, 2);
+                chunk.texcoords.insert(chunk.texcoords.end(), uv, uv + 2);
+            }
+            curr = line_end == end ? end : line_end + 1;
+        }
+    }
+
+}
+
+export namespace vht {
+
+    /**
+     * @brief 三角化后的一个角点
+     * @details
+     * - position: 位置索引
+     * - texcoord: 纹理坐标索引，没有纹理坐标时为 -1
+     */
+    struct ObjCorner {
+        std::int32_t position{};
+        std::int32_t texcoord{};
+    };
+
+    /**
+     * @brief OBJ 解析结果
+     * @details
+     * - positions: 顶点位置，每 3 个分量一组
+     * - texcoords: 纹理坐标，每 2 个分量一组
+     * - corners: 三角化后的角点，每 3 个组成一个三角形，顺序与文件中的面一致
+     */
+    struct ObjData {
+        std::vector<float> positions;
+        std::vector<float> texcoords;
+        std::vector<ObjCorner> corners;
+    };
+
+    /**
+     * @brief 多线程 OBJ 解析
+     * @details
+     * - 内存映射文件，按行边界切分为多个分块并行解析
+     * - 只读取 v、vt、f，忽略法线、分组和材质
+     * - 四边形沿较短的对角线切分，与 tinyobjloader 的三角化结果一致；更多边的面按扇形切分
+     * - 各分块按文件顺序合并，输出与分块数量无关
+     * @throw std::runtime_error 文件无法读取，或面引用了不存在的顶点
+     */
+    [[nodiscard]]
+    ObjData parse_obj(const std::string& path) {
+        const MappedFile file(path);
+        const char* const data = file.data();
+        const std::size_t size = file.size();
+
+        constexpr std::size_t MIN_CHUNK_BYTES = 256 * 1024;
+        const std::size_t chunk_count = std::clamp<std::size_t>(
+            std::min<std::size_t>(std::thread::hardware_concurrency(), size / MIN_CHUNK_BYTES), 1, 64
+        );
+        // 分块边界向后对齐到下一行的行首
+        std::vector<std::size_t> bounds(chunk_count + 1, size);
+        bounds[0] = 0;
+        for (std::size_t i = 1; i < chunk_count; ++i) {
+            std::size_t pos = std::max(bounds[i - 1], size / chunk_count * i);
+            while (pos < size && pos > 0 && data[pos - 1] != '\n') ++pos;
+            bounds[i] = pos;
+        }
+
+        std::vector<ObjChunk> chunks(chunk_count);
+        {
+            std::vector<std::jthread> workers;
+            std::vector<std::exception_ptr> errors(chunk_count);
+            workers.reserve(chunk_count);
+            for (std::size_t i = 0; i < chunk_count; ++i) {
+                workers.emplace_back([&, i] {
+                    try {
+                        parse_chunk(data + bounds[i], data + bounds[i + 1], chunks[i]);
+                    } catch (...) {
+                        errors[i] = std::current_exception();
+                    }
+                });
+            }
+            workers.clear();
+            for (const auto& error : errors) {
+                if (error) std::rethrow_exception(error);
+            }
+        }
+
+        // 前缀和得到每个分块的元素起点
+        std::vector<std::size_t> position_base(chunk_count + 1, 0);
+        std::vector<std::size_t> texcoord_base(chunk_count + 1, 0);
+        std::vector<std::size_t> triangle_base(chunk_count + 1, 0);
+        for (std::size_t i = 0; i < chunk_count; ++i) {
+            position_base[i + 1] = position_base[i] + chunks[i].positions.size() / 3;
+            texcoord_base[i + 1] = texcoord_base[i] + chunks[i].texcoords.size() / 2;
+            triangle_base[i + 1] = triangle_base[i] + chunks[i].triangle_count;
+        }
+
+        ObjData result;
+        result.positions.resize(position_base.back() * 3);
+        result.texcoords.resize(texcoord_base.back() * 2);
+        result.corners.resize(triangle_base.back() * 3);
+        // 四边形切分需要读取其他分块的位置，因此先完成复制
+        for (std::size_t i = 0; i < chunk_count; ++i) {
+            std::ranges::copy(chunks[i].positions, result.positions.begin() + position_base[i] * 3);
+            std::ranges::copy(chunks[i].texcoords, result.texcoords.begin() + texcoord_base[i] * 2);
+        }
+        {
+            std::vector<std::jthread> workers;
+            std::vector<std::exception_ptr> errors(chunk_count);
+            workers.reserve(chunk_count);
+            for (std::size_t i = 0; i < chunk_count; ++i) {
+                workers.emplace_back([&, i] {
+                    try {
+                        const auto& chunk = chunks[i];
+                        const auto position_count = static_cast<std::int64_t>(position_base.back());
+                        const auto texcoord_count = static_cast<std::int64_t>(texcoord_base.back());
+                        const auto resolve = [&](const RawCorner& raw) {
+                            std::int64_t position = raw.position;
+                            if (raw.position_relative) position += static_cast<std::int64_t>(position_base[i]);
+                            std::int64_t texcoord = -1;
+                            if (raw.texcoord != NO_INDEX) {
+                                texcoord = raw.texcoord;
+                                if (raw.texcoord_relative) texcoord += static_cast<std::int64_t>(texcoord_base[i]);
+                                if (texcoord < 0 || texcoord >= texcoord_count) {
+                                    throw std::runtime_error("OBJ texcoord index out of range!");
+                                }
+                            }
+                            if (position < 0 || position >= position_count) {
+                                throw std::runtime_error("OBJ vertex index out of range!");
+                            }
+                            return ObjCorner{ static_cast<std::int32_t>(position), static_cast<std::int32_t>(texcoord) };
+                        };
+                        const auto squared_distance = [&](const ObjCorner& a, const ObjCorner& b) {
+                            const float* pa = result.positions.data() + 3 * a.position;
+                            const float* pb = result.positions.data() + 3 * b.position;
+                            const float dx = pb[0] - pa[0];
+                            const float dy = pb[1] - pa[1];
+                            const float dz = pb[2] - pa[2];
+                            return dx * dx + dy * dy + dz * dz;
+                        };
+
+                        auto out = result.corners.begin() + static_cast<std::ptrdiff_t>(triangle_base[i] * 3);
+                        const auto emit = [&](const ObjCorner& a, const ObjCorner& b, const ObjCorner& c) {
+                            *out++ = a;
+                            *out++ = b;
+                            *out++ = c;
+                        };
+                        std::size_t first = 0;
+                        for (const std::uint32_t face_size : chunk.face_sizes) {
+                            const RawCorner* raw = chunk.corners.data() + first;
+                            first += face_size;
+                            if (face_size < 3) continue;
+                            if (face_size == 4) {
+                                const ObjCorner c0 = resolve(raw[0]), c1 = resolve(raw[1]);
+                                const ObjCorner c2 = resolve(raw[2]), c3 = resolve(raw[3]);
+                                if (squared_distance(c0, c2) < squared_distance(c1, c3)) {
+                                    emit(c0, c1, c2);
+                                    emit(c0, c2, c3);
+                                } else {
+                                    emit(c0, c1, c3);
+                                    emit(c1, c2, c3);
+                                }
+                                continue;
+                            }
+                            const ObjCorner c0 = resolve(raw[0]);
+                            for (std::uint32_t k = 1; k + 1 < face_size; ++k) {
+                                emit(c0, resolve(raw[k]), resolve(raw[k + 1]));
+                            }
+                        }
+                    } catch (...) {
+                        errors[i] = std::current_exception();
+                    }
+                });
+            }
+            workers.clear();
+            for (const auto& error : errors) {
+                if (error) std::rethrow_exception(error);
+            }
+        }
+        return result;
+    }
+
+}
@@ -0,0 +1,116 @@
+export module PipelineBuilder;
+
+import std;
+import vulkan_hpp;
+
+export namespace vht {
+
+    /**
+     * @brief 一条待创建的管线
+     * @details
+     * - name: 用于报告
+     * - build: 在工作线程中调用，通常向 PipelineRegistry 请求管线，返回的管线由注册表持有；
+     *   不同的状态或特化常量组合作为不同的描述提交
+     */
+    struct PipelineDescription {
+        std::string name;
+        std::function<vk::Pipeline()> build;
+    };
+
+    // 不等待地查询 future 是否已有结果
+    template<typename T>
+    [[nodiscard]]
+    bool is_ready(const std::future<T>& future) {
+        return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    /**
+     * @brief 并行管线构建
+     * @details
+     * - 工作：
+     *  - hardware_concurrency 个工作线程从任务队列中取出管线描述并创建管线
+     *  - submit() 立即返回 future，调用者可以阻塞等待 get()，也可以每帧用 is_ready() 查询
+     *  - 着色器编译或管线创建抛出的异常保存在 future 中，get() 时重新抛出
+     *  - 所有管线通过同一个 PipelineRegistry 创建，相同状态只创建一次；各工作线程同时使用 PipelineCache 中
+     *    唯一的 VkPipelineCache（由驱动在内部同步），并行创建的管线可以复用彼此写入缓存的结果
+     *  - 析构时停止工作线程，尚未开始的任务被丢弃，其 future 得到 std::future_error
+     * - 可访问成员：
+     *  - submit(): 提交一条或一批管线
+     *  - thread_count(): 工作线程数量
+     */
+    class PipelineBuilder {
+        std::mutex m_mutex;
+        std::condition_variable_any m_condition;
+        std::deque<std::packaged_task<vk::Pipeline()>> m_jobs;    // 由 m_mutex 保护
+        std::vector<std::jthread> m_workers;
+    public:
+        PipelineBuilder() {
+            init();
+        }
+        PipelineBuilder(const PipelineBuilder&) = delete;
+        PipelineBuilder& operator=(const PipelineBuilder&) = delete;
+
+        [[nodiscard]]
+        std::size_t thread_count() const { return m_workers.size(); }
+
+        // 提交一条管线
+        [[nodiscard]]
+        std::future<vk::Pipeline> submit(PipelineDescription description) {
+            std::future<vk::Pipeline> future;
+            {
+                const std::scoped_lock lock{ m_mutex };
+                future = push(std::move(description));
+            }
+            m_condition.notify_one();
+            return future;
+        }
+
+        // 提交一批管线，返回的 future 与 batch 一一对应
+        [[nodiscard]]
+        std::vector<std::future<vk::Pipeline>> submit(std::vector<PipelineDescription> batch) {
+            std::vector<std::future<vk::Pipeline>> futures;
+            futures.reserve(batch.size());
+            {
+                const std::scoped_lock lock{ m_mutex };
+                for (auto& description : batch) futures.push_back(push(std::move(description)));
+            }
+            m_condition.notify_all();
+            return futures;
+        }
+
+    private:
+        void init() {
+            const std::uint32_t thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+            for (std::uint32_t i = 0; i < thread_count; ++i) {
+                m_workers.emplace_back([this](const std::stop_token& stop) { run(stop); });
+            }
+        }
+        // 加入任务队列，调用者需持有 m_mutex
+        [[nodiscard]]
+        std::future<vk::Pipeline> push(PipelineDescription description) {
+            auto& job = m_jobs.emplace_back([description = std::move(description)] {
+                const auto start_time = std::chrono::steady_clock::now();
+                auto pipeline = description.build();
+                const auto end_time = std::chrono::steady_clock::now();
+                std::println("pipeline {} built, {:.2f} ms including shaders", description.name,
+                    std::chrono::duration<double, std::milli>(end_time - start_time).count());
+                return pipeline;
+            });
+            return job.get_future();
+        }
+        // 工作线程：依次执行任务队列中的管线创建
+        void run(const std::stop_token& stop) {
+            while (true) {
+                std::packaged_task<vk::Pipeline()> job;
+                {
+                    std::unique_lock lock{ m_mutex };
+                    if (!m_condition.wait(lock, stop, [this] { return !m_jobs.empty(); })) return;
+                    job = std::move(m_jobs.front());
+                    m_jobs.pop_front();
+                }
+                job();
+            }
+        }
+    };
+
+}
@@ -0,0 +1,209 @@
+export module PipelineCache;
+
+import std;
+import vulkan_hpp;
+
+import Config;
+import Device;
+import CacheFile;
+
+namespace vht {
+
+    constexpr std::array<char, 4> PIPELINE_CACHE_MAGIC{ 'V', 'H', 'T', 'P' };
+    constexpr std::uint32_t PIPELINE_CACHE_VERSION = 1;
+
+    /**
+     * @brief 管线缓存文件头
+     * @details 文件布局：文件头 | 驱动返回的缓存数据；data_hash 用于发现被截断或损坏的文件
+     */
+    struct PipelineCacheHeader {
+        std::array<char, 4> magic{ PIPELINE_CACHE_MAGIC };
+        std::uint32_t version{ PIPELINE_CACHE_VERSION };
+        std::uint64_t data_size{};
+        std::uint64_t data_hash{};
+    };
+    static_assert(std::is_trivially_copyable_v<PipelineCacheHeader>);
+
+    [[nodiscard]]
+    std::uint64_t hash_bytes(const std::span<const std::uint8_t> data) {
+        return vht::hash_string({ reinterpret_cast<const char*>(data.data()), data.size() });
+    }
+
+}
+
+export namespace vht {
+
+    /**
+     * @brief 持久化的管线缓存
+     * @details
+     * - 依赖：
+     *  - m_device: 物理/逻辑设备
+     * - 工作：
+     *  - 启动时读取 PIPELINE_CACHE_FILE，校验文件头、数据哈希以及驱动缓存头中的厂商 ID、设备 ID 与 pipelineCacheUUID，
+     *    任一项不符时丢弃，驱动或显卡更换后不会把不兼容的数据交给驱动
+     *  - 所有管线通过同一个以校验后的数据初始化的缓存对象创建，同一次运行中先创建的管线可以被之后的管线复用；
+     *    save() 读取该缓存写入文件，先写临时文件再重命名，中途退出不会留下损坏的缓存
+     *  - 缓存对象由驱动在内部同步，可以在多个线程中同时创建管线，只在记录统计时加锁
+     *  - 通过管线创建反馈报告每条管线是否命中缓存以及创建耗时，删除缓存文件或关闭 ENABLE_PIPELINE_CACHE
+     *    即可对比冷启动与热启动
+     * - 可访问成员：
+     *  - create_graphics_pipeline(): 创建图形管线
+     *  - create_compute_pipeline(): 创建计算管线
+     *  - save(): 写入缓存文件
+     *  - hit_count(): 命中缓存的管线数量
+     *  - pipeline_count(): 已创建的管线数量
+     *  - total_time(): 管线创建的总耗时，单位为毫秒
+     */
+    class PipelineCache {
+        std::shared_ptr<vht::Device> m_device{ nullptr };
+        vk::raii::PipelineCache m_cache{ nullptr };
+        mutable std::mutex m_mutex;
+        std::uint32_t m_pipeline_count{ 0 };                // 由 m_mutex 保护
+        std::uint32_t m_hit_count{ 0 };                     // 由 m_mutex 保护
+        double m_total_time{ 0.0 };                         // 由 m_mutex 保护
+    public:
+        explicit PipelineCache(std::shared_ptr<vht::Device> device)
+        :   m_device(std::move(device)) {
+            init();
+        }
+
+        [[nodiscard]]
+        std::uint32_t hit_count() const {
+            const std::scoped_lock lock{ m_mutex };
+            return m_hit_count;
+        }
+        [[nodiscard]]
+        std::size_t pipeline_count() const {
+            const std::scoped_lock lock{ m_mutex };
+            return m_pipeline_count;
+        }
+        [[nodiscard]]
+        double total_time() const {
+            const std::scoped_lock lock{ m_mutex };
+            return m_total_time;
+        }
+
+        // 创建图形管线，name 只用于报告
+        [[nodiscard]]
+        vk::raii::Pipeline create_graphics_pipeline(const std::string_view name, vk::GraphicsPipelineCreateInfo create_info) {
+            return create(name, create_info, [this](const vk::GraphicsPipelineCreateInfo& info) {
+                return m_device->device().createGraphicsPipeline( m_cache, info );
+            });
+        }
+
+        // 创建计算管线，name 只用于报告
+        [[nodiscard]]
+        vk::raii::Pipeline create_compute_pipeline(const std::string_view name, vk::ComputePipelineCreateInfo create_info) {
+            return create(name, create_info, [this](const vk::ComputePipelineCreateInfo& info) {
+                return m_device->device().createComputePipeline( m_cache, info );
+            });
+        }
+
+        /**
+         * @brief 把缓存写入文件
+         * @details 缓存以启动时读取的数据初始化，本次没有创建的管线（例如设备不支持的网格着色器管线）不会丢失；
+         * 写入失败只打印警告
+         */
+        void save() const {
+            if (!ENABLE_PIPELINE_CACHE || pipeline_count() == 0) return;
+            const auto data = m_cache.getData();
+            PipelineCacheHeader header;
+            header.data_size = data.size();
+            header.data_hash = hash_bytes(data);
+            const bool saved = vht::write_cache_file(PIPELINE_CACHE_FILE, [&](std::ofstream& file) {
+                file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+            });
+            if (saved) std::println("pipeline cache saved: {} bytes", data.size());
+        }
+
+    private:
+        void init() {
+            std::vector<std::uint8_t> initial_data;
+            if (ENABLE_PIPELINE_CACHE) initial_data = load();
+            vk::PipelineCacheCreateInfo create_info;
+            create_info.setInitialData<std::uint8_t>( initial_data );
+            m_cache = m_device->device().createPipelineCache( create_info );
+        }
+
+        // 读取并校验缓存文件，不可用时返回空数据
+        [[nodiscard]]
+        std::vector<std::uint8_t> load() const {
+            std::ifstream file(PIPELINE_CACHE_FILE, std::ios::binary | std::ios::ate);
+            if (!file) {
+                std::println("pipeline cache: no cache file, building pipelines from SPIR-V");
+                return {};
+            }
+            const auto file_size = static_cast<std::uint64_t>(file.tellg());
+            file.seekg(0);
+            PipelineCacheHeader header;
+            if (file_size < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+                std::println("pipeline cache rejected: truncated header");
+                return {};
+            }
+            if (header.magic != PIPELINE_CACHE_MAGIC || header.version != PIPELINE_CACHE_VERSION ||
+                header.data_size != file_size - sizeof(header)) {
+                std::println("pipeline cache rejected: unknown format");
+                return {};
+            }
+            std::vector<std::uint8_t> data(header.data_size);
+            if (!file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size())) ||
+                hash_bytes(data) != header.data_hash) {
+                std::println("pipeline cache rejected: corrupted data");
+                return {};
+            }
+            if (const auto reason = validate(data); !reason.empty()) {
+                std::println("pipeline cache rejected: {}", reason);
+                return {};
+            }
+            std::println("pipeline cache loaded: {} bytes", data.size());
+            return data;
+        }
+
+        // 校验驱动缓存头，返回不兼容的原因，兼容时返回空字符串
+        [[nodiscard]]
+        std::string validate(const std::span<const std::uint8_t> data) const {
+            vk::PipelineCacheHeaderVersionOne header;
+            if (data.size() < sizeof(header)) return "driver header is truncated";
+            std::memcpy(&header, data.data(), sizeof(header));
+            const auto properties = m_device->physical_device().getProperties();
+            if (header.headerSize < sizeof(header) || header.headerSize > data.size()) return "invalid driver header size";
+            if (header.headerVersion != vk::PipelineCacheHeaderVersion::eOne) return "unknown driver header version";
+            if (header.vendorID != properties.vendorID) return "vendor ID mismatch";
+            if (header.deviceID != properties.deviceID) return "device ID mismatch";
+            if (header.pipelineCacheUUID != properties.pipelineCacheUUID) return "pipeline cache UUID mismatch";
+            return {};
+        }
+
+        /**
+         * @brief 通过共享的缓存对象创建管线，并通过创建反馈报告命中情况
+         * @details 反馈结构链接在 create_info 已有的 pNext 之前
+         */
+        template<typename CreateInfo, typename Creator>
+        vk::raii::Pipeline create(const std::string_view name, CreateInfo create_info, const Creator& creator) {
+            vk::PipelineCreationFeedback feedback;
+            vk::PipelineCreationFeedbackCreateInfo feedback_info;
+            feedback_info.pPipelineCreationFeedback = &feedback;
+            feedback_info.pNext = create_info.pNext;
+            create_info.pNext = &feedback_info;
+
+            const auto start_time = std::chrono::steady_clock::now();
+            vk::raii::Pipeline pipeline = creator(create_info);
+            const auto end_time = std::chrono::steady_clock::now();
+            double time = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+            // 驱动提供的耗时不含调用开销，有效时优先使用
+            if (feedback.flags & vk::PipelineCreationFeedbackFlagBits::eValid) time = static_cast<double>(feedback.duration) / 1e6;
+
+            const bool hit = static_cast<bool>(feedback.flags & vk::PipelineCreationFeedbackFlagBits::eApplicationPipelineCacheHit);
+            {
+                const std::scoped_lock lock{ m_mutex };
+                ++m_pipeline_count;
+                if (hit) ++m_hit_count;
+                m_total_time += time;
+            }
+            std::println("pipeline {}: {}, {:.3f} ms", name, hit ? "cache hit" : "compiled", time);
+            return pipeline;
+        }
+    };
+
+}
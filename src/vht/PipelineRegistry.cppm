@@ -0,0 +1,361 @@
+export module PipelineRegistry;
+
+import std;
+import vulkan_hpp;
+
+import Config;
+import VertexFormat;
+import Device;
+import RenderPass;
+import PipelineCache;
+import ShaderManager;
+import CacheFile;
+
+export namespace vht {
+
+    /**
+     * @brief 图形管线的固定功能状态
+     * @details 视口与裁剪矩形总是动态状态，不在此列出；vertex_input 为 false 时不使用顶点输入与图元装配（网格着色器）
+     */
+    struct FixedFunctionState {
+        bool vertex_input{ true };                  // 按 DeviceVertex 读取顶点缓冲区
+        vk::PrimitiveTopology topology{ vk::PrimitiveTopology::eTriangleList };
+        vk::PolygonMode polygon_mode{ vk::PolygonMode::eFill };
+        vk::CullModeFlags cull_mode{ vk::CullModeFlagBits::eBack };
+        vk::FrontFace front_face{ vk::FrontFace::eCounterClockwise };
+        bool depth_test{ true };
+        bool depth_write{ true };
+        vk::CompareOp depth_compare{ vk::CompareOp::eLess };
+        bool blend{ false };                        // 开启时为预乘 alpha 混合
+        bool operator==(const FixedFunctionState&) const = default;
+    };
+
+    /**
+     * @brief 管线的一个着色器阶段
+     * @details specialization 有值时作为 constant_id 0 的特化常量
+     */
+    struct PipelineShader {
+        vk::ShaderStageFlagBits stage{};
+        std::string_view source;
+        std::optional<std::uint32_t> specialization;
+    };
+
+    /**
+     * @brief 请求一条图形管线所需的全部信息
+     * @details name 只用于报告，不参与去重；layout 由调用者持有，需比注册表存活更久
+     */
+    struct PipelineState {
+        std::string_view name;
+        std::vector<PipelineShader> shaders;
+        FixedFunctionState fixed;
+        vk::PipelineLayout layout;
+    };
+
+}
+
+namespace vht {
+
+    // 任务、网格、片段
+    constexpr std::size_t MAX_PIPELINE_SHADERS = 3;
+
+    struct ShaderKey {
+        vk::ShaderStageFlagBits stage{};
+        std::uint64_t code_hash{};
+        std::optional<std::uint32_t> specialization;
+        bool operator==(const ShaderKey&) const = default;
+    };
+
+    /**
+     * @brief 去重使用的键
+     * @details 着色器以 SPIR-V 的哈希表示，源码或包含的文件改变后得到新的键；
+     * 渲染通道以附件格式与采样数表示，兼容的渲染通道共用管线
+     */
+    struct PipelineKey {
+        std::array<ShaderKey, MAX_PIPELINE_SHADERS> shaders{};
+        std::uint32_t shader_count{};
+        FixedFunctionState fixed;
+        vk::PipelineLayout layout;
+        vk::Format color_format{};
+        vk::Format depth_format{};
+        vk::SampleCountFlagBits samples{};
+        bool operator==(const PipelineKey&) const = default;
+    };
+
+    /**
+     * @brief 注册表中的一条管线
+     * @details references 为 0 时从 unused_frame 开始计时，MAX_FRAMES_IN_FLIGHT 帧后销毁
+     */
+    struct PipelineEntry {
+        std::shared_future<vk::Pipeline> future;
+        vk::raii::Pipeline pipeline{ nullptr };     // 创建完成后设置
+        std::uint32_t references{};
+        std::uint64_t unused_frame{};
+    };
+
+    // 管线布局只参与比较，不参与哈希
+    struct PipelineKeyHash {
+        [[nodiscard]]
+        std::size_t operator()(const PipelineKey& key) const {
+            const auto& fixed = key.fixed;
+            std::string text = std::format("{}|{}|{}|{}|{}|{}|{}|{}|{}|{}|{}|{}|{}\n",
+                fixed.vertex_input, static_cast<int>(fixed.topology), static_cast<int>(fixed.polygon_mode),
+                static_cast<std::uint32_t>(fixed.cull_mode), static_cast<int>(fixed.front_face),
+                fixed.depth_test, fixed.depth_write, static_cast<int>(fixed.depth_compare), fixed.blend,
+                static_cast<int>(key.color_format), static_cast<int>(key.depth_format), static_cast<int>(key.samples),
+                key.shader_count);
+            for (std::uint32_t i = 0; i < key.shader_count; ++i) {
+                const auto& [stage, code_hash, specialization] = key.shaders[i];
+                text += std::format("{}|{:016x}|{}\n",
+                    static_cast<std::uint32_t>(stage), code_hash, specialization ? static_cast<std::int64_t>(*specialization) : -1);
+            }
+            return static_cast<std::size_t>(vht::hash_string(text));
+        }
+    };
+
+}
+
+export namespace vht {
+
+    /**
+     * @brief 图形管线注册表
+     * @details
+     * - 依赖：
+     *  - m_device: 逻辑设备
+     *  - m_render_pass: 渲染通道，提供附件格式
+     *  - m_pipeline_cache: 管线缓存
+     *  - m_shader_manager: 着色器编译
+     * - 工作：
+     *  - 按 PipelineState 填写 vk::GraphicsPipelineCreateInfo，新的材质或通道只需描述状态
+     *  - 以固定功能状态、各着色器 SPIR-V 的哈希、管线布局与附件格式为键去重，相同的请求返回同一条管线；
+     *    着色器从磁盘缓存读取后才计算键，命中时不创建着色器模块，也不调用驱动
+     *  - 可以在多个线程中同时请求；同一个键正在另一线程创建时等待其结果，不重复编译
+     *  - 持有创建的管线并按引用计数管理：每次 request() 增加一次引用，使用者不再需要时调用 release()；
+     *    没有引用的管线在 collect() 计数 MAX_FRAMES_IN_FLIGHT 帧后销毁，期间再次请求则继续使用，
+     *    热重载替换下来的管线等使用它的帧执行完毕后释放
+     *  - 创建失败时不记录该键，之后的请求会重试
+     * - 可访问成员：
+     *  - request(): 获取管线并增加引用
+     *  - release(): 减少引用
+     *  - collect(): 在帧边界销毁已不再使用的管线
+     *  - hit_count(): 命中次数
+     *  - miss_count(): 未命中而创建的次数
+     *  - pipeline_count(): 持有的管线数量
+     */
+    class PipelineRegistry {
+        std::shared_ptr<vht::Device> m_device{ nullptr };
+        std::shared_ptr<vht::RenderPass> m_render_pass{ nullptr };
+        std::shared_ptr<vht::PipelineCache> m_pipeline_cache{ nullptr };
+        std::shared_ptr<vht::ShaderManager> m_shader_manager{ nullptr };
+        mutable std::mutex m_mutex;
+        std::unordered_map<PipelineKey, PipelineEntry, PipelineKeyHash> m_entries;  // 由 m_mutex 保护
+        std::uint64_t m_frame{ 0 };                     // 由 m_mutex 保护
+        std::uint32_t m_hit_count{ 0 };                 // 由 m_mutex 保护
+        std::uint32_t m_miss_count{ 0 };                // 由 m_mutex 保护
+    public:
+        explicit PipelineRegistry(
+            std::shared_ptr<vht::Device> device,
+            std::shared_ptr<vht::RenderPass> render_pass,
+            std::shared_ptr<vht::PipelineCache> pipeline_cache,
+            std::shared_ptr<vht::ShaderManager> shader_manager
+        ):  m_device(std::move(device)),
+            m_render_pass(std::move(render_pass)),
+            m_pipeline_cache(std::move(pipeline_cache)),
+            m_shader_manager(std::move(shader_manager)) {}
+        PipelineRegistry(const PipelineRegistry&) = delete;
+        PipelineRegistry& operator=(const PipelineRegistry&) = delete;
+
+        [[nodiscard]]
+        std::uint32_t hit_count() const {
+            const std::scoped_lock lock{ m_mutex };
+            return m_hit_count;
+        }
+        [[nodiscard]]
+        std::uint32_t miss_count() const {
+            const std::scoped_lock lock{ m_mutex };
+            return m_miss_count;
+        }
+        [[nodiscard]]
+        std::size_t pipeline_count() const {
+            const std::scoped_lock lock{ m_mutex };
+            return static_cast<std::size_t>(std::ranges::count_if(m_entries, [](const auto& entry) {
+                return static_cast<bool>(*entry.second.pipeline);
+            }));
+        }
+
+        /**
+         * @brief 获取符合 state 的管线，已有相同的管线时直接返回
+         * @return 由注册表持有的管线，不再使用时需调用 release()
+         * @throw std::runtime_error 着色器编译失败或阶段数量超出限制
+         */
+        [[nodiscard]]
+        vk::Pipeline request(const PipelineState& state) {
+            if (state.shaders.size() > MAX_PIPELINE_SHADERS) {
+                throw std::runtime_error(std::format("pipeline {} has too many shader stages", state.name));
+            }
+            std::vector<std::vector<std::uint32_t>> codes;
+            PipelineKey key;
+            key.shader_count = static_cast<std::uint32_t>(state.shaders.size());
+            for (std::size_t i = 0; i < state.shaders.size(); ++i) {
+                const auto& [stage, source, specialization] = state.shaders[i];
+                auto& code = codes.emplace_back(m_shader_manager->compile(source));
+                key.shaders[i] = { stage, vht::hash_string({ reinterpret_cast<const char*>(code.data()), code.size() * sizeof(std::uint32_t) }), specialization };
+            }
+            key.fixed = state.fixed;
+            key.layout = state.layout;
+            key.color_format = m_render_pass->color_format();
+            key.depth_format = m_render_pass->depth_format();
+            key.samples = m_render_pass->samples();
+
+            std::promise<vk::Pipeline> promise;
+            std::shared_future<vk::Pipeline> future;
+            {
+                const std::scoped_lock lock{ m_mutex };
+                if (const auto it = m_entries.find(key); it != m_entries.end()) {
+                    ++m_hit_count;
+                    ++it->second.references;
+                    future = it->second.future;
+                } else {
+                    ++m_miss_count;
+                    m_entries.emplace(key, PipelineEntry{ promise.get_future().share(), vk::raii::Pipeline{ nullptr }, 1 });
+                }
+            }
+            // 命中时可能等待另一线程创建完成，创建失败时重新抛出其异常
+            if (future.valid()) return future.get();
+
+            try {
+                auto pipeline = create(state, codes);
+                const vk::Pipeline handle = pipeline;
+                {
+                    const std::scoped_lock lock{ m_mutex };
+                    m_entries.at(key).pipeline = std::move(pipeline);
+                }
+                promise.set_value(handle);
+                return handle;
+            } catch (...) {
+                {
+                    const std::scoped_lock lock{ m_mutex };
+                    m_entries.erase(key);
+                }
+                promise.set_exception(std::current_exception());
+                throw;
+            }
+        }
+
+        // 减少 request() 增加的引用，pipeline 为空时不做任何事
+        void release(const vk::Pipeline pipeline) {
+            if (!pipeline) return;
+            const std::scoped_lock lock{ m_mutex };
+            const auto it = std::ranges::find_if(m_entries, [&](const auto& entry) {
+                return *entry.second.pipeline == pipeline;
+            });
+            if (it == m_entries.end() || it->second.references == 0) return;
+            if (--it->second.references == 0) it->second.unused_frame = m_frame;
+        }
+
+        // 销毁没有引用且已超过 MAX_FRAMES_IN_FLIGHT 帧的管线，只能在主线程等待当前帧的栅栏之后调用
+        void collect() {
+            const std::scoped_lock lock{ m_mutex };
+            ++m_frame;
+            const auto erased = std::erase_if(m_entries, [this](const auto& entry) {
+                const auto& [key, value] = entry;
+                return static_cast<bool>(*value.pipeline) && value.references == 0 &&
+                    m_frame >= value.unused_frame + MAX_FRAMES_IN_FLIGHT;
+            });
+            if (erased > 0) std::println("pipeline registry: {} unused pipelines destroyed", erased);
+        }
+
+    private:
+        // 创建着色器模块并按 state 填写创建信息
+        [[nodiscard]]
+        vk::raii::Pipeline create(const PipelineState& state, const std::span<const std::vector<std::uint32_t>> codes) const {
+            std::vector<vk::raii::ShaderModule> modules;
+            modules.reserve(codes.size());
+            for (const auto& code : codes) {
+                vk::ShaderModuleCreateInfo module_info;
+                module_info.setCode( code );
+                modules.emplace_back( m_device->device().createShaderModule( module_info ) );
+            }
+
+            const vk::SpecializationMapEntry map_entry{ 0, 0, sizeof(std::uint32_t) };
+            std::array<vk::SpecializationInfo, MAX_PIPELINE_SHADERS> specialization_infos;
+            std::vector<vk::PipelineShaderStageCreateInfo> shader_stages(state.shaders.size());
+            for (std::size_t i = 0; i < state.shaders.size(); ++i) {
+                const auto& shader = state.shaders[i];
+                shader_stages[i].stage = shader.stage;
+                shader_stages[i].module = modules[i];
+                shader_stages[i].pName = "main";
+                if (shader.specialization) {
+                    specialization_infos[i].setMapEntries( map_entry );
+                    specialization_infos[i].dataSize = sizeof(std::uint32_t);
+                    specialization_infos[i].pData = &*shader.specialization;
+                    shader_stages[i].pSpecializationInfo = &specialization_infos[i];
+                }
+            }
+
+            const auto& fixed = state.fixed;
+            const auto dynamic_states = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+            vk::PipelineDynamicStateCreateInfo dynamic_state;
+            dynamic_state.setDynamicStates(dynamic_states);
+
+            const auto binding_description = vht::DeviceVertex::get_binding_description();
+            const auto attribute_description = vht::DeviceVertex::get_attribute_description();
+            vk::PipelineVertexInputStateCreateInfo vertex_input;
+            vertex_input.setVertexBindingDescriptions(binding_description);
+            vertex_input.setVertexAttributeDescriptions(attribute_description);
+
+            vk::PipelineInputAssemblyStateCreateInfo input_assembly;
+            input_assembly.topology = fixed.topology;
+
+            vk::PipelineViewportStateCreateInfo viewport_state;
+            viewport_state.viewportCount = 1;
+            viewport_state.scissorCount = 1;
+
+            vk::PipelineDepthStencilStateCreateInfo depth_stencil;
+            depth_stencil.depthTestEnable = fixed.depth_test;
+            depth_stencil.depthWriteEnable = fixed.depth_write;
+            depth_stencil.depthCompareOp = fixed.depth_compare;
+
+            vk::PipelineRasterizationStateCreateInfo rasterizer;
+            rasterizer.polygonMode = fixed.polygon_mode;
+            rasterizer.lineWidth = 1.0f;
+            rasterizer.cullMode = fixed.cull_mode;
+            rasterizer.frontFace = fixed.front_face;
+
+            vk::PipelineMultisampleStateCreateInfo multisampling;
+            multisampling.rasterizationSamples = m_render_pass->samples();
+
+            vk::PipelineColorBlendAttachmentState color_blend_attachment;
+            color_blend_attachment.blendEnable = fixed.blend;
+            color_blend_attachment.srcColorBlendFactor = vk::BlendFactor::eOne;
+            color_blend_attachment.dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+            color_blend_attachment.colorBlendOp = vk::BlendOp::eAdd;
+            color_blend_attachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;
+            color_blend_attachment.dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+            color_blend_attachment.alphaBlendOp = vk::BlendOp::eAdd;
+            color_blend_attachment.colorWriteMask = vk::FlagTraits<vk::ColorComponentFlagBits>::allFlags;
+
+            vk::PipelineColorBlendStateCreateInfo color_blend;
+            color_blend.logicOpEnable = false;
+            color_blend.setAttachments( color_blend_attachment );
+
+            vk::GraphicsPipelineCreateInfo create_info;
+            create_info.layout = state.layout;
+            create_info.setStages( shader_stages );
+            if (fixed.vertex_input) {
+                create_info.pVertexInputState = &vertex_input;
+                create_info.pInputAssemblyState = &input_assembly;
+            }
+            create_info.pDynamicState = &dynamic_state;
+            create_info.pViewportState = &viewport_state;
+            create_info.pDepthStencilState = &depth_stencil;
+            create_info.pRasterizationState = &rasterizer;
+            create_info.pMultisampleState = &multisampling;
+            create_info.pColorBlendState = &color_blend;
+            create_info.renderPass = m_render_pass->render_pass();
+            create_info.subpass = 0;
+
+            return m_pipeline_cache->create_graphics_pipeline( state.name, create_info );
+        }
+    };
+
+}
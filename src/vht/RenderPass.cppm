@@ -26,6 +26,7 @@ export namespace vht {
      * - 可访问成员：
      *  - render_pass(): 渲染通道
      *  - framebuffers(): 帧缓冲区列表
+     *  - color_format()/depth_format()/samples(): 附件格式与采样数，决定管线与渲染通道是否兼容
      */
     class RenderPass {
         std::shared_ptr<vht::Window> m_window{ nullptr };
@@ -61,7 +62,7 @@ export namespace vht {
                 glfw::get_framebuffer_size(m_window->ptr(), &width, &height);
                 glfw::wait_events();
             }
-            m_device->device().waitIdle();
+            m_device->wait_idle();
 
             m_framebuffers.clear();
             m_swapchain->recreate();
@@ -75,6 +76,12 @@ export namespace vht {
         const vk::raii::RenderPass& render_pass() const { return m_render_pass; }
         [[nodiscard]]
         const std::vector<vk::raii::Framebuffer>& framebuffers() const { return m_framebuffers; }
+        [[nodiscard]]
+        vk::Format color_format() const { return m_swapchain->format(); }
+        [[nodiscard]]
+        vk::Format depth_format() const { return m_depth_image->format(); }
+        [[nodiscard]]
+        static vk::SampleCountFlagBits samples() { return vk::SampleCountFlagBits::e1; }
 
     private:
         void init() {
@@ -84,8 +91,8 @@ export namespace vht {
         // 创建渲染通道
         void create_render_pass() {
             vk::AttachmentDescription2 color_attachment;
-            color_attachment.format = m_swapchain->format();
-            color_attachment.samples = vk::SampleCountFlagBits::e1;
+            color_attachment.format = color_format();
+            color_attachment.samples = samples();
             color_attachment.loadOp = vk::AttachmentLoadOp::eClear;
             color_attachment.storeOp = vk::AttachmentStoreOp::eStore;
             color_attachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
@@ -98,8 +105,8 @@ export namespace vht {
             color_attachment_ref.layout = vk::ImageLayout::eAttachmentOptimal;
 
             vk::AttachmentDescription2 depth_attachment;
-            depth_attachment.format = m_depth_image->format();
-            depth_attachment.samples = vk::SampleCountFlagBits::e1;
+            depth_attachment.format = depth_format();
+            depth_attachment.samples = samples();
             depth_attachment.loadOp = vk::AttachmentLoadOp::eClear;
             depth_attachment.storeOp = vk::AttachmentStoreOp::eDontCare;
             depth_attachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
@@ -0,0 +1,99 @@
+export module SceneLoader;
+
+import std;
+import glm;
+
+import AssetLoader;
+import TextureLoader;
+import TextureTable;
+
+export namespace vht {
+
+    /**
+     * @brief 场景中的一个模型
+     * @details
+     * - path: 模型路径
+     * - transform: 模型空间到世界空间的变换
+     * - texture: 纹理路径，为空时使用默认纹理
+     */
+    struct SceneModel {
+        std::string path;
+        glm::mat4 transform{ 1.0f };
+        std::string texture;
+    };
+
+}
+
+namespace vht {
+
+    // 场景中的模型及其摆放，世界空间 Y 轴向上
+    const std::vector<vht::SceneModel> SCENE_MODELS = {
+        // viking_room 的模型空间为 Z 轴向上
+        { "models/viking_room.obj",
+          glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f)) *
+          glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f)), {} },
+        { "models/bunny.obj",
+          glm::translate(glm::mat4(1.0f), glm::vec3(1.2f, -0.25f, 0.6f)) *
+          glm::scale(glm::mat4(1.0f), glm::vec3(3.0f)), {} },
+        { "models/crate.obj",
+          glm::translate(glm::mat4(1.0f), glm::vec3(-0.9f, 0.05f, 1.0f)) *
+          glm::scale(glm::mat4(1.0f), glm::vec3(0.15f)), "textures/crate.jpg" },
+        // Marry.mtl 中的 map_Kd 纹理放在 textures/ 中
+        { "models/Marry/Marry.obj",
+          glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, -0.1f, -1.0f)) *
+          glm::scale(glm::mat4(1.0f), glm::vec3(0.25f)), "textures/MC003_Kozakura_Mari.png" },
+        { "models/floor/floor.obj",
+          glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.11f, 0.0f)) *
+          glm::scale(glm::mat4(1.0f), glm::vec3(0.1f)), {} }
+    };
+
+}
+
+export namespace vht {
+
+    /**
+     * @brief 场景加载器
+     * @details
+     * - 依赖：
+     *  - m_asset_loader: 后台模型加载
+     *  - m_texture_loader: 多线程纹理加载
+     * - 工作：
+     *  - 并行加载场景用到的所有纹理，记录上传命令后返回，由调用者统一提交
+     *  - 按 SCENE_MODELS 请求加载场景中的模型并指定纹理槽位，不等待加载完成
+     */
+    class SceneLoader {
+        std::shared_ptr<vht::AssetLoader> m_asset_loader{ nullptr };
+        std::shared_ptr<vht::TextureLoader> m_texture_loader{ nullptr };
+    public:
+        explicit SceneLoader(
+            std::shared_ptr<vht::AssetLoader> asset_loader,
+            std::shared_ptr<vht::TextureLoader> texture_loader
+        ):  m_asset_loader(std::move(asset_loader)),
+            m_texture_loader(std::move(texture_loader)) {
+            load_scene();
+        }
+
+    private:
+        void load_scene() {
+            // 去重后一次加载，多个模型可以共用一个纹理
+            std::vector<std::filesystem::path> texture_paths;
+            for (const auto& model : SCENE_MODELS) {
+                if (!model.texture.empty() && !std::ranges::contains(texture_paths, std::filesystem::path{ model.texture })) {
+                    texture_paths.emplace_back(model.texture);
+                }
+            }
+            const auto slots = m_texture_loader->load(texture_paths);
+
+            // 纹理加载失败时使用默认纹理
+            for (const auto& [path, transform, texture] : SCENE_MODELS) {
+                TextureSlot slot{};
+                if (!texture.empty()) {
+                    const auto index = std::ranges::find(texture_paths, std::filesystem::path{ texture }) - texture_paths.begin();
+                    slot = slots[static_cast<std::size_t>(index)].value_or(TextureSlot{});
+                }
+                m_asset_loader->request(path, transform, slot);
+            }
+        }
+    };
+
+}
@@ -0,0 +1,286 @@
+export module ShaderManager;
+
+import std;
+import shaderc;
+import vulkan_hpp;
+
+import Config;
+import Device;
+import CacheFile;
+
+export namespace vht {
+
+    /**
+     * @brief 编译着色器时的预处理宏
+     * @details 相当于 #define name value，value 为空时只定义宏
+     */
+    struct ShaderDefine {
+        std::string name;
+        std::string value;
+    };
+
+}
+
+namespace vht {
+
+    constexpr std::array<char, 4> SHADER_MAGIC{ 'V', 'H', 'T', 'S' };
+    constexpr std::uint32_t SHADER_VERSION = 1;
+    // 编译选项，都包含在缓存键中，见 ShaderManager::cache_key()
+    constexpr shaderc::optimization_level SHADER_OPTIMIZATION = shaderc::optimization_level::shaderc_optimization_level_performance;
+    // 网格着色器需要 SPIR-V 1.4 及以上，所有着色器统一以 Vulkan 1.3 为目标
+    constexpr shaderc::env_version SHADER_TARGET_ENV = shaderc::env_version::shaderc_env_version_vulkan_1_3;
+
+    /**
+     * @brief SPIR-V 缓存文件头
+     * @details
+     * 文件布局：文件头 | 依赖 × dependency_count | SPIR-V；
+     * 每个依赖为 内容哈希(8 字节) | 路径长度(4 字节) | 路径，记录编译时 #include 的文件，任一文件内容变化时缓存失效
+     */
+    struct ShaderHeader {
+        std::array<char, 4> magic{ SHADER_MAGIC };
+        std::uint32_t version{ SHADER_VERSION };
+        std::uint64_t key{};                // 源码、宏与编译选项的哈希
+        std::uint64_t code_hash{};          // SPIR-V 的哈希
+        std::uint32_t dependency_count{};
+        std::uint32_t code_size{};          // SPIR-V 的字数
+    };
+    static_assert(std::is_trivially_copyable_v<ShaderHeader>);
+
+    // 所有着色器都定义的宏，着色器中的数组大小由此与 C++ 端保持一致
+    [[nodiscard]]
+    std::vector<ShaderDefine> common_defines() {
+        return {
+            { "BINDLESS_SAMPLER_CAPACITY", std::to_string(BINDLESS_SAMPLER_CAPACITY) }
+        };
+    }
+
+    struct ShaderDependency {
+        std::string path;
+        std::uint64_t hash{};
+    };
+
+    [[nodiscard]]
+    std::optional<std::string> read_text(const std::filesystem::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return std::nullopt;
+        return std::string{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    }
+
+    [[nodiscard]]
+    std::uint64_t hash_code(const std::span<const std::uint32_t> code) {
+        return vht::hash_string({ reinterpret_cast<const char*>(code.data()), code.size_bytes() });
+    }
+
+    /**
+     * @brief 从文件系统解析 #include
+     * @details "" 相对包含文件所在目录查找，<> 在 shaders 目录下查找；读取的文件记录到 dependencies
+     */
+    class ShaderIncluder final : public shaderc::CompileOptions::IncluderInterface {
+        struct Include {
+            std::string name;
+            std::string content;
+            shaderc::include_result result{};
+        };
+        std::vector<ShaderDependency>& m_dependencies;
+    public:
+        explicit ShaderIncluder(std::vector<ShaderDependency>& dependencies)
+        :   m_dependencies(dependencies) {}
+
+        shaderc::include_result* GetInclude(
+            const char* requested_source,
+            const shaderc::include_type type,
+            const char* requesting_source,
+            std::size_t
+        ) override {
+            const std::filesystem::path directory = type == shaderc::include_type::shaderc_include_type_relative
+                ? std::filesystem::path(requesting_source).parent_path()
+                : std::filesystem::path("shaders");
+            const auto path = (directory / requested_source).lexically_normal();
+
+            auto include = std::make_unique<Include>();
+            if (auto content = read_text(path)) {
+                include->name = path.generic_string();
+                include->content = std::move(*content);
+                m_dependencies.emplace_back(include->name, vht::hash_string(include->content));
+            } else {
+                // 名称为空表示失败，content 为错误信息
+                include->content = std::format("cannot open include file {}", path.generic_string());
+            }
+            include->result.source_name = include->name.data();
+            include->result.source_name_length = include->name.size();
+            include->result.content = include->content.data();
+            include->result.content_length = include->content.size();
+            include->result.user_data = include.get();
+            return &include.release()->result;
+        }
+
+        void ReleaseInclude(shaderc::include_result* data) override {
+            delete static_cast<Include*>(data->user_data);
+        }
+    };
+
+}
+
+export namespace vht {
+
+    /**
+     * @brief 运行时着色器编译
+     * @details
+     * - 依赖：
+     *  - m_device: 逻辑设备
+     * - 工作：
+     *  - 用 shaderc 把 GLSL 源码编译为 SPIR-V，着色器阶段由文件名中的 .vert/.frag/.task/.mesh/.comp 决定；
+     *    除调用者给出的宏外，总是定义 common_defines() 中来自 Config 的宏
+     *  - SPIR-V 缓存在 cache/shaders 下，文件名包含源码、宏与编译选项的哈希；
+     *    缓存同时记录编译时包含的文件及其内容哈希，全部一致时直接读取缓存，不调用编译器
+     *  - 编译失败时抛出异常，错误信息包含 shaderc 的输出
+     * - 可访问成员：
+     *  - compile(): 获取 SPIR-V
+     *  - create_module(): 获取 SPIR-V 并创建着色器模块
+     *  - cache_hits(): 从缓存读取的次数
+     *  - compile_count(): 调用编译器的次数
+     */
+    class ShaderManager {
+        std::shared_ptr<vht::Device> m_device{ nullptr };
+        shaderc::Compiler m_compiler;
+        std::atomic<std::uint32_t> m_cache_hits{ 0 };
+        std::atomic<std::uint32_t> m_compile_count{ 0 };
+    public:
+        explicit ShaderManager(std::shared_ptr<vht::Device> device)
+        :   m_device(std::move(device)) {}
+
+        [[nodiscard]]
+        std::uint32_t cache_hits() const { return m_cache_hits; }
+        [[nodiscard]]
+        std::uint32_t compile_count() const { return m_compile_count; }
+
+        /**
+         * @brief 获取着色器的 SPIR-V，缓存有效时不编译
+         * @throw std::runtime_error 源文件无法读取或编译失败
+         */
+        [[nodiscard]]
+        std::vector<std::uint32_t> compile(const std::filesystem::path& source, const std::span<const ShaderDefine> extra_defines = {}) {
+            auto defines = common_defines();
+            defines.insert(defines.end(), extra_defines.begin(), extra_defines.end());
+            const auto text = read_text(source);
+            if (!text) throw std::runtime_error(std::format("failed to open shader {}", source.generic_string()));
+            const auto kind = stage_kind(source);
+            const std::uint64_t key = cache_key(*text, kind, defines);
+            const auto path = std::filesystem::path("cache") / "shaders" /
+                std::format("{}-{:016x}.spv", source.filename().string(), key);
+
+            if (auto code = load(path, key)) {
+                ++m_cache_hits;
+                return std::move(*code);
+            }
+
+            std::vector<ShaderDependency> dependencies;
+            shaderc::CompileOptions options;
+            options.SetSourceLanguage( shaderc::source_language::shaderc_source_language_glsl );
+            options.SetTargetEnvironment( shaderc::target_env::shaderc_target_env_vulkan, SHADER_TARGET_ENV );
+            options.SetOptimizationLevel( SHADER_OPTIMIZATION );
+            options.SetIncluder( std::make_unique<ShaderIncluder>(dependencies) );
+            for (const auto& [name, value] : defines) options.AddMacroDefinition( name, value );
+
+            const auto start_time = std::chrono::steady_clock::now();
+            const auto result = m_compiler.CompileGlslToSpv( *text, kind, source.generic_string().c_str(), options );
+            if (result.GetCompilationStatus() != shaderc::compilation_status::shaderc_compilation_status_success) {
+                throw std::runtime_error(std::format("failed to compile shader {}:\n{}", source.generic_string(), result.GetErrorMessage()));
+            }
+            std::vector<std::uint32_t> code(result.cbegin(), result.cend());
+            const auto end_time = std::chrono::steady_clock::now();
+            ++m_compile_count;
+            std::println("shader compiled: {}, {:.2f} ms", source.generic_string(),
+                std::chrono::duration<double, std::milli>(end_time - start_time).count());
+
+            store(path, key, dependencies, code);
+            return code;
+        }
+
+        /**
+         * @brief 获取 SPIR-V 并创建着色器模块
+         * @throw std::runtime_error 源文件无法读取或编译失败
+         */
+        [[nodiscard]]
+        vk::raii::ShaderModule create_module(const std::filesystem::path& source, const std::span<const ShaderDefine> defines = {}) {
+            const auto code = compile(source, defines);
+            vk::ShaderModuleCreateInfo create_info;
+            create_info.setCode( code );
+            return m_device->device().createShaderModule( create_info );
+        }
+
+    private:
+        // 由文件名 <名称>.<阶段>.glsl 确定着色器阶段
+        [[nodiscard]]
+        static shaderc::shader_kind stage_kind(const std::filesystem::path& source) {
+            const auto stage = source.stem().extension().string();
+            if (stage == ".vert") return shaderc::shader_kind::shaderc_glsl_vertex_shader;
+            if (stage == ".frag") return shaderc::shader_kind::shaderc_glsl_fragment_shader;
+            if (stage == ".comp") return shaderc::shader_kind::shaderc_glsl_compute_shader;
+            if (stage == ".task") return shaderc::shader_kind::shaderc_glsl_task_shader;
+            if (stage == ".mesh") return shaderc::shader_kind::shaderc_glsl_mesh_shader;
+            throw std::runtime_error(std::format("unknown shader stage: {}", source.generic_string()));
+        }
+
+        // 源码、阶段、宏与编译选项的哈希；包含的文件在读取缓存时单独校验
+        [[nodiscard]]
+        static std::uint64_t cache_key(const std::string_view text, const shaderc::shader_kind kind, const std::span<const ShaderDefine> defines) {
+            std::string key = std::format("{}|{}|{}|{}\n",
+                SHADER_VERSION, static_cast<int>(kind), static_cast<int>(SHADER_OPTIMIZATION), static_cast<int>(SHADER_TARGET_ENV));
+            for (const auto& [name, value] : defines) key += std::format("-D{}={}\n", name, value);
+            key += text;
+            return vht::hash_string(key);
+        }
+
+        // 读取缓存，键、依赖或数据不一致时返回 std::nullopt
+        [[nodiscard]]
+        static std::optional<std::vector<std::uint32_t>> load(const std::filesystem::path& path, const std::uint64_t key) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) return std::nullopt;
+            ShaderHeader header;
+            if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return std::nullopt;
+            if (header.magic != SHADER_MAGIC || header.version != SHADER_VERSION || header.key != key) return std::nullopt;
+
+            for (std::uint32_t i = 0; i < header.dependency_count; ++i) {
+                std::uint64_t hash{};
+                std::uint32_t length{};
+                if (!file.read(reinterpret_cast<char*>(&hash), sizeof(hash)) ||
+                    !file.read(reinterpret_cast<char*>(&length), sizeof(length))) return std::nullopt;
+                std::string dependency(length, '\0');
+                if (!file.read(dependency.data(), length)) return std::nullopt;
+                const auto content = read_text(dependency);
+                if (!content || vht::hash_string(*content) != hash) return std::nullopt;
+            }
+
+            std::vector<std::uint32_t> code(header.code_size);
+            if (!file.read(reinterpret_cast<char*>(code.data()), static_cast<std::streamsize>(code.size() * sizeof(std::uint32_t))) ||
+                code.empty() || hash_code(code) != header.code_hash) return std::nullopt;
+            return code;
+        }
+
+        // 写入缓存，失败只打印警告
+        static void store(
+            const std::filesystem::path& path,
+            const std::uint64_t key,
+            const std::span<const ShaderDependency> dependencies,
+            const std::span<const std::uint32_t> code
+        ) {
+            ShaderHeader header;
+            header.key = key;
+            header.code_hash = hash_code(code);
+            header.dependency_count = static_cast<std::uint32_t>(dependencies.size());
+            header.code_size = static_cast<std::uint32_t>(code.size());
+            vht::write_cache_file(path, [&](std::ofstream& file) {
+                file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                for (const auto& [dependency, hash] : dependencies) {
+                    const auto length = static_cast<std::uint32_t>(dependency.size());
+                    file.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+                    file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+                    file.write(dependency.data(), length);
+                }
+                file.write(reinterpret_cast<const char*>(code.data()), static_cast<std::streamsize>(code.size_bytes()));
+            });
+        }
+    };
+
+}
@@ -0,0 +1,144 @@
+export module ShaderReloader;
+
+import std;
+import vulkan_hpp;
+
+import Config;
+import GraphicsPipeline;
+import MeshPipeline;
+import ShaderWatcher;
+import PipelineBuilder;
+import PipelineRegistry;
+
+namespace vht {
+
+    enum class ReloadTarget { eGraphics, eMesh };
+
+    // 已提交给 PipelineBuilder、等待替换的管线
+    struct ReloadedPipeline {
+        ReloadTarget target{};
+        std::future<vk::Pipeline> pipeline;
+    };
+
+    // 文件是否是 sources 中的某个着色器
+    [[nodiscard]]
+    bool is_source_of(const std::filesystem::path& path, const std::span<const std::string_view> sources) {
+        return std::ranges::any_of(sources, [&](const std::string_view source) {
+            return std::filesystem::path(source).filename() == path.filename();
+        });
+    }
+
+}
+
+export namespace vht {
+
+    /**
+     * @brief 着色器热重载
+     * @details
+     * - 依赖：
+     *  - m_graphics_pipeline: 顶点着色器管线
+     *  - m_mesh_pipeline: 网格着色器管线
+     *  - m_pipeline_builder: 并行管线构建
+     *  - m_pipeline_registry: 管线注册表，销毁被替换的管线
+     * - 工作：
+     *  - ENABLE_SHADER_HOT_RELOAD 开启时，后台线程监视 shaders 目录，.glsl 文件被保存后把使用它的管线提交给
+     *    m_pipeline_builder 重新编译并创建；不是任何管线直接使用的文件视为被包含的文件，重建所有管线
+     *  - 编译或创建失败时打印错误并保留原来的管线
+     *  - poll() 由主线程在等待当前帧的栅栏之后、记录命令之前调用，只查询不等待，替换已创建完成的管线；
+     *    被替换的管线在 MAX_FRAMES_IN_FLIGHT 帧后由 m_pipeline_registry 销毁，渲染循环从不等待编译
+     *  - 管线布局不随着色器重建，修改描述符或推送常量的布局仍需重启
+     */
+    class ShaderReloader {
+        std::shared_ptr<vht::GraphicsPipeline> m_graphics_pipeline{ nullptr };
+        std::shared_ptr<vht::MeshPipeline> m_mesh_pipeline{ nullptr };
+        std::shared_ptr<vht::PipelineBuilder> m_pipeline_builder{ nullptr };
+        std::shared_ptr<vht::PipelineRegistry> m_pipeline_registry{ nullptr };
+        std::mutex m_mutex;
+        std::vector<ReloadedPipeline> m_reloaded;   // 由 m_mutex 保护
+        std::jthread m_worker;
+    public:
+        explicit ShaderReloader(
+            std::shared_ptr<vht::GraphicsPipeline> graphics_pipeline,
+            std::shared_ptr<vht::MeshPipeline> mesh_pipeline,
+            std::shared_ptr<vht::PipelineBuilder> pipeline_builder,
+            std::shared_ptr<vht::PipelineRegistry> pipeline_registry
+        ):  m_graphics_pipeline(std::move(graphics_pipeline)),
+            m_mesh_pipeline(std::move(mesh_pipeline)),
+            m_pipeline_builder(std::move(pipeline_builder)),
+            m_pipeline_registry(std::move(pipeline_registry)) {
+            init();
+        }
+        ShaderReloader(const ShaderReloader&) = delete;
+        ShaderReloader& operator=(const ShaderReloader&) = delete;
+
+        // 替换已重建的管线并销毁不再使用的旧管线，只能在主线程的帧边界调用
+        void poll() {
+            m_pipeline_registry->collect();
+            std::vector<ReloadedPipeline> reloaded;
+            {
+                // 按提交顺序替换，同一管线被多次重建时最后提交的生效
+                const std::scoped_lock lock{ m_mutex };
+                const auto ready_end = std::ranges::find_if_not(m_reloaded, [](const auto& pending) { return is_ready(pending.pipeline); });
+                std::ranges::move(m_reloaded.begin(), ready_end, std::back_inserter(reloaded));
+                m_reloaded.erase(m_reloaded.begin(), ready_end);
+            }
+            for (auto& [target, future] : reloaded) {
+                vk::Pipeline pipeline;
+                try {
+                    pipeline = future.get();
+                } catch (const std::exception& e) {
+                    std::println("shader reload failed, keeping the previous pipeline:\n{}", e.what());
+                    continue;
+                }
+                if (target == ReloadTarget::eGraphics) m_graphics_pipeline->replace(pipeline);
+                else m_mesh_pipeline->replace(pipeline);
+            }
+        }
+
+    private:
+        void init() {
+            if (!ENABLE_SHADER_HOT_RELOAD) return;
+            m_worker = std::jthread([this](const std::stop_token& stop) { run(stop); });
+        }
+        // 后台线程：等待文件修改，连续的修改合并后一起重建
+        void run(const std::stop_token& stop) {
+            std::optional<ShaderWatcher> watcher;
+            try {
+                watcher.emplace("shaders");
+            } catch (const std::exception& e) {
+                std::println("shader hot reload disabled: {}", e.what());
+                return;
+            }
+            while (!stop.stop_requested()) {
+                auto changed = watcher->wait(std::chrono::milliseconds(100));
+                if (changed.empty()) continue;
+                // 编辑器保存时可能连续写入多次，等待修改停止后再编译
+                for (auto more = watcher->wait(std::chrono::milliseconds(50)); !more.empty();
+                     more = watcher->wait(std::chrono::milliseconds(50))) {
+                    for (auto& path : more) {
+                        if (!std::ranges::contains(changed, path)) changed.push_back(std::move(path));
+                    }
+                }
+                std::erase_if(changed, [](const std::filesystem::path& path) { return path.extension() != ".glsl"; });
+                if (!changed.empty()) rebuild(changed);
+            }
+        }
+        // 把受影响的管线提交给 m_pipeline_builder
+        void rebuild(const std::span<const std::filesystem::path> changed) {
+            const auto uses = [&](const std::span<const std::string_view> sources) {
+                return std::ranges::any_of(changed, [&](const auto& path) { return is_source_of(path, sources); });
+            };
+            bool graphics = uses(GraphicsPipeline::shader_sources());
+            bool mesh = m_mesh_pipeline->supported() && uses(MeshPipeline::shader_sources());
+            if (!graphics && !mesh) {
+                graphics = true;
+                mesh = m_mesh_pipeline->supported();
+            }
+
+            const std::scoped_lock lock{ m_mutex };
+            if (graphics) m_reloaded.emplace_back(ReloadTarget::eGraphics, m_pipeline_builder->submit(m_graphics_pipeline->description()));
+            if (mesh) m_reloaded.emplace_back(ReloadTarget::eMesh, m_pipeline_builder->submit(m_mesh_pipeline->description()));
+        }
+    };
+
+}
@@ -0,0 +1,107 @@
+module;
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+export module ShaderWatcher;
+
+import std;
+
+export namespace vht {
+
+    /**
+     * @brief 监视目录中文件的修改
+     * @details
+     * - 工作：
+     *  - Linux 上使用 inotify，监听写入完成与移入（编辑器先写临时文件再重命名时触发后者）
+     *  - 其他平台每次调用时比较文件的修改时间
+     *  - 只报告目录中直接包含的文件，不递归
+     * - 可访问成员：
+     *  - wait(): 等待一段时间，返回期间被修改的文件
+     */
+    class ShaderWatcher {
+        std::filesystem::path m_directory;
+#ifdef __linux__
+        int m_fd{ -1 };
+#else
+        std::map<std::filesystem::path, std::filesystem::file_time_type> m_times;
+#endif
+    public:
+        /**
+         * @throw std::runtime_error 无法监视目录
+         */
+        explicit ShaderWatcher(std::filesystem::path directory)
+        :   m_directory(std::move(directory)) {
+            init();
+        }
+        ~ShaderWatcher() {
+#ifdef __linux__
+            if (m_fd >= 0) ::close(m_fd);
+#endif
+        }
+        ShaderWatcher(const ShaderWatcher&) = delete;
+        ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+        /**
+         * @brief 最多等待 timeout，返回被修改的文件，没有修改时返回空列表
+         * @details 同一文件在一次调用中只出现一次
+         */
+        [[nodiscard]]
+        std::vector<std::filesystem::path> wait(const std::chrono::milliseconds timeout) {
+            std::vector<std::filesystem::path> changed;
+#ifdef __linux__
+            pollfd descriptor{ m_fd, POLLIN, 0 };
+            if (::poll(&descriptor, 1, static_cast<int>(timeout.count())) <= 0) return changed;
+            alignas(inotify_event) std::array<char, 4096> buffer;
+            while (true) {
+                const auto length = ::read(m_fd, buffer.data(), buffer.size());
+                if (length <= 0) break;
+                for (std::size_t offset = 0; offset < static_cast<std::size_t>(length);) {
+                    const auto* event = reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+                    if (event->len > 0) {
+                        auto path = m_directory / event->name;
+                        if (!std::ranges::contains(changed, path)) changed.push_back(std::move(path));
+                    }
+                    offset += sizeof(inotify_event) + event->len;
+                }
+            }
+#else
+            std::this_thread::sleep_for(timeout);
+            std::error_code ec;
+            for (const auto& entry : std::filesystem::directory_iterator(m_directory, ec)) {
+                if (!entry.is_regular_file(ec)) continue;
+                const auto time = entry.last_write_time(ec);
+                if (ec) continue;
+                const auto [it, inserted] = m_times.try_emplace(entry.path(), time);
+                if (!inserted && it->second != time) {
+                    it->second = time;
+                    changed.push_back(entry.path());
+                }
+            }
+#endif
+            return changed;
+        }
+
+    private:
+        void init() {
+#ifdef __linux__
+            m_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (m_fd < 0) throw std::runtime_error("failed to initialize inotify!");
+            if (::inotify_add_watch(m_fd, m_directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+                // 构造函数抛出异常时不会调用析构函数
+                ::close(m_fd);
+                throw std::runtime_error(std::format("failed to watch {}", m_directory.string()));
+            }
+#else
+            std::error_code ec;
+            for (const auto& entry : std::filesystem::directory_iterator(m_directory, ec)) {
+                if (entry.is_regular_file(ec)) m_times.emplace(entry.path(), entry.last_write_time(ec));
+            }
+#endif
+        }
+    };
+
+}
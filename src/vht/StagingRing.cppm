@@ -0,0 +1,189 @@
+export module StagingRing;
+
+import std;
+import vulkan_hpp;
+
+import Config;
+import Device;
+import MemoryAllocator;
+
+export namespace vht {
+
+    /**
+     * @brief 暂存环中的一段区域
+     * @details
+     * - buffer: 暂存缓冲区，作为复制命令的源
+     * - offset: 区域在缓冲区中的偏移
+     * - size: 区域大小
+     * - data: 区域的映射地址，可直接写入
+     */
+    struct StagingRegion {
+        vk::Buffer buffer{};
+        vk::DeviceSize offset{};
+        vk::DeviceSize size{};
+        void* data{ nullptr };
+    };
+
+    /**
+     * @brief 持久映射的上传暂存环
+     * @details
+     * - 依赖：
+     *  - m_device: 逻辑设备
+     *  - m_allocator: 设备内存分配器
+     * - 工作：
+     *  - 创建一个 STAGING_RING_SIZE 字节、持久映射的暂存缓冲区
+     *  - 按环形方式分配区域，每段区域记录使用它的上传对应的时间线值
+     *  - 空间不足时只等待最早的一次上传完成，而不是等待整个队列
+     * - 使用方式：
+     *  - allocate() 获取区域并写入数据
+     *  - 记录复制命令，提交时用 commit() 的返回值发出 semaphore() 信号
+     * - 可访问成员：
+     *  - semaphore(): 上传时间线信号量
+     *  - buffer(): 暂存缓冲区
+     */
+    class StagingRing {
+        struct InFlight {
+            vk::DeviceSize offset{};
+            vk::DeviceSize size{};
+            std::uint64_t value{};
+        };
+        std::shared_ptr<vht::Device> m_device{ nullptr };
+        std::shared_ptr<vht::MemoryAllocator> m_allocator{ nullptr };
+        vht::Allocation m_allocation{ nullptr };
+        vk::raii::Buffer m_buffer{ nullptr };
+        vk::raii::Semaphore m_semaphore{ nullptr };
+        std::byte* m_mapped{ nullptr };
+        vk::DeviceSize m_capacity{ STAGING_RING_SIZE };
+        vk::DeviceSize m_head{};
+        std::deque<InFlight> m_in_flight;
+        std::uint64_t m_pending_value{ 1 }; // 下一次提交将发出的信号值
+    public:
+        explicit StagingRing(std::shared_ptr<vht::Device> device, std::shared_ptr<vht::MemoryAllocator> allocator)
+        :   m_device(std::move(device)),
+            m_allocator(std::move(allocator)) {
+            init();
+        }
+
+        [[nodiscard]]
+        const vk::raii::Semaphore& semaphore() const { return m_semaphore; }
+        [[nodiscard]]
+        const vk::raii::Buffer& buffer() const { return m_buffer; }
+        [[nodiscard]]
+        vk::DeviceSize capacity() const { return m_capacity; }
+
+        /**
+         * @brief 分配暂存区域
+         * @details 空间被已提交的上传占用时等待其中最早的一次完成
+         * @throw std::runtime_error 空间全部被尚未提交的区域占用
+         */
+        [[nodiscard]]
+        StagingRegion allocate(const vk::DeviceSize size, const vk::DeviceSize alignment = 16) {
+            if (const auto region = try_allocate(size, alignment)) return *region;
+            throw std::runtime_error("staging ring is full of uncommitted uploads!");
+        }
+
+        /**
+         * @brief 尝试分配暂存区域
+         * @return 空间全部被尚未提交的区域占用时返回 std::nullopt，调用者应先提交
+         */
+        [[nodiscard]]
+        std::optional<StagingRegion> try_allocate(vk::DeviceSize size, const vk::DeviceSize alignment = 16) {
+            if (size > m_capacity) throw std::invalid_argument("upload is larger than the staging ring!");
+            size = std::max<vk::DeviceSize>(size, 1);
+            retire();
+            while (true) {
+                if (const auto offset = find_space(size, alignment)) {
+                    m_in_flight.emplace_back( *offset, size, m_pending_value );
+                    m_head = *offset + size;
+                    return StagingRegion{ m_buffer, *offset, size, m_mapped + *offset };
+                }
+                const std::uint64_t oldest = m_in_flight.front().value;
+                if (oldest >= m_pending_value) return std::nullopt;
+                wait(oldest);
+                retire();
+            }
+        }
+
+        /**
+         * @brief 提交此前分配的全部区域
+         * @return 使用这些区域的提交完成时需要发出的时间线信号值
+         */
+        [[nodiscard]]
+        std::uint64_t commit() { return m_pending_value++; }
+
+        // 时间线信号量当前已完成的值
+        [[nodiscard]]
+        std::uint64_t completed_value() const { return m_semaphore.getCounterValue(); }
+
+        // 判断某次上传是否完成
+        [[nodiscard]]
+        bool is_complete(const std::uint64_t value) const { return completed_value() >= value; }
+
+        // 等待某次上传完成
+        void wait(const std::uint64_t value) const {
+            vk::SemaphoreWaitInfo wait_info;
+            wait_info.setSemaphores( *m_semaphore );
+            wait_info.setValues( value );
+            std::ignore = m_device->device().waitSemaphores( wait_info, std::numeric_limits<std::uint64_t>::max() );
+        }
+
+    private:
+        void init() {
+            create_buffer();
+            create_semaphore();
+        }
+        // 创建持久映射的暂存缓冲区
+        void create_buffer() {
+            vk::BufferCreateInfo create_info;
+            create_info.size = m_capacity;
+            create_info.usage = vk::BufferUsageFlagBits::eTransferSrc;
+            create_info.sharingMode = vk::SharingMode::eExclusive;
+            m_buffer = m_device->device().createBuffer( create_info );
+
+            m_allocation = m_allocator->allocate(
+                m_buffer.getMemoryRequirements(),
+                vk::MemoryPropertyFlagBits::eHostVisible |
+                vk::MemoryPropertyFlagBits::eHostCoherent,
+                vht::ResourceKind::eLinear
+            );
+            m_buffer.bindMemory( m_allocation.memory(), m_allocation.offset() );
+            m_mapped = static_cast<std::byte*>(m_allocation.mapped());
+        }
+        // 创建上传时间线信号量
+        void create_semaphore() {
+            vk::StructureChain<vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo> create_info;
+            create_info.get<vk::SemaphoreTypeCreateInfo>()
+                .setSemaphoreType( vk::SemaphoreType::eTimeline )
+                .setInitialValue( 0 );
+            m_semaphore = m_device->device().createSemaphore( create_info.get() );
+        }
+        // 回收已完成上传占用的区域
+        void retire() {
+            if (m_in_flight.empty()) return;
+            const std::uint64_t completed = completed_value();
+            while (!m_in_flight.empty() && m_in_flight.front().value <= completed) {
+                m_in_flight.pop_front();
+            }
+        }
+        // 在环中寻找可用空间，不会越过最早的在途区域
+        [[nodiscard]]
+        std::optional<vk::DeviceSize> find_space(const vk::DeviceSize size, const vk::DeviceSize alignment) {
+            if (m_in_flight.empty()) {
+                m_head = 0;
+                return 0;
+            }
+            const vk::DeviceSize tail = m_in_flight.front().offset;
+            const vk::DeviceSize offset = (m_head + alignment - 1) / alignment * alignment;
+            if (m_head > tail) {
+                // 占用区间为 [tail, head)，先尝试末尾，再尝试回绕到开头
+                if (offset + size <= m_capacity) return offset;
+                if (size <= tail) return 0;
+                return std::nullopt;
+            }
+            // 已回绕，空闲区间为 [head, tail)
+            if (offset + size <= tail) return offset;
+            return std::nullopt;
+        }
+    };
+
+}
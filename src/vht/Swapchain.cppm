@@ -132,7 +132,7 @@ export namespace vht {
             create_info.clipped = true;
             create_info.oldSwapchain = nullptr;
 
-            const auto [graphics_family, present_family] = m_device->queue_family_indices();
+            const auto [graphics_family, present_family, transfer_family] = m_device->queue_family_indices();
             std::vector<std::uint32_t> queueFamilyIndices { graphics_family.value(), present_family.value() };
             if (graphics_family.value() != present_family.value()) {
                 create_info.imageSharingMode = vk::SharingMode::eConcurrent;
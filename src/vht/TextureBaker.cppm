@@ -0,0 +1,189 @@
+export module TextureBaker;
+
+import std;
+import stbi;
+import vulkan_hpp;
+
+import Config;
+import TextureCache;
+import BlockCompressor;
+
+namespace vht {
+
+    // sRGB 编码值到线性值的查找表
+    [[nodiscard]]
+    const std::array<float, 256>& srgb_to_linear_table() {
+        static const std::array<float, 256> table = [] {
+            std::array<float, 256> result{};
+            for (std::size_t i = 0; i < result.size(); ++i) {
+                const float c = static_cast<float>(i) / 255.0f;
+                result[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            return result;
+        }();
+        return table;
+    }
+
+    [[nodiscard]]
+    std::byte linear_to_srgb(const float linear) {
+        const float c = std::clamp(linear, 0.0f, 1.0f);
+        const float encoded = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        return static_cast<std::byte>(static_cast<std::uint8_t>(encoded * 255.0f + 0.5f));
+    }
+
+    /**
+     * @brief 2x2 盒式滤波生成下一级，与 shaders/mipmap.comp.glsl 相同：
+     * 颜色在线性空间中平均，alpha 直接平均，奇数尺寸时边缘像素重复
+     */
+    [[nodiscard]]
+    std::vector<std::byte> downsample_srgb(const std::span<const std::byte> source, const std::uint32_t width, const std::uint32_t height) {
+        const auto& to_linear = srgb_to_linear_table();
+        const std::uint32_t next_width = std::max(width / 2, 1u);
+        const std::uint32_t next_height = std::max(height / 2, 1u);
+        std::vector<std::byte> result(static_cast<std::size_t>(next_width) * next_height * 4);
+        for (std::uint32_t y = 0; y < next_height; ++y) {
+            const std::uint32_t y0 = std::min(y * 2, height - 1);
+            const std::uint32_t y1 = std::min(y * 2 + 1, height - 1);
+            for (std::uint32_t x = 0; x < next_width; ++x) {
+                const std::uint32_t x0 = std::min(x * 2, width - 1);
+                const std::uint32_t x1 = std::min(x * 2 + 1, width - 1);
+                const std::array<std::size_t, 4> texels{
+                    (static_cast<std::size_t>(y0) * width + x0) * 4,
+                    (static_cast<std::size_t>(y0) * width + x1) * 4,
+                    (static_cast<std::size_t>(y1) * width + x0) * 4,
+                    (static_cast<std::size_t>(y1) * width + x1) * 4
+                };
+                std::byte* out = result.data() + (static_cast<std::size_t>(y) * next_width + x) * 4;
+                for (std::size_t c = 0; c < 3; ++c) {
+                    float sum = 0.0f;
+                    for (const auto texel : texels) sum += to_linear[std::to_integer<std::uint8_t>(source[texel + c])];
+                    out[c] = linear_to_srgb(sum * 0.25f);
+                }
+                std::uint32_t alpha = 0;
+                for (const auto texel : texels) alpha += std::to_integer<std::uint8_t>(source[texel + 3]);
+                out[3] = static_cast<std::byte>((alpha + 2) / 4);
+            }
+        }
+        return result;
+    }
+
+}
+
+export namespace vht {
+
+    /**
+     * @brief 烘焙后的纹理，持有各层级的像素数据
+     * @details
+     * - format: 像素格式
+     * - width/height: 第 0 级的尺寸
+     * - levels: 从第 0 级开始的各层像素数据
+     * - image(): 可直接上传或写入容器的数据视图
+     */
+    struct BakedTexture {
+        vk::Format format{ vk::Format::eUndefined };
+        std::uint32_t width{};
+        std::uint32_t height{};
+        std::vector<std::vector<std::byte>> levels;
+
+        [[nodiscard]]
+        TextureImage image() const {
+            TextureImage image{ format, width, height, {} };
+            for (const auto& level : levels) image.levels.emplace_back(level);
+            return image;
+        }
+    };
+
+}
+
+namespace vht {
+
+    // 由 stbi 解码得到的 RGBA8 像素生成各层级并压缩，释放 pixels
+    [[nodiscard]]
+    BakedTexture bake_pixels(
+        stbi::uc* pixels,
+        const int width,
+        const int height,
+        const bool mipmaps,
+        const TextureCompression compression
+    ) {
+        BakedTexture texture;
+        texture.format = vk::Format::eR8G8B8A8Srgb;
+        texture.width = static_cast<std::uint32_t>(width);
+        texture.height = static_cast<std::uint32_t>(height);
+        const auto bytes = reinterpret_cast<const std::byte*>(pixels);
+        texture.levels.emplace_back(bytes, bytes + static_cast<std::size_t>(width) * height * 4);
+        stbi::image_free(pixels);
+
+        std::uint32_t level_width = texture.width;
+        std::uint32_t level_height = texture.height;
+        while (mipmaps && (level_width > 1 || level_height > 1)) {
+            auto next = downsample_srgb(texture.levels.back(), level_width, level_height);
+            texture.levels.emplace_back(std::move(next));
+            level_width = std::max(level_width / 2, 1u);
+            level_height = std::max(level_height / 2, 1u);
+        }
+
+        if (compression != TextureCompression::eNone) {
+            texture.format = texture_format(compression);
+            for (std::uint32_t i = 0; auto& level : texture.levels) {
+                level = compress_level(
+                    texture.format,
+                    level,
+                    std::max(texture.width >> i, 1u),
+                    std::max(texture.height >> i, 1u)
+                );
+                ++i;
+            }
+        }
+        return texture;
+    }
+
+}
+
+export namespace vht {
+
+    /**
+     * @brief 解码图片并转换为 GPU 格式
+     * @details
+     * 解码为 RGBA8 sRGB；mipmaps 为 true 时在 CPU 上生成完整的 mip 链；
+     * 指定压缩格式时各层级在 RGBA8 下生成后再逐层压缩，避免在压缩数据上降采样
+     * @throw std::runtime_error 图片无法解码
+     */
+    [[nodiscard]]
+    BakedTexture bake_texture(
+        const std::filesystem::path& source,
+        const bool mipmaps,
+        const TextureCompression compression = TextureCompression::eNone
+    ) {
+        int width, height, channels;
+        stbi::uc* pixels = stbi::load(source.string().c_str(), &width, &height, &channels, stbi::RGB_ALPHA);
+        if (!pixels) {
+            throw std::runtime_error("failed to load texture image!");
+        }
+        return vht::bake_pixels(pixels, width, height, mipmaps, compression);
+    }
+
+    /**
+     * @brief 解码内存中的图片并转换为 GPU 格式
+     * @details 与按路径读取的版本相同，用于已映射到内存的文件
+     * @throw std::runtime_error 图片无法解码
+     */
+    [[nodiscard]]
+    BakedTexture bake_texture(
+        const std::span<const std::byte> encoded,
+        const bool mipmaps,
+        const TextureCompression compression = TextureCompression::eNone
+    ) {
+        int width, height, channels;
+        stbi::uc* pixels = stbi::load_from_memory(
+            reinterpret_cast<const stbi::uc*>(encoded.data()),
+            static_cast<int>(encoded.size()),
+            &width, &height, &channels, stbi::RGB_ALPHA
+        );
+        if (!pixels) {
+            throw std::runtime_error(stbi::failure_reason());
+        }
+        return vht::bake_pixels(pixels, width, height, mipmaps, compression);
+    }
+
+}
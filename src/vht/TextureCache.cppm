@@ -0,0 +1,181 @@
+export module TextureCache;
+
+import std;
+import vulkan_hpp;
+
+import MappedFile;
+import CacheFile;
+import BlockCompressor;
+
+export namespace vht {
+
+    /**
+     * @brief 纹理的一个 mip 层级在容器中的位置
+     * @details
+     * - offset/size: 像素数据在文件中的范围
+     * - width/height: 层级的尺寸
+     */
+    struct TextureLevel {
+        std::uint64_t offset{};
+        std::uint64_t size{};
+        std::uint32_t width{};
+        std::uint32_t height{};
+    };
+
+    /**
+     * @brief 可直接上传的纹理数据视图，不持有数据
+     * @details
+     * - format: 像素格式
+     * - width/height: 第 0 级的尺寸
+     * - levels: 从第 0 级开始的各层像素数据
+     */
+    struct TextureImage {
+        vk::Format format{ vk::Format::eUndefined };
+        std::uint32_t width{};
+        std::uint32_t height{};
+        std::vector<std::span<const std::byte>> levels;
+    };
+
+}
+
+namespace vht {
+
+    constexpr std::array<char, 4> TEXTURE_MAGIC{ 'V', 'H', 'T', 'T' };
+    constexpr std::uint32_t TEXTURE_VERSION = 1;
+    constexpr std::uint32_t MAX_TEXTURE_LEVELS = 16;
+    constexpr std::uint64_t TEXTURE_BLOB_ALIGNMENT = 16;
+
+    /**
+     * @brief 纹理容器文件头
+     * @details 文件布局：文件头 | 第 0 级 | 第 1 级 | ...，每一级按 TEXTURE_BLOB_ALIGNMENT 对齐
+     */
+    struct TextureHeader {
+        std::array<char, 4> magic{ TEXTURE_MAGIC };
+        std::uint32_t version{ TEXTURE_VERSION };
+        SourceKey source{};
+        std::uint32_t format{};             // vk::Format
+        std::uint32_t width{};
+        std::uint32_t height{};
+        std::uint32_t level_count{};
+        std::array<TextureLevel, MAX_TEXTURE_LEVELS> levels{};
+    };
+    static_assert(std::is_trivially_copyable_v<TextureHeader>);
+
+}
+
+export namespace vht {
+
+    /**
+     * @brief 预烘焙的纹理容器
+     * @details
+     * - 工作：
+     *  - 保存已转换为 GPU 格式的各 mip 层级像素数据，加载时不需要解码
+     *  - 读取时内存映射容器文件，各层级直接指向映射内存，由调用者复制到暂存区
+     *  - 源文件存在时以其路径、大小和修改时间校验容器；源文件不存在时直接使用容器，
+     *    只发布烘焙结果时不需要附带原始图片
+     * - 可访问成员：
+     *  - image(): 纹理数据视图
+     */
+    class TextureCache {
+        std::unique_ptr<MappedFile> m_file{ nullptr };
+        TextureHeader m_header{};
+    public:
+        [[nodiscard]]
+        TextureImage image() const {
+            TextureImage image;
+            image.format = static_cast<vk::Format>(m_header.format);
+            image.width = m_header.width;
+            image.height = m_header.height;
+            for (std::uint32_t i = 0; i < m_header.level_count; ++i) {
+                const auto& level = m_header.levels[i];
+                image.levels.emplace_back(reinterpret_cast<const std::byte*>(m_file->data()) + level.offset, level.size);
+            }
+            return image;
+        }
+
+        // 源文件对应的容器文件路径
+        [[nodiscard]]
+        static std::filesystem::path cache_path(const std::filesystem::path& source) {
+            return vht::cache_path(source, "textures", "vtex");
+        }
+
+        /**
+         * @brief 打开源文件对应的容器
+         * @return 容器不存在、与源文件不一致或已损坏时返回 std::nullopt
+         */
+        [[nodiscard]]
+        static std::optional<TextureCache> load(const std::filesystem::path& source) {
+            const auto path = cache_path(source);
+            std::error_code ec;
+            if (!std::filesystem::exists(path, ec)) return std::nullopt;
+
+            TextureCache cache;
+            try {
+                cache.m_file = std::make_unique<MappedFile>(path.string());
+            } catch (const std::runtime_error&) {
+                return std::nullopt;
+            }
+            const std::uint64_t file_size = cache.m_file->size();
+            if (file_size < sizeof(TextureHeader)) return std::nullopt;
+            std::memcpy(&cache.m_header, cache.m_file->data(), sizeof(TextureHeader));
+
+            const TextureHeader& header = cache.m_header;
+            if (header.magic != TEXTURE_MAGIC || header.version != TEXTURE_VERSION) return std::nullopt;
+            if (const auto key = vht::source_key(source); key && header.source != *key) return std::nullopt;
+            if (header.width == 0 || header.height == 0 ||
+                header.level_count == 0 || header.level_count > MAX_TEXTURE_LEVELS) return std::nullopt;
+            for (std::uint32_t i = 0; i < header.level_count; ++i) {
+                const auto& level = header.levels[i];
+                if (level.offset % TEXTURE_BLOB_ALIGNMENT != 0 ||
+                    level.offset + level.size > file_size ||
+                    level.size != level_size(static_cast<vk::Format>(header.format), level.width, level.height) ||
+                    level.width != std::max(header.width >> i, 1u) ||
+                    level.height != std::max(header.height >> i, 1u)) return std::nullopt;
+            }
+            return cache;
+        }
+
+        /**
+         * @brief 写入源文件对应的容器
+         * @details 写入失败或源文件已无法读取时只打印警告，不影响已加载的数据
+         */
+        static void store(const std::filesystem::path& source, const TextureImage& image) {
+            if (image.levels.empty() || image.levels.size() > MAX_TEXTURE_LEVELS) {
+                throw std::invalid_argument("invalid level count for texture cache!");
+            }
+            const auto key = vht::source_key(source);
+            if (!key) {
+                std::println("failed to write cache: {} is unavailable", source.string());
+                return;
+            }
+            TextureHeader header{};
+            header.source = *key;
+            header.format = static_cast<std::uint32_t>(image.format);
+            header.width = image.width;
+            header.height = image.height;
+            header.level_count = static_cast<std::uint32_t>(image.levels.size());
+            std::uint64_t offset = align_up(sizeof(TextureHeader), TEXTURE_BLOB_ALIGNMENT);
+            for (std::uint32_t i = 0; i < header.level_count; ++i) {
+                header.levels[i] = {
+                    offset,
+                    image.levels[i].size(),
+                    std::max(image.width >> i, 1u),
+                    std::max(image.height >> i, 1u)
+                };
+                offset = align_up(offset + image.levels[i].size(), TEXTURE_BLOB_ALIGNMENT);
+            }
+
+            vht::write_cache_file(cache_path(source), [&](std::ofstream& file) {
+                file.write(reinterpret_cast<const char*>(&header), sizeof(TextureHeader));
+                for (std::uint32_t i = 0; i < header.level_count; ++i) {
+                    vht::pad_to(file, header.levels[i].offset);
+                    file.write(reinterpret_cast<const char*>(image.levels[i].data()), static_cast<std::streamsize>(image.levels[i].size()));
+                }
+            });
+        }
+
+    private:
+        TextureCache() = default;
+    };
+
+}
@@ -0,0 +1,432 @@
+export module TextureLoader;
+
+import std;
+import stbi;
+import vulkan_hpp;
+
+import Config;
+import Tools;
+import Device;
+import MemoryAllocator;
+import StagingRing;
+import UploadBatcher;
+import MipmapGenerator;
+import MappedFile;
+import TextureCache;
+import TextureBaker;
+import BlockCompressor;
+import TextureTable;
+import TextureStreamer;
+
+namespace vht {
+
+    /**
+     * @brief 一个纹理的加载任务
+     * @details
+     * - 主线程读取尺寸并预留暂存区域，解码线程只写入自己的区域，互不加锁
+     * - cache 命中时各层级直接复制到暂存区；否则 bake 为 true，解码 file 中的图片并烘焙为容器，
+     *   各层级写入暂存区后再写入容器，之后的启动走 cache 命中的路径
+     * - 流送的纹理只上传 [first_level, 层数) 的层级，width/height 为 first_level 的尺寸
+     */
+    struct TextureJob {
+        std::filesystem::path path;
+        std::optional<TextureCache> cache;
+        std::unique_ptr<MappedFile> file{ nullptr };
+        bool bake{ false };
+        vk::Format format{ vk::Format::eR8G8B8A8Srgb };
+        std::uint32_t width{};
+        std::uint32_t height{};
+        std::uint32_t first_level{ 0 };             // 大于 0 时交给 TextureStreamer 流送
+        std::vector<std::uint64_t> level_offsets;   // 各层级在暂存区域中的偏移
+        std::vector<std::uint64_t> level_sizes;
+        StagingRegion region{};
+        std::string error;                          // 解码失败时由解码线程写入
+        std::optional<TextureSlot> slot;
+    };
+
+}
+
+export namespace vht {
+
+    /**
+     * @brief 多线程纹理加载
+     * @details
+     * - 依赖：
+     *  - m_device: 逻辑设备
+     *  - m_allocator: 设备内存分配器
+     *  - m_upload_batcher: 上传命令批处理
+     *  - m_mipmap_generator: mip 链生成
+     *  - m_texture_table: 无绑定纹理表
+     *  - m_texture_streamer: 纹理 mip 流送
+     * - 工作：
+     *  - load() 一次加载多个纹理：主线程只读取文件头并为每个纹理预留一段映射的暂存区域，
+     *    解码任务放入任务队列，由工作线程用 stbi::load_from_memory 并行解码，结果直接写入各自的区域
+     *  - 容器的格式与当前使用的压缩格式相同时使用预烘焙的纹理容器，不解码；没有可用的容器时在工作线程中解码，
+     *    按 TEXTURE_MIPMAPS 与 TEXTURE_COMPRESSION 烘焙并写入容器，压缩与 mip 生成只在第一次加载时进行
+     *  - TEXTURE_STREAMING 开启时，包含完整 mip 链的容器（包括刚烘焙的）只上传低分辨率的层级，之后交给 m_texture_streamer
+     *  - 暂存环放不下全部纹理时分批进行，每批解码完成后记录上传命令并提交
+     *  - 所有纹理共用一个采样器，图像与采样器注册到纹理表
+     *  - 上传命令记录在 m_upload_batcher 中，由调用者统一提交与等待
+     * - 可访问成员：
+     *  - load(): 加载纹理，返回各纹理在纹理表中的槽位，加载失败的为 std::nullopt
+     */
+    class TextureLoader {
+        std::shared_ptr<vht::Device> m_device{ nullptr };
+        std::shared_ptr<vht::MemoryAllocator> m_allocator{ nullptr };
+        std::shared_ptr<vht::UploadBatcher> m_upload_batcher{ nullptr };
+        std::shared_ptr<vht::MipmapGenerator> m_mipmap_generator{ nullptr };
+        std::shared_ptr<vht::TextureTable> m_texture_table{ nullptr };
+        std::shared_ptr<vht::TextureStreamer> m_texture_streamer{ nullptr };
+        vk::raii::Sampler m_sampler{ nullptr };
+        std::uint32_t m_sampler_index{ 0 };
+        vht::TextureCompression m_compression{ vht::TextureCompression::eNone };
+        std::vector<TextureResource> m_textures;
+        std::mutex m_mutex;
+        std::condition_variable_any m_condition;
+        std::deque<std::function<void()>> m_jobs;   // 由 m_mutex 保护
+        std::vector<std::jthread> m_workers;
+    public:
+        explicit TextureLoader(
+            std::shared_ptr<vht::Device> device,
+            std::shared_ptr<vht::MemoryAllocator> allocator,
+            std::shared_ptr<vht::UploadBatcher> upload_batcher,
+            std::shared_ptr<vht::MipmapGenerator> mipmap_generator,
+            std::shared_ptr<vht::TextureTable> texture_table,
+            std::shared_ptr<vht::TextureStreamer> texture_streamer
+        ):  m_device(std::move(device)),
+            m_allocator(std::move(allocator)),
+            m_upload_batcher(std::move(upload_batcher)),
+            m_mipmap_generator(std::move(mipmap_generator)),
+            m_texture_table(std::move(texture_table)),
+            m_texture_streamer(std::move(texture_streamer)) {
+            init();
+        }
+        TextureLoader(const TextureLoader&) = delete;
+        TextureLoader& operator=(const TextureLoader&) = delete;
+
+        /**
+         * @brief 加载多个纹理
+         * @details 返回时解码已完成、上传命令已记录，纹理在 m_upload_batcher 提交完成后才能被绘制
+         * @return 与 paths 一一对应的槽位，加载失败的为 std::nullopt
+         */
+        [[nodiscard]]
+        std::vector<std::optional<TextureSlot>> load(const std::span<const std::filesystem::path> paths) {
+            const auto start_time = std::chrono::steady_clock::now();
+            std::vector<TextureJob> jobs;
+            jobs.reserve(paths.size());
+            for (const auto& path : paths) {
+                auto& job = jobs.emplace_back();
+                job.path = path;
+                try {
+                    prepare(job);
+                } catch (const std::exception& e) {
+                    job.error = e.what();
+                }
+            }
+
+            // 按暂存环的剩余空间分批，同一批的区域在记录命令之前不会被回收
+            std::vector<TextureJob*> batch;
+            for (auto& job : jobs) {
+                if (!job.error.empty()) continue;
+                const auto size = job.level_offsets.back() + job.level_sizes.back();
+                if (auto region = m_upload_batcher->try_reserve(size)) {
+                    job.region = *region;
+                } else {
+                    if (!batch.empty()) {
+                        process(batch);
+                        batch.clear();
+                    }
+                    job.region = m_upload_batcher->reserve(size);
+                }
+                batch.push_back(&job);
+            }
+            if (!batch.empty()) process(batch);
+
+            std::vector<std::optional<TextureSlot>> slots;
+            std::uint32_t loaded = 0;
+            std::uint32_t baked = 0;
+            for (const auto& job : jobs) {
+                if (!job.error.empty()) std::println("failed to load texture {}: {}", job.path.generic_string(), job.error);
+                if (job.slot) ++loaded;
+                if (job.slot && job.bake) ++baked;
+                slots.push_back(job.slot);
+            }
+            const auto end_time = std::chrono::steady_clock::now();
+            std::println("textures loaded: {}/{} ({} baked) on {} threads, {:.2f} ms", loaded, jobs.size(), baked, m_workers.size(),
+                std::chrono::duration<double, std::milli>(end_time - start_time).count());
+            std::println("texture streaming: {} textures, {:.2f}/{:.2f} MiB resident", m_texture_streamer->texture_count(),
+                static_cast<double>(m_texture_streamer->resident_bytes()) / (1024.0 * 1024.0),
+                static_cast<double>(TEXTURE_STREAMING_BUDGET) / (1024.0 * 1024.0));
+            return slots;
+        }
+
+    private:
+        void init() {
+            m_compression = texture_compression();
+            create_sampler();
+            const std::uint32_t thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+            for (std::uint32_t i = 0; i < thread_count; ++i) {
+                m_workers.emplace_back([this](const std::stop_token& stop) { run(stop); });
+            }
+        }
+        // 设备支持采样与线性过滤时使用配置的压缩格式，否则不压缩
+        [[nodiscard]]
+        vht::TextureCompression texture_compression() const {
+            if (TEXTURE_COMPRESSION == vht::TextureCompression::eNone) return TEXTURE_COMPRESSION;
+            const auto format = vht::texture_format(TEXTURE_COMPRESSION);
+            if (m_device->format_supported(format,
+                vk::FormatFeatureFlagBits::eSampledImage | vk::FormatFeatureFlagBits::eSampledImageFilterLinear |
+                vk::FormatFeatureFlagBits::eTransferDst
+            )) return TEXTURE_COMPRESSION;
+            std::println("texture compression format {} unsupported, using uncompressed", vk::to_string(format));
+            return vht::TextureCompression::eNone;
+        }
+        // 所有纹理共用的采样器，LOD 范围不限制，由各图像的 mip 层数决定
+        void create_sampler() {
+            vk::SamplerCreateInfo create_info;
+            create_info.magFilter = vk::Filter::eLinear;
+            create_info.minFilter = vk::Filter::eLinear;
+            create_info.mipmapMode = vk::SamplerMipmapMode::eLinear;
+            create_info.addressModeU = vk::SamplerAddressMode::eRepeat;
+            create_info.addressModeV = vk::SamplerAddressMode::eRepeat;
+            create_info.addressModeW = vk::SamplerAddressMode::eRepeat;
+            if (m_device->physical_device().getFeatures().samplerAnisotropy) {
+                create_info.anisotropyEnable = true;
+                create_info.maxAnisotropy = m_device->physical_device().getProperties().limits.maxSamplerAnisotropy;
+            }
+            create_info.minLod = 0.0f;
+            create_info.maxLod = vk::LodClampNone;
+            m_sampler = m_device->device().createSampler(create_info);
+            m_sampler_index = m_texture_table->register_sampler(m_sampler);
+        }
+        // 工作线程：依次执行任务队列中的解码任务
+        void run(const std::stop_token& stop) {
+            while (true) {
+                std::function<void()> job;
+                {
+                    std::unique_lock lock{ m_mutex };
+                    if (!m_condition.wait(lock, stop, [this] { return !m_jobs.empty(); })) return;
+                    job = std::move(m_jobs.front());
+                    m_jobs.pop_front();
+                }
+                job();
+            }
+        }
+
+        /**
+         * @brief 读取纹理的格式与尺寸，计算各层级在暂存区域中的布局
+         * @details 只读取容器头或图片头，不解码；需要烘焙时按烘焙结果的格式与层数布局
+         * @throw std::runtime_error 文件无法打开或不是支持的图片
+         */
+        void prepare(TextureJob& job) const {
+            if (auto cache = vht::TextureCache::load(job.path)) {
+                const auto image = cache->image();
+                // 容器的格式与当前使用的格式不同时重新烘焙，例如修改了 TEXTURE_COMPRESSION 或设备不支持容器的压缩格式
+                if (image.format == vht::texture_format(m_compression)) {
+                    job.first_level = streaming_level(image);
+                    job.format = image.format;
+                    job.width = std::max(image.width >> job.first_level, 1u);
+                    job.height = std::max(image.height >> job.first_level, 1u);
+                    for (std::uint32_t level = job.first_level; level < image.levels.size(); ++level) {
+                        add_level(job, image.levels[level].size());
+                    }
+                    job.cache = std::move(cache);
+                    return;
+                }
+            }
+            job.file = std::make_unique<MappedFile>(job.path.string());
+            int width, height, channels;
+            if (!stbi::info_from_memory(
+                reinterpret_cast<const stbi::uc*>(job.file->data()),
+                static_cast<int>(job.file->size()),
+                &width, &height, &channels
+            )) throw std::runtime_error(stbi::failure_reason());
+            job.bake = true;
+            job.format = vht::texture_format(m_compression);
+            job.width = static_cast<std::uint32_t>(width);
+            job.height = static_cast<std::uint32_t>(height);
+            const std::uint32_t level_count = TEXTURE_MIPMAPS ? vht::mip_level_count(job.width, job.height) : 1;
+            for (std::uint32_t level = 0; level < level_count; ++level) {
+                add_level(job, vht::level_size(job.format, std::max(job.width >> level, 1u), std::max(job.height >> level, 1u)));
+            }
+        }
+        // 容器包含完整 mip 链且开启流送时，加载时常驻的第一个层级；否则为 0
+        [[nodiscard]]
+        static std::uint32_t streaming_level(const TextureImage& image) {
+            const auto level_count = static_cast<std::uint32_t>(image.levels.size());
+            if (TEXTURE_STREAMING && TEXTURE_MIPMAPS && level_count == vht::mip_level_count(image.width, image.height)) {
+                return vht::streaming_initial_level(image.width, image.height, level_count);
+            }
+            return 0;
+        }
+        /**
+         * @brief 刚烘焙的纹理改为流送：只保留 [first_level, 层数) 的层级
+         * @details 暂存区域中仍写入了全部层级，丢弃的部分随暂存环回收；容器写入失败时没有流送的数据来源，全部常驻
+         */
+        static void stream_baked(TextureJob& job) {
+            if (!job.cache) return;
+            job.first_level = streaming_level(job.cache->image());
+            job.width = std::max(job.width >> job.first_level, 1u);
+            job.height = std::max(job.height >> job.first_level, 1u);
+            job.level_offsets.erase(job.level_offsets.begin(), job.level_offsets.begin() + job.first_level);
+            job.level_sizes.erase(job.level_sizes.begin(), job.level_sizes.begin() + job.first_level);
+        }
+        static void add_level(TextureJob& job, const std::uint64_t size) {
+            const std::uint64_t offset = job.level_offsets.empty()
+                ? 0 : (job.level_offsets.back() + job.level_sizes.back() + 15) / 16 * 16;
+            job.level_offsets.push_back(offset);
+            job.level_sizes.push_back(size);
+        }
+
+        // 工作线程中执行：把像素写入任务自己的暂存区域
+        void decode(TextureJob& job) const {
+            auto* dst = static_cast<std::byte*>(job.region.data);
+            if (job.cache) {
+                const auto image = job.cache->image();
+                for (std::size_t i = 0; i < job.level_sizes.size(); ++i) {
+                    const auto& level = image.levels[job.first_level + i];
+                    std::memcpy(dst + job.level_offsets[i], level.data(), level.size());
+                }
+                return;
+            }
+            // 烘焙结果在写入容器之前已在内存中，逐层复制到暂存区域
+            const auto baked = vht::bake_texture(
+                std::as_bytes(std::span{ job.file->data(), job.file->size() }),
+                TEXTURE_MIPMAPS,
+                m_compression
+            );
+            if (baked.format != job.format || baked.levels.size() != job.level_sizes.size()) {
+                job.error = "baked texture does not match the reserved layout";
+                return;
+            }
+            for (std::size_t i = 0; i < baked.levels.size(); ++i) {
+                std::memcpy(dst + job.level_offsets[i], baked.levels[i].data(), baked.levels[i].size());
+            }
+            vht::TextureCache::store(job.path, baked.image());
+            job.cache = vht::TextureCache::load(job.path);
+        }
+
+        // 并行解码一批纹理，完成后在主线程记录上传命令
+        void process(const std::span<TextureJob* const> batch) {
+            std::latch done{ static_cast<std::ptrdiff_t>(batch.size()) };
+            {
+                const std::scoped_lock lock{ m_mutex };
+                for (TextureJob* job : batch) {
+                    m_jobs.emplace_back([this, job, &done] {
+                        try {
+                            decode(*job);
+                        } catch (const std::exception& e) {
+                            job->error = e.what();
+                        }
+                        done.count_down();
+                    });
+                }
+            }
+            m_condition.notify_all();
+            done.wait();
+
+            for (TextureJob* job : batch) {
+                job->file.reset();
+                if (!job->error.empty()) continue;
+                if (job->bake) stream_baked(*job);
+                record_upload(*job);
+                job->cache.reset();
+            }
+        }
+
+        // 创建图像、记录各层级的复制与 mip 生成，并注册到纹理表
+        void record_upload(TextureJob& job) {
+            const bool compressed = vht::is_block_compressed(job.format);
+            const auto provided_levels = static_cast<std::uint32_t>(job.level_sizes.size());
+            std::uint32_t mip_levels = TEXTURE_MIPMAPS ? vht::mip_level_count(job.width, job.height) : 1;
+            // 块压缩格式无法作为 blit 或存储图像的目标，只使用已有的层级
+            if (compressed) mip_levels = std::min(provided_levels, mip_levels);
+            const auto copied_levels = std::min(provided_levels, mip_levels);
+            const bool generate = copied_levels < mip_levels;
+
+            vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+            // 流送提高层级时从这里复制仍常驻的层级
+            if (job.first_level > 0) usage |= vk::ImageUsageFlagBits::eTransferSrc;
+            vk::ImageCreateFlags flags;
+            if (generate) {
+                usage |= m_mipmap_generator->image_usage(job.format);
+                flags = m_mipmap_generator->image_flags(job.format);
+            }
+
+            TextureResource texture;
+            vht::create_image(
+                texture.image,
+                texture.allocation,
+                m_device->device(),
+                *m_allocator,
+                job.width,
+                job.height,
+                job.format,
+                vk::ImageTiling::eOptimal,
+                usage,
+                vk::MemoryPropertyFlagBits::eDeviceLocal,
+                mip_levels,
+                flags
+            );
+
+            m_upload_batcher->transition_image_layout(
+                texture.image,
+                vk::ImageLayout::eUndefined,
+                vk::ImageLayout::eTransferDstOptimal,
+                mip_levels
+            );
+            for (std::uint32_t level = 0; level < copied_levels; ++level) {
+                StagingRegion region = job.region;
+                region.offset += job.level_offsets[level];
+                region.size = job.level_sizes[level];
+                m_upload_batcher->copy_buffer_to_image(
+                    region,
+                    texture.image,
+                    std::max(job.width >> level, 1u),
+                    std::max(job.height >> level, 1u),
+                    level
+                );
+            }
+            if (generate) {
+                m_upload_batcher->release_image(
+                    texture.image,
+                    vk::ImageLayout::eTransferDstOptimal,
+                    vk::ImageLayout::eTransferDstOptimal,
+                    vk::PipelineStageFlagBits2::eTransfer,
+                    vk::AccessFlagBits2::eTransferRead | vk::AccessFlagBits2::eTransferWrite
+                );
+                m_mipmap_generator->generate(
+                    m_upload_batcher->graphics_command_buffer(),
+                    texture.image,
+                    job.format,
+                    job.width,
+                    job.height,
+                    mip_levels
+                );
+            } else {
+                m_upload_batcher->release_image(
+                    texture.image,
+                    vk::ImageLayout::eTransferDstOptimal,
+                    vk::ImageLayout::eShaderReadOnlyOptimal,
+                    vk::PipelineStageFlagBits2::eFragmentShader,
+                    vk::AccessFlagBits2::eShaderSampledRead
+                );
+            }
+
+            texture.image_view = vht::create_image_view(
+                m_device->device(),
+                texture.image,
+                job.format,
+                vk::ImageAspectFlagBits::eColor,
+                mip_levels
+            );
+            job.slot = TextureSlot{ m_texture_table->register_texture(texture.image_view), m_sampler_index };
+            if (job.first_level > 0) {
+                m_texture_streamer->add(job.slot->texture, std::move(*job.cache), std::move(texture), job.first_level);
+            } else {
+                m_textures.push_back(std::move(texture));
+            }
+        }
+    };
+
+}
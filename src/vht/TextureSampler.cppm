@@ -1,12 +1,18 @@
 export module TextureSampler;
 
 import std;
-import stbi;
 import vulkan_hpp;
 
+import Config;
 import Tools;
 import Device;
-import CommandPool;
+import MemoryAllocator;
+import UploadBatcher;
+import MipmapGenerator;
+import TextureCache;
+import TextureBaker;
+import BlockCompressor;
+import TextureTable;
 
 // 纹理路径
 const std::string TEXTURE_PATH = "textures/viking_room.png";
@@ -18,25 +24,53 @@ export namespace vht {
      * @details
      * - 依赖：
      *  - m_device: 逻辑设备与队列
-     *  - m_command_pool: 命令池
+     *  - m_allocator: 设备内存分配器
+     *  - m_upload_batcher: 上传命令批处理
+     *  - m_mipmap_generator: mip 链生成
+     *  - m_texture_table: 无绑定纹理表
      * - 工作：
-     *  - 创建纹理图像、图像视图和采样器
+     *  - 创建纹理图像、图像视图和采样器（仅记录上传命令，由调用者统一提交）
+     *  - 优先内存映射预烘焙的纹理容器，各层级直接复制到暂存区；
+     *    容器不存在或已过期时用 stbi 解码并烘焙，写入容器供下次使用
+     *  - TEXTURE_MIPMAPS 开启时使用完整的 mip 链，容器中的层级不足时在 GPU 上生成，
+     *    采样器的 LOD 范围覆盖所有层级
+     *  - 设备支持时使用 TEXTURE_COMPRESSION 指定的块压缩格式，压缩结果写入容器，
+     *    每个纹理只压缩一次；块压缩纹理无法在 GPU 上生成 mip，只使用容器中的层级
+     *  - 将图像视图与采样器注册到纹理表
      * - 可访问成员：
      *  - image(): 获取纹理图像
      *  - image_view(): 获取纹理图像视图
      *  - sampler(): 获取纹理采样器
+     *  - mip_levels(): 获取纹理的 mip 层数
+     *  - texture_index(): 纹理在纹理表中的槽位
+     *  - sampler_index(): 采样器在纹理表中的槽位
      */
     class TextureSampler {
         std::shared_ptr<vht::Device> m_device;
-        std::shared_ptr<vht::CommandPool> m_command_pool;
-        vk::raii::DeviceMemory m_memory{ nullptr };
+        std::shared_ptr<vht::MemoryAllocator> m_allocator;
+        std::shared_ptr<vht::UploadBatcher> m_upload_batcher;
+        std::shared_ptr<vht::MipmapGenerator> m_mipmap_generator;
+        std::shared_ptr<vht::TextureTable> m_texture_table;
+        std::uint32_t m_texture_index{ 0 };
+        std::uint32_t m_sampler_index{ 0 };
+        vk::Format m_format{ vk::Format::eUndefined };
+        std::uint32_t m_mip_levels{ 1 };
+        vht::Allocation m_allocation{ nullptr };
         vk::raii::Image m_image{ nullptr };
         vk::raii::ImageView m_image_view{ nullptr };
         vk::raii::Sampler m_sampler{ nullptr };
     public:
-        explicit TextureSampler(std::shared_ptr<vht::Device> device, std::shared_ptr<vht::CommandPool> command_pool)
-        :   m_device(std::move(device)),
-            m_command_pool(std::move(command_pool)) {
+        explicit TextureSampler(
+            std::shared_ptr<vht::Device> device,
+            std::shared_ptr<vht::MemoryAllocator> allocator,
+            std::shared_ptr<vht::UploadBatcher> upload_batcher,
+            std::shared_ptr<vht::MipmapGenerator> mipmap_generator,
+            std::shared_ptr<vht::TextureTable> texture_table
+        ):  m_device(std::move(device)),
+            m_allocator(std::move(allocator)),
+            m_upload_batcher(std::move(upload_batcher)),
+            m_mipmap_generator(std::move(mipmap_generator)),
+            m_texture_table(std::move(texture_table)) {
             init();
         }
 
@@ -46,92 +80,146 @@ export namespace vht {
         const vk::raii::ImageView& image_view() const { return m_image_view; }
         [[nodiscard]]
         const vk::raii::Sampler& sampler() const { return m_sampler; }
+        [[nodiscard]]
+        std::uint32_t mip_levels() const { return m_mip_levels; }
+        [[nodiscard]]
+        std::uint32_t texture_index() const { return m_texture_index; }
+        [[nodiscard]]
+        std::uint32_t sampler_index() const { return m_sampler_index; }
 
     private:
         void init() {
             create_texture_image();
             create_texture_image_view();
             create_texture_sampler();
+            register_texture();
         }
-        // 创建纹理图像
+        // 设备支持采样与线性过滤时使用配置的压缩格式，否则不压缩
+        [[nodiscard]]
+        vht::TextureCompression texture_compression() const {
+            if (TEXTURE_COMPRESSION == vht::TextureCompression::eNone) return TEXTURE_COMPRESSION;
+            const auto format = vht::texture_format(TEXTURE_COMPRESSION);
+            if (m_device->format_supported(format,
+                vk::FormatFeatureFlagBits::eSampledImage | vk::FormatFeatureFlagBits::eSampledImageFilterLinear |
+                vk::FormatFeatureFlagBits::eTransferDst
+            )) return TEXTURE_COMPRESSION;
+            std::println("texture compression format {} unsupported, using uncompressed", vk::to_string(format));
+            return vht::TextureCompression::eNone;
+        }
+        // 创建纹理图像：优先从纹理容器加载，未命中时解码图片并写入容器
         void create_texture_image() {
-            int tex_width, tex_height, tex_channels;
-            stbi::uc* pixels = stbi::load(TEXTURE_PATH.c_str(), &tex_width, &tex_height, &tex_channels, stbi::RGB_ALPHA);
-
-            if (!pixels) {
-                throw std::runtime_error("failed to load texture image!");
+            const auto start_time = std::chrono::steady_clock::now();
+            const auto compression = texture_compression();
+            std::optional<vht::TextureCache> cache = vht::TextureCache::load(TEXTURE_PATH);
+            // 容器的格式与当前使用的格式不同时重新烘焙
+            if (cache && cache->image().format != vht::texture_format(compression)) cache.reset();
+            std::optional<vht::BakedTexture> baked;
+            if (!cache) {
+                baked = vht::bake_texture(TEXTURE_PATH, TEXTURE_MIPMAPS, compression);
+                vht::TextureCache::store(TEXTURE_PATH, baked->image());
             }
-            const vk::DeviceSize image_size = tex_width * tex_height * 4;
-
-            vk::raii::DeviceMemory staging_memory{ nullptr };
-            vk::raii::Buffer staging_buffer{ nullptr };
-
-            vht::create_buffer(
-                staging_buffer,
-                staging_memory,
-                m_device->device(),
-                m_device->physical_device(),
-                image_size,
-                vk::BufferUsageFlagBits::eTransferSrc,
-                vk::MemoryPropertyFlagBits::eHostVisible |
-                vk::MemoryPropertyFlagBits::eHostCoherent
-            );
-
-            void* data = staging_memory.mapMemory(0, image_size);
-            std::memcpy(data, pixels, static_cast<std::size_t>(image_size));
-            staging_memory.unmapMemory();
+            const vht::TextureImage texture = cache ? cache->image() : baked->image();
+            upload_texture(texture);
+            const auto end_time = std::chrono::steady_clock::now();
+            std::println("texture loaded{}: {}x{} {}, {} levels, {:.2f} ms",
+                cache ? " from cache" : "", texture.width, texture.height, vk::to_string(texture.format), texture.levels.size(),
+                std::chrono::duration<double, std::milli>(end_time - start_time).count());
+        }
+        /**
+         * @brief 创建图像并记录各层级的上传，容器中的层级不足时在 GPU 上生成 mip 链
+         * @details
+         * 块压缩格式的每一级按整块复制：暂存区偏移按 16 字节对齐（BC 块大小的倍数），
+         * bufferRowLength 为 0 表示按块紧密排列，imageExtent 使用层级的实际尺寸，
+         * 尺寸不足一块的末尾层级也合法
+         */
+        void upload_texture(const vht::TextureImage& texture) {
+            m_format = texture.format;
+            const bool compressed = vht::is_block_compressed(m_format);
+            m_mip_levels = TEXTURE_MIPMAPS ? vht::mip_level_count(texture.width, texture.height) : 1;
+            // 块压缩格式无法作为 blit 或存储图像的目标，只使用已有的层级
+            if (compressed) m_mip_levels = std::min(static_cast<std::uint32_t>(texture.levels.size()), m_mip_levels);
+            const auto provided_levels = std::min(static_cast<std::uint32_t>(texture.levels.size()), m_mip_levels);
+            const bool generate = provided_levels < m_mip_levels;
 
-            stbi::image_free(pixels);
+            vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+            vk::ImageCreateFlags flags;
+            if (generate) {
+                usage |= m_mipmap_generator->image_usage(m_format);
+                flags = m_mipmap_generator->image_flags(m_format);
+            }
 
             vht::create_image(
                 m_image,
-                m_memory,
+                m_allocation,
                 m_device->device(),
-                m_device->physical_device(),
-                tex_width,
-                tex_height,
-                vk::Format::eR8G8B8A8Srgb,
+                *m_allocator,
+                texture.width,
+                texture.height,
+                m_format,
                 vk::ImageTiling::eOptimal,
-                vk::ImageUsageFlagBits::eTransferDst |
-                vk::ImageUsageFlagBits::eSampled,
-                vk::MemoryPropertyFlagBits::eDeviceLocal
+                usage,
+                vk::MemoryPropertyFlagBits::eDeviceLocal,
+                m_mip_levels,
+                flags
             );
 
-            vht::transition_image_layout(
-                m_command_pool->pool(),
-                m_device->device(),
-                m_device->graphics_queue(),
+            m_upload_batcher->transition_image_layout(
                 m_image,
                 vk::ImageLayout::eUndefined,
-                vk::ImageLayout::eTransferDstOptimal
-            );
-
-            vht::copy_buffer_to_image(
-                m_command_pool->pool(),
-                m_device->device(),
-                m_device->graphics_queue(),
-                staging_buffer,
-                m_image,
-                static_cast<std::uint32_t>(tex_width),
-                static_cast<std::uint32_t>(tex_height)
-            );
-
-            vht::transition_image_layout(
-                m_command_pool->pool(),
-                m_device->device(),
-                m_device->graphics_queue(),
-                m_image,
                 vk::ImageLayout::eTransferDstOptimal,
-                vk::ImageLayout::eReadOnlyOptimal
+                m_mip_levels
             );
+            // 容器中的像素直接复制到暂存区，不经过解码
+            for (std::uint32_t level = 0; level < provided_levels; ++level) {
+                const auto width = std::max(texture.width >> level, 1u);
+                const auto height = std::max(texture.height >> level, 1u);
+                if (texture.levels[level].size() != vht::level_size(m_format, width, height)) {
+                    throw std::runtime_error("texture level size does not match its format!");
+                }
+                m_upload_batcher->upload_image(
+                    texture.levels[level].data(),
+                    texture.levels[level].size(),
+                    m_image,
+                    width,
+                    height,
+                    level
+                );
+            }
+            if (generate) {
+                // 所有层级保持 TransferDstOptimal 交给图形队列族，blit 与计算着色器只能在图形队列上执行
+                m_upload_batcher->release_image(
+                    m_image,
+                    vk::ImageLayout::eTransferDstOptimal,
+                    vk::ImageLayout::eTransferDstOptimal,
+                    vk::PipelineStageFlagBits2::eTransfer,
+                    vk::AccessFlagBits2::eTransferRead | vk::AccessFlagBits2::eTransferWrite
+                );
+                m_mipmap_generator->generate(
+                    m_upload_batcher->graphics_command_buffer(),
+                    m_image,
+                    m_format,
+                    texture.width,
+                    texture.height,
+                    m_mip_levels
+                );
+            } else {
+                m_upload_batcher->release_image(
+                    m_image,
+                    vk::ImageLayout::eTransferDstOptimal,
+                    vk::ImageLayout::eShaderReadOnlyOptimal,
+                    vk::PipelineStageFlagBits2::eFragmentShader,
+                    vk::AccessFlagBits2::eShaderSampledRead
+                );
+            }
         }
         // 创建纹理图像视图
         void create_texture_image_view() {
             m_image_view = vht::create_image_view(
                 m_device->device(),
                 m_image,
-                vk::Format::eR8G8B8A8Srgb,
-                vk::ImageAspectFlagBits::eColor
+                m_format,
+                vk::ImageAspectFlagBits::eColor,
+                m_mip_levels
             );
         }
         // 创建纹理采样器
@@ -160,9 +248,14 @@ export namespace vht {
             create_info.mipmapMode = vk::SamplerMipmapMode::eLinear;
             create_info.mipLodBias = 0.0f;
             create_info.minLod = 0.0f;
-            create_info.maxLod = 0.0f;
+            create_info.maxLod = static_cast<float>(m_mip_levels);
             m_sampler = m_device->device().createSampler(create_info);
         }
+        // 注册到纹理表，上传完成前绘制不会引用这个槽位
+        void register_texture() {
+            m_texture_index = m_texture_table->register_texture(m_image_view);
+            m_sampler_index = m_texture_table->register_sampler(m_sampler);
+        }
 
     };
 }
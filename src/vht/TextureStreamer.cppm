@@ -0,0 +1,435 @@
+export module TextureStreamer;
+
+import std;
+import glm;
+import vulkan_hpp;
+
+import Config;
+import Tools;
+import Device;
+import MemoryAllocator;
+import StagingRing;
+import UploadBatcher;
+import InputAssembly;
+import UniformBuffer;
+import TextureCache;
+import TextureTable;
+
+export namespace vht {
+
+    /**
+     * @brief 一个纹理的 GPU 资源
+     * @details 成员按声明的逆序销毁：先销毁视图和图像，再释放内存
+     */
+    struct TextureResource {
+        vht::Allocation allocation{ nullptr };
+        vk::raii::Image image{ nullptr };
+        vk::raii::ImageView image_view{ nullptr };
+    };
+
+    /**
+     * @brief 加载时常驻的第一个层级：尺寸不超过 TEXTURE_STREAMING_INITIAL_SIZE 的最精细层级
+     */
+    [[nodiscard]]
+    std::uint32_t streaming_initial_level(const std::uint32_t width, const std::uint32_t height, const std::uint32_t level_count) {
+        std::uint32_t level = 0;
+        while (level + 1 < level_count && std::max(width >> level, height >> level) > TEXTURE_STREAMING_INITIAL_SIZE) ++level;
+        return level;
+    }
+
+}
+
+namespace vht {
+
+    /**
+     * @brief 一个流送中的纹理
+     * @details
+     * - source: 内存映射的纹理容器，包含完整的 mip 链，流送时从这里复制
+     * - slots: 在纹理表中占用的两个槽位，新图像写入当前未使用的槽位后再切换，
+     *   被切换出去的槽位在 MAX_FRAMES_IN_FLIGHT 帧后才会再次写入，不会改写执行中的命令正在使用的描述符
+     * - first_level: 当前常驻的最精细层级，常驻层级为 [first_level, level_count)
+     * - initial_level: 加载时常驻的层级，驱逐不会低于它，保证可见的纹理始终有可用的 mip
+     * - desired_level: 根据屏幕上的尺寸计算的目标层级
+     */
+    struct StreamedTexture {
+        TextureCache source;
+        TextureResource resource;
+        std::array<std::uint32_t, 2> slots{};
+        std::uint32_t current{ 0 };
+        std::uint32_t level_count{};
+        std::uint32_t first_level{};
+        std::uint32_t initial_level{};
+        std::uint32_t desired_level{};
+        std::uint64_t last_used{ 0 };           // 最近一次被绘制的帧
+        std::uint64_t swapped{ 0 };             // 最近一次切换槽位的帧
+        bool pending{ false };
+    };
+
+    // 一次层级变化，上传完成后切换到新的资源
+    struct StreamingChange {
+        std::size_t texture{};
+        std::uint32_t first_level{};
+        TextureResource resource;
+    };
+
+    // 等待执行中的帧结束后再销毁的资源
+    struct RetiredTexture {
+        std::uint64_t frame{};
+        TextureResource resource;
+    };
+
+}
+
+export namespace vht {
+
+    /**
+     * @brief 纹理常驻流送
+     * @details
+     * - 依赖：
+     *  - m_device: 逻辑设备
+     *  - m_allocator: 设备内存分配器
+     *  - m_texture_table: 无绑定纹理表
+     * - 工作：
+     *  - 加载时只上传低分辨率的层级（见 streaming_initial_level()），图像只包含常驻的层级，
+     *    不常驻的层级不占用显存
+     *  - 每帧根据相机计算各纹理在屏幕上的尺寸，在之后的帧中逐级上传更精细的层级：
+     *    创建包含新层级的图像，只从内存映射的容器上传新增的层级，仍常驻的层级在图形队列上从旧图像复制，
+     *    上传完成后切换纹理表中的槽位；暂存环没有空间时本帧跳过，渲染循环不等待 GPU
+     *  - 常驻字节数超过 TEXTURE_STREAMING_BUDGET 时按最近使用时间（LRU）降级其他纹理，
+     *    最多降到加载时的层级
+     *  - 使用自己的暂存环和上传批处理，一次只有一批上传在执行；绘制提交需等待 semaphore() 到达 ready_value()
+     *  - 被替换的图像在 MAX_FRAMES_IN_FLIGHT 帧后销毁
+     * - 使用方式：
+     *  - add() 接管已上传初始层级的纹理，返回的槽位作为绘制使用的稳定槽位
+     *  - 每帧调用 update()，记录绘制命令时用 resolve() 把稳定槽位换成当前槽位
+     * - 可访问成员：
+     *  - semaphore(): 流送上传的时间线信号量
+     *  - ready_value(): 已切换的上传对应的时间线值
+     *  - resident_bytes(): 常驻层级的字节数
+     *  - texture_count(): 流送中的纹理数量
+     */
+    class TextureStreamer {
+        std::shared_ptr<vht::Device> m_device{ nullptr };
+        std::shared_ptr<vht::MemoryAllocator> m_allocator{ nullptr };
+        std::shared_ptr<vht::TextureTable> m_texture_table{ nullptr };
+        std::shared_ptr<vht::StagingRing> m_staging_ring{ nullptr };
+        std::shared_ptr<vht::UploadBatcher> m_upload_batcher{ nullptr };
+        std::vector<StreamedTexture> m_textures;
+        std::unordered_map<std::uint32_t, std::size_t> m_lookup;    // 稳定槽位到 m_textures 的下标
+        std::vector<StreamingChange> m_pending;
+        std::uint64_t m_pending_value{ 0 };
+        std::deque<RetiredTexture> m_retired;
+        std::uint64_t m_ready_value{ 0 };
+        std::uint64_t m_resident_bytes{ 0 };
+        std::uint64_t m_frame{ 0 };
+    public:
+        explicit TextureStreamer(
+            std::shared_ptr<vht::Device> device,
+            std::shared_ptr<vht::MemoryAllocator> allocator,
+            std::shared_ptr<vht::TextureTable> texture_table
+        ):  m_device(std::move(device)),
+            m_allocator(std::move(allocator)),
+            m_texture_table(std::move(texture_table)) {
+            init();
+        }
+        ~TextureStreamer() {
+            m_upload_batcher->wait(m_upload_batcher->submitted_value());
+        }
+        TextureStreamer(const TextureStreamer&) = delete;
+        TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+        [[nodiscard]]
+        const vk::raii::Semaphore& semaphore() const { return m_staging_ring->semaphore(); }
+        [[nodiscard]]
+        std::uint64_t ready_value() const { return m_ready_value; }
+        [[nodiscard]]
+        std::uint64_t resident_bytes() const { return m_resident_bytes; }
+        [[nodiscard]]
+        std::size_t texture_count() const { return m_textures.size(); }
+
+        /**
+         * @brief 接管一个纹理
+         * @param slot 已注册 resource 的槽位，绘制始终使用这个槽位
+         * @param source 包含完整 mip 链的纹理容器
+         * @param first_level resource 中的第一个层级
+         */
+        void add(const std::uint32_t slot, TextureCache source, TextureResource resource, const std::uint32_t first_level) {
+            const auto image = source.image();
+            StreamedTexture texture{ std::move(source), std::move(resource) };
+            texture.slots = { slot, m_texture_table->reserve_texture() };
+            texture.level_count = static_cast<std::uint32_t>(image.levels.size());
+            texture.first_level = first_level;
+            texture.initial_level = first_level;
+            texture.desired_level = first_level;
+            m_resident_bytes += resident_size(texture, first_level);
+            m_lookup.emplace(slot, m_textures.size());
+            m_textures.push_back(std::move(texture));
+        }
+
+        // 稳定槽位对应的当前槽位，不是流送纹理的槽位原样返回
+        [[nodiscard]]
+        std::uint32_t resolve(const std::uint32_t slot) const {
+            const auto it = m_lookup.find(slot);
+            if (it == m_lookup.end()) return slot;
+            const auto& texture = m_textures[it->second];
+            return texture.slots[texture.current];
+        }
+
+        /**
+         * @brief 每帧调用：切换已完成的上传、计算目标层级并安排新的上传
+         * @param draws 本帧绘制的网格
+         * @param ubo 本帧的变换矩阵
+         * @param extent 交换链尺寸
+         */
+        void update(const std::span<const MeshDraw> draws, const UBO& ubo, const vk::Extent2D extent) {
+            ++m_frame;
+            while (!m_retired.empty() && m_retired.front().frame <= m_frame) m_retired.pop_front();
+            if (!m_pending.empty() && m_staging_ring->is_complete(m_pending_value)) finish_pending();
+            update_desired_levels(draws, ubo, extent);
+            if (m_pending.empty()) schedule();
+        }
+
+    private:
+        void init() {
+            m_staging_ring = std::make_shared<vht::StagingRing>(m_device, m_allocator);
+            m_upload_batcher = std::make_shared<vht::UploadBatcher>(m_device, m_staging_ring);
+        }
+
+        // [first_level, level_count) 的字节数
+        [[nodiscard]]
+        static std::uint64_t resident_size(const StreamedTexture& texture, const std::uint32_t first_level) {
+            const auto image = texture.source.image();
+            std::uint64_t size = 0;
+            for (std::uint32_t level = first_level; level < texture.level_count; ++level) size += image.levels[level].size();
+            return size;
+        }
+
+        // 距离上次切换已过 MAX_FRAMES_IN_FLIGHT 帧，另一个槽位不再被执行中的命令使用
+        [[nodiscard]]
+        bool can_swap(const StreamedTexture& texture) const {
+            return !texture.pending && m_frame >= texture.swapped + MAX_FRAMES_IN_FLIGHT;
+        }
+
+        /**
+         * @brief 根据包围球在屏幕上的直径计算每个纹理需要的层级
+         * @details 假设纹理坐标覆盖整个网格一次，直径为 d 像素时只需要约 d 像素宽的层级
+         */
+        void update_desired_levels(const std::span<const MeshDraw> draws, const UBO& ubo, const vk::Extent2D extent) {
+            for (auto& texture : m_textures) texture.desired_level = texture.level_count - 1;
+            const glm::vec3 camera = glm::vec3(glm::inverse(ubo.view)[3]);
+            for (const auto& draw : draws) {
+                const auto it = m_lookup.find(draw.texture_index);
+                if (it == m_lookup.end() || draw.lods.empty()) continue;
+                auto& texture = m_textures[it->second];
+                texture.last_used = m_frame;
+
+                const glm::mat4 model = ubo.model * draw.transform;
+                const float scale = std::max({
+                    glm::length(glm::vec3(model[0])),
+                    glm::length(glm::vec3(model[1])),
+                    glm::length(glm::vec3(model[2]))
+                });
+                const glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(draw.bounds), 1.0f));
+                const float distance = glm::length(camera - center) - draw.bounds.w * scale;
+                std::uint32_t level = 0;
+                if (distance > 0.0f) {
+                    // proj[1][1] 为 cot(fov / 2)，与 Drawer 中 LOD 选择的计算相同
+                    const float pixels_per_unit = std::abs(ubo.proj[1][1]) * 0.5f * static_cast<float>(extent.height) / distance;
+                    const float diameter = std::max(2.0f * draw.bounds.w * scale * pixels_per_unit, 1.0f);
+                    const auto image = texture.source.image();
+                    const float ratio = static_cast<float>(std::max(image.width, image.height)) / diameter;
+                    level = ratio > 1.0f ? static_cast<std::uint32_t>(std::floor(std::log2(ratio))) : 0;
+                }
+                texture.desired_level = std::min({ texture.desired_level, level, texture.level_count - 1 });
+            }
+        }
+
+        /**
+         * @brief 安排下一批上传
+         * @details 选择可见且与目标层级相差最多的纹理提高一级；超出预算时先按 LRU 降级其他纹理，
+         * 可见的纹理只降到目标层级，不可见的降到加载时的层级；仍然放不下时本帧不上传
+         */
+        void schedule() {
+            std::optional<std::size_t> upgrade;
+            std::uint32_t best_deficit = 0;
+            for (std::size_t i = 0; i < m_textures.size(); ++i) {
+                const auto& texture = m_textures[i];
+                if (texture.last_used != m_frame || texture.desired_level >= texture.first_level || !can_swap(texture)) continue;
+                if (const auto deficit = texture.first_level - texture.desired_level; deficit > best_deficit) {
+                    best_deficit = deficit;
+                    upgrade = i;
+                }
+            }
+            if (!upgrade) return;
+            const auto& target = m_textures[*upgrade];
+            const std::uint32_t upgrade_level = target.first_level - 1;
+            const std::uint64_t extra = target.source.image().levels[upgrade_level].size();
+
+            std::vector<std::pair<std::size_t, std::uint32_t>> downgrades;
+            std::uint64_t resident = m_resident_bytes;
+            if (resident + extra > TEXTURE_STREAMING_BUDGET) {
+                std::vector<std::size_t> order;
+                for (std::size_t i = 0; i < m_textures.size(); ++i) {
+                    if (i != *upgrade && can_swap(m_textures[i])) order.push_back(i);
+                }
+                std::ranges::sort(order, {}, [this](const std::size_t i) { return m_textures[i].last_used; });
+                for (const auto i : order) {
+                    const auto& texture = m_textures[i];
+                    const std::uint32_t level = texture.last_used == m_frame
+                        ? std::max(texture.first_level, std::min(texture.desired_level, texture.initial_level))
+                        : texture.initial_level;
+                    if (level <= texture.first_level) continue;
+                    resident -= resident_size(texture, texture.first_level) - resident_size(texture, level);
+                    downgrades.emplace_back(i, level);
+                    if (resident + extra <= TEXTURE_STREAMING_BUDGET) break;
+                }
+                if (resident + extra > TEXTURE_STREAMING_BUDGET) return;
+            }
+
+            // 一次只有一批上传在执行，且只在它完成后才安排下一批，预留不会等待 GPU；空间不足时本帧跳过
+            const auto& data = target.source.image().levels[upgrade_level];
+            const auto region = m_upload_batcher->try_reserve(data.size());
+            if (!region) return;
+            std::memcpy(region->data, data.data(), data.size());
+
+            for (const auto& [index, level] : downgrades) record_change(index, level, nullptr);
+            record_change(*upgrade, upgrade_level, &*region);
+            m_pending_value = m_upload_batcher->submit();
+        }
+
+        /**
+         * @brief 创建只包含 [first_level, level_count) 的图像并记录上传
+         * @param region 提高一级时为新增层级 first_level 的暂存数据，降级时为空
+         * @details 新增的层级在传输命令中从暂存区复制；与旧图像共有的层级在图形命令中从旧图像复制，
+         * 复制期间旧图像临时转换为 TransferSrcOptimal，之前和之后的帧按队列顺序与之同步
+         */
+        void record_change(const std::size_t index, const std::uint32_t first_level, const StagingRegion* region) {
+            auto& texture = m_textures[index];
+            const auto image = texture.source.image();
+            const std::uint32_t width = std::max(image.width >> first_level, 1u);
+            const std::uint32_t height = std::max(image.height >> first_level, 1u);
+            const std::uint32_t mip_levels = texture.level_count - first_level;
+            // 两个图像共有的层级 [kept_level, level_count)
+            const std::uint32_t kept_level = std::max(first_level, texture.first_level);
+
+            TextureResource resource;
+            vht::create_image(
+                resource.image,
+                resource.allocation,
+                m_device->device(),
+                *m_allocator,
+                width,
+                height,
+                image.format,
+                vk::ImageTiling::eOptimal,
+                vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+                vk::MemoryPropertyFlagBits::eDeviceLocal,
+                mip_levels
+            );
+            m_upload_batcher->transition_image_layout(
+                resource.image,
+                vk::ImageLayout::eUndefined,
+                vk::ImageLayout::eTransferDstOptimal,
+                mip_levels
+            );
+            if (region) m_upload_batcher->copy_buffer_to_image(*region, resource.image, width, height, 0);
+            m_upload_batcher->release_image(
+                resource.image,
+                vk::ImageLayout::eTransferDstOptimal,
+                vk::ImageLayout::eTransferDstOptimal,
+                vk::PipelineStageFlagBits2::eTransfer,
+                vk::AccessFlagBits2::eTransferWrite
+            );
+            copy_kept_levels(texture, resource, first_level, kept_level);
+
+            resource.image_view = vht::create_image_view(
+                m_device->device(),
+                resource.image,
+                image.format,
+                vk::ImageAspectFlagBits::eColor,
+                mip_levels
+            );
+            texture.pending = true;
+            m_resident_bytes += resident_size(texture, first_level);
+            m_resident_bytes -= resident_size(texture, texture.first_level);
+            m_pending.emplace_back(index, first_level, std::move(resource));
+        }
+
+        // 在图形命令中把 [kept_level, level_count) 从旧图像复制到新图像，并把新图像转换为着色器只读布局
+        void copy_kept_levels(
+            const StreamedTexture& texture,
+            const TextureResource& resource,
+            const std::uint32_t first_level,
+            const std::uint32_t kept_level
+        ) {
+            const auto image = texture.source.image();
+            const auto& command_buffer = m_upload_batcher->graphics_command_buffer();
+            const vk::ImageSubresourceRange range{ vk::ImageAspectFlagBits::eColor, 0, vk::RemainingMipLevels, 0, 1 };
+
+            vk::ImageMemoryBarrier2 to_source;
+            to_source.image = texture.resource.image;
+            to_source.oldLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+            to_source.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+            to_source.srcStageMask = vk::PipelineStageFlagBits2::eFragmentShader;
+            to_source.srcAccessMask = vk::AccessFlagBits2::eShaderSampledRead;
+            to_source.dstStageMask = vk::PipelineStageFlagBits2::eTransfer;
+            to_source.dstAccessMask = vk::AccessFlagBits2::eTransferRead;
+            to_source.subresourceRange = range;
+            command_buffer.pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( to_source ) );
+
+            std::vector<vk::ImageCopy> regions;
+            for (std::uint32_t level = kept_level; level < texture.level_count; ++level) {
+                vk::ImageCopy copy;
+                copy.srcSubresource = { vk::ImageAspectFlagBits::eColor, level - texture.first_level, 0, 1 };
+                copy.dstSubresource = { vk::ImageAspectFlagBits::eColor, level - first_level, 0, 1 };
+                copy.extent = vk::Extent3D{ std::max(image.width >> level, 1u), std::max(image.height >> level, 1u), 1 };
+                regions.push_back(copy);
+            }
+            command_buffer.copyImage(
+                texture.resource.image, vk::ImageLayout::eTransferSrcOptimal,
+                resource.image, vk::ImageLayout::eTransferDstOptimal,
+                regions
+            );
+
+            // 旧图像在切换前仍被之后的帧采样
+            vk::ImageMemoryBarrier2 to_read = to_source;
+            to_read.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+            to_read.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+            to_read.srcStageMask = vk::PipelineStageFlagBits2::eTransfer;
+            to_read.srcAccessMask = vk::AccessFlagBits2::eNone;
+            to_read.dstStageMask = vk::PipelineStageFlagBits2::eFragmentShader;
+            to_read.dstAccessMask = vk::AccessFlagBits2::eShaderSampledRead;
+
+            vk::ImageMemoryBarrier2 ready;
+            ready.image = resource.image;
+            ready.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+            ready.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+            ready.srcStageMask = vk::PipelineStageFlagBits2::eTransfer;
+            ready.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+            ready.dstStageMask = vk::PipelineStageFlagBits2::eFragmentShader;
+            ready.dstAccessMask = vk::AccessFlagBits2::eShaderSampledRead;
+            ready.subresourceRange = range;
+
+            const auto barriers = { to_read, ready };
+            command_buffer.pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( barriers ) );
+        }
+
+        // 上传完成：把新图像写入空闲槽位并切换，旧图像等待执行中的帧结束后销毁
+        void finish_pending() {
+            for (auto& [index, first_level, resource] : m_pending) {
+                auto& texture = m_textures[index];
+                const std::uint32_t next = 1 - texture.current;
+                m_texture_table->write_texture(texture.slots[next], resource.image_view);
+                m_retired.emplace_back(m_frame + MAX_FRAMES_IN_FLIGHT, std::move(texture.resource));
+                texture.resource = std::move(resource);
+                texture.current = next;
+                texture.first_level = first_level;
+                texture.swapped = m_frame;
+                texture.pending = false;
+            }
+            m_pending.clear();
+            m_ready_value = m_pending_value;
+        }
+    };
+
+}
@@ -0,0 +1,182 @@
+export module TextureTable;
+
+import std;
+import vulkan_hpp;
+
+import Config;
+import Device;
+
+export namespace vht {
+
+    /**
+     * @brief 绘制使用的纹理表槽位
+     * @details
+     * - texture: 纹理槽位
+     * - sampler: 采样器槽位
+     */
+    struct TextureSlot {
+        std::uint32_t texture{};
+        std::uint32_t sampler{};
+    };
+
+    /**
+     * @brief 无绑定纹理表
+     * @details
+     * - 依赖：
+     *  - m_device: 逻辑设备
+     * - 工作：
+     *  - 创建描述符集 1：绑定 0 为 BINDLESS_TEXTURE_CAPACITY 个采样图像，绑定 1 为 BINDLESS_SAMPLER_CAPACITY 个采样器，
+     *    两个绑定都允许部分绑定与绑定后更新，未注册的槽位不需要写入
+     *  - 纹理与采样器加载时注册到槽位，着色器通过推送常量中的索引访问，切换材质不需要重新绑定描述符集
+     *  - 绑定后更新只要求正在执行的命令不访问被写入的槽位，注册新纹理不需要等待设备空闲；
+     *    纹理绑定允许在使用集合的命令执行期间写入未使用的槽位，流送时先写入空闲槽位再切换
+     * - 可访问成员：
+     *  - set_layout(): 描述符集布局
+     *  - set(): 描述符集，整帧只绑定一次
+     *  - register_texture(): 注册纹理图像视图，返回槽位
+     *  - reserve_texture(): 预留一个纹理槽位，稍后用 write_texture() 写入
+     *  - write_texture(): 写入纹理槽位
+     *  - register_sampler(): 注册采样器，返回槽位
+     *  - texture_count(): 已注册的纹理数量
+     */
+    class TextureTable {
+        std::shared_ptr<vht::Device> m_device{ nullptr };
+        vk::raii::DescriptorSetLayout m_set_layout{ nullptr };
+        vk::raii::DescriptorPool m_pool{ nullptr };
+        vk::raii::DescriptorSet m_set{ nullptr };
+        std::uint32_t m_texture_count{ 0 };
+        std::uint32_t m_sampler_count{ 0 };
+    public:
+        explicit TextureTable(std::shared_ptr<vht::Device> device)
+        :   m_device(std::move(device)) {
+            init();
+        }
+
+        [[nodiscard]]
+        const vk::raii::DescriptorSetLayout& set_layout() const { return m_set_layout; }
+        [[nodiscard]]
+        const vk::raii::DescriptorSet& set() const { return m_set; }
+        [[nodiscard]]
+        std::uint32_t texture_count() const { return m_texture_count; }
+
+        /**
+         * @brief 注册纹理图像视图
+         * @details 图像需处于 ShaderReadOnlyOptimal 布局后才能被着色器访问
+         * @throw std::runtime_error 纹理表已满
+         */
+        std::uint32_t register_texture(const vk::ImageView image_view) {
+            const std::uint32_t slot = reserve_texture();
+            write_texture(slot, image_view);
+            return slot;
+        }
+
+        /**
+         * @brief 预留纹理槽位，不写入描述符
+         * @details 部分绑定允许着色器不访问的槽位保持未写入
+         * @throw std::runtime_error 纹理表已满
+         */
+        std::uint32_t reserve_texture() {
+            if (m_texture_count == BINDLESS_TEXTURE_CAPACITY) throw std::runtime_error("bindless texture table is full!");
+            return m_texture_count++;
+        }
+
+        /**
+         * @brief 写入纹理槽位
+         * @warning 执行中的命令不能访问该槽位
+         */
+        void write_texture(const std::uint32_t slot, const vk::ImageView image_view) const {
+            vk::DescriptorImageInfo image_info;
+            image_info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+            image_info.imageView = image_view;
+            write(0, slot, vk::DescriptorType::eSampledImage, image_info);
+        }
+
+        /**
+         * @brief 注册采样器
+         * @throw std::runtime_error 采样器表已满
+         */
+        std::uint32_t register_sampler(const vk::Sampler sampler) {
+            if (m_sampler_count == BINDLESS_SAMPLER_CAPACITY) throw std::runtime_error("bindless sampler table is full!");
+            vk::DescriptorImageInfo image_info;
+            image_info.sampler = sampler;
+            write(1, m_sampler_count, vk::DescriptorType::eSampler, image_info);
+            return m_sampler_count++;
+        }
+
+    private:
+        void init() {
+            create_set_layout();
+            create_pool();
+            allocate_set();
+        }
+        // 创建描述符集布局，绑定顺序与 shaders/graphics.frag.glsl 一致
+        void create_set_layout() {
+            std::array<vk::DescriptorSetLayoutBinding, 2> bindings;
+            bindings[0].binding = 0;
+            bindings[0].descriptorType = vk::DescriptorType::eSampledImage;
+            bindings[0].descriptorCount = BINDLESS_TEXTURE_CAPACITY;
+            bindings[0].stageFlags = vk::ShaderStageFlagBits::eFragment;
+            bindings[1].binding = 1;
+            bindings[1].descriptorType = vk::DescriptorType::eSampler;
+            bindings[1].descriptorCount = BINDLESS_SAMPLER_CAPACITY;
+            bindings[1].stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+            constexpr vk::DescriptorBindingFlags binding_flags =
+                vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+            const std::array<vk::DescriptorBindingFlags, 2> flags{
+                binding_flags | vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending,
+                binding_flags
+            };
+
+            vk::StructureChain<
+                vk::DescriptorSetLayoutCreateInfo,
+                vk::DescriptorSetLayoutBindingFlagsCreateInfo
+            > create_info;
+            create_info.get()
+                .setFlags( vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool )
+                .setBindings( bindings );
+            create_info.get<vk::DescriptorSetLayoutBindingFlagsCreateInfo>()
+                .setBindingFlags( flags );
+
+            m_set_layout = m_device->device().createDescriptorSetLayout( create_info.get() );
+        }
+        // 创建描述符池，只分配一个集合
+        void create_pool() {
+            std::array<vk::DescriptorPoolSize, 2> pool_sizes;
+            pool_sizes[0].type = vk::DescriptorType::eSampledImage;
+            pool_sizes[0].descriptorCount = BINDLESS_TEXTURE_CAPACITY;
+            pool_sizes[1].type = vk::DescriptorType::eSampler;
+            pool_sizes[1].descriptorCount = BINDLESS_SAMPLER_CAPACITY;
+
+            vk::DescriptorPoolCreateInfo create_info;
+            create_info.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet |
+                                vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind;
+            create_info.setPoolSizes( pool_sizes );
+            create_info.maxSets = 1;
+
+            m_pool = m_device->device().createDescriptorPool( create_info );
+        }
+        void allocate_set() {
+            vk::DescriptorSetAllocateInfo alloc_info;
+            alloc_info.descriptorPool = m_pool;
+            alloc_info.setSetLayouts( *m_set_layout );
+            m_set = std::move(m_device->device().allocateDescriptorSets(alloc_info).at(0));
+        }
+        // 写入一个槽位
+        void write(
+            const std::uint32_t binding,
+            const std::uint32_t index,
+            const vk::DescriptorType type,
+            const vk::DescriptorImageInfo& image_info
+        ) const {
+            vk::WriteDescriptorSet write;
+            write.dstSet = m_set;
+            write.dstBinding = binding;
+            write.dstArrayElement = index;
+            write.descriptorType = type;
+            write.setImageInfo( image_info );
+            m_device->device().updateDescriptorSets(write, nullptr);
+        }
+    };
+
+}
@@ -4,6 +4,8 @@ export module Tools;
 import std;
 import vulkan_hpp;
 
+import MemoryAllocator;
+
 export namespace vht {
 
     // 读取 shader 代码
@@ -28,66 +30,28 @@ export namespace vht {
         return device.createShaderModule(create_info);
     }
 
-    // 创建单个命令缓冲区并开始记录命令
-    [[nodiscard]]
-    vk::raii::CommandBuffer begin_command(const vk::raii::CommandPool& command_pool, const vk::raii::Device& device) {
-        vk::CommandBufferAllocateInfo alloc_info;
-        alloc_info.level = vk::CommandBufferLevel::ePrimary;
-        alloc_info.commandPool = command_pool;
-        alloc_info.commandBufferCount = 1;
-
-        auto commandBuffers = device.allocateCommandBuffers(alloc_info);
-        vk::raii::CommandBuffer commandBuffer = std::move(commandBuffers.at(0));
-
-        commandBuffer.begin( { vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
-        return commandBuffer;
-    }
-
-    // 结束命令缓冲区并提交到队列
-    void end_command(const vk::raii::CommandBuffer& command_buffer, const vk::raii::Queue& queue) {
-        command_buffer.end();
-        vk::SubmitInfo submit_info;
-        submit_info.setCommandBuffers( *command_buffer );
-        queue.submit(submit_info);
-        queue.waitIdle();
-    }
-
-    // 根据物理设备和内存类型过滤器查找合适的内存类型
-    [[nodiscard]]
-    std::uint32_t findMemoryType(
-        const vk::raii::PhysicalDevice& physical_device,
-        const std::uint32_t type_filter,
-        const vk::MemoryPropertyFlags properties
-    ) {
-        const auto memProperties = physical_device.getMemoryProperties();
-        for(std::uint32_t i = 0; const auto& type : memProperties.memoryTypes){
-            if( (type_filter & (1 << i)) &&
-                (type.propertyFlags & properties ) == properties
-            ) return i;
-            ++i;
-        }
-        throw std::runtime_error("failed to find suitable memory type!");
-    }
-
     // 创建图像
     void create_image(
         vk::raii::Image& image,
-        vk::raii::DeviceMemory& image_memory,
+        vht::Allocation& image_allocation,
         const vk::raii::Device& device,
-        const vk::raii::PhysicalDevice& physical_device,
+        vht::MemoryAllocator& allocator,
         const std::uint32_t width,
         const std::uint32_t height,
         const vk::Format format,
         const vk::ImageTiling tiling,
         const vk::ImageUsageFlags usage,
-        const vk::MemoryPropertyFlags properties
+        const vk::MemoryPropertyFlags properties,
+        const std::uint32_t mip_levels = 1,
+        const vk::ImageCreateFlags flags = {}
     ) {
         vk::ImageCreateInfo create_info;
+        create_info.flags = flags;
         create_info.imageType = vk::ImageType::e2D;
         create_info.extent.width = width;
         create_info.extent.height = height;
         create_info.extent.depth = 1;
-        create_info.mipLevels = 1;
+        create_info.mipLevels = mip_levels;
         create_info.arrayLayers = 1;
         create_info.format = format;
         create_info.tiling = tiling;
@@ -97,39 +61,44 @@ export namespace vht {
         create_info.sharingMode = vk::SharingMode::eExclusive;
         image = device.createImage(create_info);
 
-        const vk::MemoryRequirements requirements = image.getMemoryRequirements();
-        vk::MemoryAllocateInfo allocInfo;
-        allocInfo.allocationSize = requirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(physical_device, requirements.memoryTypeBits, properties);
-        image_memory = device.allocateMemory(allocInfo);
+        image_allocation = allocator.allocate(
+            image.getMemoryRequirements(),
+            properties,
+            tiling == vk::ImageTiling::eLinear ? vht::ResourceKind::eLinear : vht::ResourceKind::eOptimal
+        );
 
-        image.bindMemory(image_memory, 0);
+        image.bindMemory(image_allocation.memory(), image_allocation.offset());
     }
 
     // 创建缓冲区
     void create_buffer(
         vk::raii::Buffer& buffer,
-        vk::raii::DeviceMemory& buffer_memory,
+        vht::Allocation& buffer_allocation,
         const vk::raii::Device& device,
-        const vk::raii::PhysicalDevice& physical_device,
+        vht::MemoryAllocator& allocator,
         const vk::DeviceSize size,
         const vk::BufferUsageFlags usage,
-        const vk::MemoryPropertyFlags properties
+        const vk::MemoryPropertyFlags properties,
+        const std::span<const std::uint32_t> queue_families = {} // 多于一个不同的队列族时以并发模式共享
     ) {
         vk::BufferCreateInfo create_info;
         create_info.size = size;
         create_info.usage = usage;
         create_info.sharingMode = vk::SharingMode::eExclusive;
+        if (queue_families.size() > 1 && queue_families.front() != queue_families.back()) {
+            create_info.sharingMode = vk::SharingMode::eConcurrent;
+            create_info.setQueueFamilyIndices( queue_families );
+        }
 
         buffer = device.createBuffer(create_info);
 
-        const vk::MemoryRequirements requirements = buffer.getMemoryRequirements();
-        vk::MemoryAllocateInfo alloc_info;
-        alloc_info.allocationSize = requirements.size;
-        alloc_info.memoryTypeIndex = findMemoryType(physical_device, requirements.memoryTypeBits, properties);
-        buffer_memory = device.allocateMemory( alloc_info );
+        buffer_allocation = allocator.allocate(
+            buffer.getMemoryRequirements(),
+            properties,
+            vht::ResourceKind::eLinear
+        );
 
-        buffer.bindMemory(buffer_memory, 0);
+        buffer.bindMemory(buffer_allocation.memory(), buffer_allocation.offset());
     }
 
     // 创建图像视图
@@ -138,77 +107,71 @@ export namespace vht {
         const vk::raii::Device& device,
         const vk::Image image,
         const vk::Format format,
-        const vk::ImageAspectFlags aspect_flags
+        const vk::ImageAspectFlags aspect_flags,
+        const std::uint32_t mip_levels = 1,
+        const std::uint32_t base_mip_level = 0
     ) {
         vk::ImageViewCreateInfo viewInfo;
         viewInfo.image = image;
         viewInfo.viewType = vk::ImageViewType::e2D;
         viewInfo.format = format;
         viewInfo.subresourceRange.aspectMask = aspect_flags;
-        viewInfo.subresourceRange.baseMipLevel = 0;
-        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseMipLevel = base_mip_level;
+        viewInfo.subresourceRange.levelCount = mip_levels;
         viewInfo.subresourceRange.baseArrayLayer = 0;
         viewInfo.subresourceRange.layerCount = 1;
         return device.createImageView(viewInfo);
     }
 
-    // 复制缓冲区内容到另一个缓冲区
+    // 记录缓冲区之间的复制命令
     void copy_buffer(
-        const vk::raii::CommandPool& command_pool,
-        const vk::raii::Device& device,
-        const vk::raii::Queue& queue,
+        const vk::raii::CommandBuffer& command_buffer,
         const vk::Buffer src_buffer,
+        const vk::DeviceSize src_offset,
         const vk::Buffer dst_buffer,
+        const vk::DeviceSize dst_offset,
         const vk::DeviceSize size
     )  {
-        const auto command_buffer = begin_command(command_pool, device);
-        const vk::BufferCopy region{ 0, 0, size };
+        const vk::BufferCopy region{ src_offset, dst_offset, size };
         command_buffer.copyBuffer(src_buffer, dst_buffer, region);
-        end_command( command_buffer , queue );
     }
 
-    // 将缓冲区内容复制到图像
+    // 记录缓冲区到图像的复制命令
     void copy_buffer_to_image(
-        const vk::raii::CommandPool& command_pool,
-        const vk::raii::Device& device,
-        const vk::raii::Queue& queue,
+        const vk::raii::CommandBuffer& command_buffer,
         const vk::Buffer buffer,
+        const vk::DeviceSize buffer_offset,
         const vk::Image image,
         const std::uint32_t width,
-        const std::uint32_t height
+        const std::uint32_t height,
+        const std::uint32_t mip_level = 0
     ) {
-        const auto commandBuffer = begin_command( command_pool, device) ;
         vk::BufferImageCopy region;
-        region.bufferOffset = 0;
+        region.bufferOffset = buffer_offset;
         region.bufferRowLength = 0;
         region.bufferImageHeight = 0;
         region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.mipLevel = mip_level;
         region.imageSubresource.baseArrayLayer = 0;
         region.imageSubresource.layerCount = 1;
         region.imageOffset = vk::Offset3D{0, 0, 0};
         region.imageExtent = vk::Extent3D{width, height, 1};
-        commandBuffer.copyBufferToImage(
+        command_buffer.copyBufferToImage(
                 buffer,
                 image,
                 vk::ImageLayout::eTransferDstOptimal,
                 region
         );
-        end_command( commandBuffer , queue );
     }
 
-    // 使用屏障转换图像布局
+    // 记录转换图像布局的屏障
     void transition_image_layout(
-        const vk::raii::CommandPool& command_pool,
-        const vk::raii::Device& device,
-        const vk::raii::Queue& queue,
+        const vk::raii::CommandBuffer& command_buffer,
         const vk::Image image,
         const vk::ImageLayout oldLayout,
-        const vk::ImageLayout newLayout
+        const vk::ImageLayout newLayout,
+        const std::uint32_t mip_levels = 1
     ) {
-        const auto command_buffer = begin_command(command_pool, device);
-
-
         vk::ImageMemoryBarrier2 barrier2;
         barrier2.image = image;
         barrier2.oldLayout = oldLayout;
@@ -217,7 +180,7 @@ export namespace vht {
         barrier2.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
         barrier2.subresourceRange = {
             vk::ImageAspectFlagBits::eColor,
-            0, 1, 0, 1
+            0, mip_levels, 0, 1
         };
 
         if( oldLayout == vk::ImageLayout::eUndefined &&
@@ -243,8 +206,6 @@ export namespace vht {
         dependency_info.setImageMemoryBarriers( barrier2 );
 
         command_buffer.pipelineBarrier2( dependency_info );
-
-        end_command( command_buffer, queue );
     }
 
 }
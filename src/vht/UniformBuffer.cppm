@@ -9,6 +9,7 @@ import Config;
 import Tools;
 import Window;
 import Device;
+import MemoryAllocator;
 import Swapchain;
 
 export namespace vht {
@@ -25,22 +26,25 @@ export namespace vht {
      * - 依赖：
      *  - m_window: 窗口
      *  - m_device: 物理/逻辑设备与队列
+     *  - m_allocator: 设备内存分配器
      *  - m_swapchain: 交换链
      * - 工作：
      *  - 创建 Uniform Buffer
-     *  - 分配内存
-     *  - 映射内存
+     *  - 从分配器获取持久映射的内存
      * - 可访问成员：
      *  - uniform_buffers(): Uniform Buffer 列表
      *  - uniform_mapped(): 映射的 Uniform Buffer 数据指针列表
+     *  - ubo(): 最近一次写入的变换矩阵，用于 CPU 端的 LOD 选择
      */
     class UniformBuffer {
         std::shared_ptr<vht::Window> m_window{ nullptr };
         std::shared_ptr<vht::Device> m_device{ nullptr };
+        std::shared_ptr<vht::MemoryAllocator> m_allocator{ nullptr };
         std::shared_ptr<vht::Swapchain> m_swapchain{ nullptr };
-        std::vector<vk::raii::DeviceMemory> m_memories;
+        std::vector<vht::Allocation> m_allocations;
         std::vector<vk::raii::Buffer> m_buffers;
         std::vector<void*> m_mapped;
+        UBO m_ubo{};
         glm::vec3 m_cameraPos{ 2.0f, 2.0f, 2.0f };
         glm::vec3 m_cameraUp{ 0.0f, 1.0f, 0.0f };
         float m_pitch = -35.0f;
@@ -51,24 +55,21 @@ export namespace vht {
         explicit UniformBuffer(
             std::shared_ptr<vht::Window> window,
             std::shared_ptr<vht::Device> device,
+            std::shared_ptr<vht::MemoryAllocator> allocator,
             std::shared_ptr<vht::Swapchain> swapchain
         ):  m_window(std::move(window)),
             m_device(std::move(device)),
+            m_allocator(std::move(allocator)),
             m_swapchain(std::move(swapchain)){
             init();
         }
 
-        // 析构时清除映射
-        ~UniformBuffer() {
-            for (const auto& memory : m_memories) {
-                memory.unmapMemory();
-            }
-        }
-
         [[nodiscard]]
         const std::vector<vk::raii::Buffer>& buffers() const { return m_buffers; }
         [[nodiscard]]
         const std::vector<void*>& mapped() const { return m_mapped; }
+        [[nodiscard]]
+        const UBO& ubo() const { return m_ubo; }
         // 更新 Uniform Buffer
         void update_uniform_buffer(const int current_frame ) {
             update_camera();
@@ -79,16 +80,8 @@ export namespace vht {
             front.z = std::sinf(glm::radians(m_yaw)) * std::cosf(glm::radians(m_pitch));
             front = glm::normalize(front);
             UBO ubo{};
-            ubo.model = glm::rotate(
-                    glm::mat4(1.0f),
-                    glm::radians(-90.0f),
-                    glm::vec3(1.0f, 0.0f, 0.0f)
-            );
-            ubo.model *= glm::rotate(
-                    glm::mat4(1.0f),
-                    glm::radians(-90.0f),
-                    glm::vec3(0.0f, 0.0f, 1.0f)
-            );
+            // 场景整体的变换，各网格的摆放由 SceneLoader 给出
+            ubo.model = glm::mat4(1.0f);
             ubo.view = glm::lookAt(
                     m_cameraPos,
                     m_cameraPos + front,
@@ -102,6 +95,7 @@ export namespace vht {
             );
             ubo.proj[1][1] *= -1;
             std::memcpy(m_mapped[current_frame], &ubo, sizeof(UBO));
+            m_ubo = ubo;
         }
     private:
         void init() {
@@ -110,24 +104,24 @@ export namespace vht {
         // 创建 Uniform Buffer
         void create_uniform_buffer() {
             m_buffers.reserve(MAX_FRAMES_IN_FLIGHT);
-            m_memories.reserve(MAX_FRAMES_IN_FLIGHT);
+            m_allocations.reserve(MAX_FRAMES_IN_FLIGHT);
             m_mapped.reserve(MAX_FRAMES_IN_FLIGHT);
             for(std::size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
                 constexpr vk::DeviceSize bufferSize  = sizeof(UBO);
                 m_buffers.emplace_back( nullptr );
-                m_memories.emplace_back( nullptr );
+                m_allocations.emplace_back( nullptr );
                 m_mapped.emplace_back( nullptr );
                 create_buffer(
                     m_buffers[i],
-                    m_memories[i],
+                    m_allocations[i],
                     m_device->device(),
-                    m_device->physical_device(),
+                    *m_allocator,
                     bufferSize,
                     vk::BufferUsageFlagBits::eUniformBuffer,
                     vk::MemoryPropertyFlagBits::eHostVisible |
                     vk::MemoryPropertyFlagBits::eHostCoherent
                 );
-                m_mapped[i] = m_memories[i].mapMemory(0, bufferSize);
+                m_mapped[i] = m_allocations[i].mapped();
             }
         }
         // 创建缓冲区
@@ -0,0 +1,374 @@
+export module UploadBatcher;
+
+import std;
+import vulkan_hpp;
+
+import Tools;
+import Device;
+import StagingRing;
+
+export namespace vht {
+
+    /**
+     * @brief 上传命令批处理
+     * @details
+     * - 依赖：
+     *  - m_device: 逻辑设备与队列
+     *  - m_staging_ring: 上传暂存环
+     * - 工作：
+     *  - 将多次复制和布局转换记录进同一个命令缓冲区，在传输队列上执行
+     *  - 传输队列族与图形队列族不同时，用队列族所有权转移屏障把资源交给图形队列族：
+     *    传输命令缓冲区记录释放屏障，图形命令缓冲区记录获取屏障
+     *  - submit() 一次提交整批命令，不等待队列空闲，返回可等待的时间线值
+     *  - 暂存环空间不足时自动提交当前批次
+     *  - 回收已完成批次的命令缓冲区
+     *  - 一个实例只能在一个线程中使用，需要后台上传的线程应创建自己的实例
+     * - 可访问成员：
+     *  - submitted_value(): 最近一次提交的时间线值
+     *  - separate_transfer(): 是否使用独立的传输队列族
+     */
+    class UploadBatcher {
+        struct Batch {
+            std::uint64_t value{};
+            vk::raii::CommandBuffer transfer{ nullptr };
+            vk::raii::CommandBuffer graphics{ nullptr };
+        };
+        std::shared_ptr<vht::Device> m_device{ nullptr };
+        std::shared_ptr<vht::StagingRing> m_staging_ring{ nullptr };
+        std::uint32_t m_graphics_family{};
+        std::uint32_t m_transfer_family{};
+        vk::raii::CommandPool m_transfer_pool{ nullptr };
+        vk::raii::CommandPool m_graphics_pool{ nullptr };
+        vk::raii::Semaphore m_transfer_semaphore{ nullptr };
+        std::uint64_t m_transfer_value{ 0 };
+        vk::raii::CommandBuffer m_transfer_recording{ nullptr };
+        vk::raii::CommandBuffer m_graphics_recording{ nullptr };
+        std::vector<vk::raii::CommandBuffer> m_free_transfer;
+        std::vector<vk::raii::CommandBuffer> m_free_graphics;
+        std::deque<Batch> m_in_flight;
+        std::uint64_t m_submitted_value{ 0 };
+    public:
+        explicit UploadBatcher(std::shared_ptr<vht::Device> device, std::shared_ptr<vht::StagingRing> staging_ring)
+        :   m_device(std::move(device)),
+            m_staging_ring(std::move(staging_ring)) {
+            init();
+        }
+
+        [[nodiscard]]
+        std::uint64_t submitted_value() const { return m_submitted_value; }
+        [[nodiscard]]
+        bool separate_transfer() const { return m_transfer_family != m_graphics_family; }
+
+        /**
+         * @brief 预留暂存区域，由调用者自行写入
+         * @warning 在记录使用该区域的命令之前不要再次预留，否则自动提交会提前回收它
+         */
+        [[nodiscard]]
+        StagingRegion reserve(const vk::DeviceSize size, const vk::DeviceSize alignment = 16) {
+            if (auto region = m_staging_ring->try_allocate(size, alignment)) return *region;
+            std::ignore = submit();
+            return m_staging_ring->allocate(size, alignment);
+        }
+
+        /**
+         * @brief 尝试预留暂存区域，空间不足时返回 std::nullopt，不提交当前批次
+         * @details 需要先预留多个区域、再统一记录命令时使用，避免自动提交回收尚未使用的区域
+         */
+        [[nodiscard]]
+        std::optional<StagingRegion> try_reserve(const vk::DeviceSize size, const vk::DeviceSize alignment = 16) {
+            return m_staging_ring->try_allocate(size, alignment);
+        }
+
+        // 将数据上传到缓冲区
+        void upload_buffer(
+            const void* data,
+            const vk::DeviceSize size,
+            const vk::Buffer dst_buffer,
+            const vk::DeviceSize dst_offset = 0
+        ) {
+            const auto region = reserve(size);
+            std::memcpy(region.data, data, static_cast<std::size_t>(size));
+            copy_buffer(region, dst_buffer, dst_offset, size);
+        }
+
+        // 将像素数据上传到图像的某一级，该级需处于 TransferDstOptimal 布局
+        void upload_image(
+            const void* data,
+            const vk::DeviceSize size,
+            const vk::Image image,
+            const std::uint32_t width,
+            const std::uint32_t height,
+            const std::uint32_t mip_level = 0
+        ) {
+            const auto region = reserve(size);
+            std::memcpy(region.data, data, static_cast<std::size_t>(size));
+            copy_buffer_to_image(region, image, width, height, mip_level);
+        }
+
+        // 记录从暂存区域到缓冲区的复制
+        void copy_buffer(
+            const StagingRegion& src_region,
+            const vk::Buffer dst_buffer,
+            const vk::DeviceSize dst_offset,
+            const vk::DeviceSize size
+        ) {
+            vht::copy_buffer(transfer_command(), src_region.buffer, src_region.offset, dst_buffer, dst_offset, size);
+        }
+
+        // 记录从暂存区域到图像的复制
+        void copy_buffer_to_image(
+            const StagingRegion& src_region,
+            const vk::Image image,
+            const std::uint32_t width,
+            const std::uint32_t height,
+            const std::uint32_t mip_level = 0
+        ) {
+            vht::copy_buffer_to_image(transfer_command(), src_region.buffer, src_region.offset, image, width, height, mip_level);
+        }
+
+        // 在传输命令中记录图像布局转换
+        void transition_image_layout(
+            const vk::Image image,
+            const vk::ImageLayout old_layout,
+            const vk::ImageLayout new_layout,
+            const std::uint32_t mip_levels = 1
+        ) {
+            vht::transition_image_layout(transfer_command(), image, old_layout, new_layout, mip_levels);
+        }
+
+        /**
+         * @brief 获取在图形队列族上执行的命令缓冲区，用于记录 blit、计算等传输队列不支持的命令
+         * @details 使用独立传输队列时为获取屏障所在的图形命令缓冲区，在传输命令完成后执行；否则为传输命令缓冲区本身
+         */
+        [[nodiscard]]
+        const vk::raii::CommandBuffer& graphics_command_buffer() {
+            return separate_transfer() ? graphics_command() : transfer_command();
+        }
+
+        /**
+         * @brief 传输写入完成后把缓冲区交给图形队列族
+         * @param dst_stage 图形队列上首次使用缓冲区的阶段
+         * @param dst_access 图形队列上首次使用缓冲区的访问类型
+         */
+        void release_buffer(const vk::Buffer buffer, const vk::PipelineStageFlags2 dst_stage, const vk::AccessFlags2 dst_access) {
+            vk::BufferMemoryBarrier2 barrier;
+            barrier.buffer = buffer;
+            barrier.offset = 0;
+            barrier.size = vk::WholeSize;
+            barrier.srcStageMask = vk::PipelineStageFlagBits2::eTransfer;
+            barrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+            if (!separate_transfer()) {
+                barrier.srcQueueFamilyIndex = vk::QueueFamilyIgnored;
+                barrier.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
+                barrier.dstStageMask = dst_stage;
+                barrier.dstAccessMask = dst_access;
+                transfer_command().pipelineBarrier2( vk::DependencyInfo{}.setBufferMemoryBarriers( barrier ) );
+                return;
+            }
+            // 释放屏障的目标作用域与获取屏障的源作用域均被忽略
+            barrier.srcQueueFamilyIndex = m_transfer_family;
+            barrier.dstQueueFamilyIndex = m_graphics_family;
+            barrier.dstStageMask = vk::PipelineStageFlagBits2::eNone;
+            barrier.dstAccessMask = vk::AccessFlagBits2::eNone;
+            transfer_command().pipelineBarrier2( vk::DependencyInfo{}.setBufferMemoryBarriers( barrier ) );
+
+            barrier.srcStageMask = vk::PipelineStageFlagBits2::eNone;
+            barrier.srcAccessMask = vk::AccessFlagBits2::eNone;
+            barrier.dstStageMask = dst_stage;
+            barrier.dstAccessMask = dst_access;
+            graphics_command().pipelineBarrier2( vk::DependencyInfo{}.setBufferMemoryBarriers( barrier ) );
+        }
+
+        /**
+         * @brief 传输写入完成后转换图像布局，并把图像交给图形队列族
+         * @param old_layout 传输写入时的布局
+         * @param new_layout 图形队列使用时的布局
+         * @param dst_stage 图形队列上首次使用图像的阶段
+         * @param dst_access 图形队列上首次使用图像的访问类型
+         */
+        void release_image(
+            const vk::Image image,
+            const vk::ImageLayout old_layout,
+            const vk::ImageLayout new_layout,
+            const vk::PipelineStageFlags2 dst_stage,
+            const vk::AccessFlags2 dst_access
+        ) {
+            vk::ImageMemoryBarrier2 barrier;
+            barrier.image = image;
+            barrier.oldLayout = old_layout;
+            barrier.newLayout = new_layout;
+            barrier.subresourceRange = { vk::ImageAspectFlagBits::eColor, 0, vk::RemainingMipLevels, 0, 1 };
+            barrier.srcStageMask = vk::PipelineStageFlagBits2::eTransfer;
+            barrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+            if (!separate_transfer()) {
+                barrier.srcQueueFamilyIndex = vk::QueueFamilyIgnored;
+                barrier.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
+                barrier.dstStageMask = dst_stage;
+                barrier.dstAccessMask = dst_access;
+                transfer_command().pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( barrier ) );
+                return;
+            }
+            // 布局转换只执行一次，释放屏障与获取屏障必须指定相同的布局
+            barrier.srcQueueFamilyIndex = m_transfer_family;
+            barrier.dstQueueFamilyIndex = m_graphics_family;
+            barrier.dstStageMask = vk::PipelineStageFlagBits2::eNone;
+            barrier.dstAccessMask = vk::AccessFlagBits2::eNone;
+            transfer_command().pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( barrier ) );
+
+            barrier.srcStageMask = vk::PipelineStageFlagBits2::eNone;
+            barrier.srcAccessMask = vk::AccessFlagBits2::eNone;
+            barrier.dstStageMask = dst_stage;
+            barrier.dstAccessMask = dst_access;
+            graphics_command().pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( barrier ) );
+        }
+
+        /**
+         * @brief 提交当前批次
+         * @details
+         * 使用独立传输队列时，传输命令完成后发出内部时间线信号，
+         * 图形队列等待该信号执行获取屏障，再发出暂存环的时间线信号。
+         * @return 批次完成时时间线信号量到达的值，没有待提交内容时返回最近一次提交的值
+         */
+        [[nodiscard]]
+        std::uint64_t submit() {
+            if (!*m_transfer_recording && !*m_graphics_recording) return m_submitted_value;
+
+            vk::SemaphoreSubmitInfo done_info;
+            done_info.setSemaphore( m_staging_ring->semaphore() );
+            done_info.setValue( m_staging_ring->commit() );
+            done_info.setStageMask( vk::PipelineStageFlagBits2::eAllCommands );
+
+            Batch batch;
+            batch.value = done_info.value;
+            // 其他线程可能同时向同一队列提交
+            const std::scoped_lock lock{ m_device->queue_mutex() };
+
+            if (!separate_transfer()) {
+                m_transfer_recording.end();
+                vk::CommandBufferSubmitInfo command_info;
+                command_info.setCommandBuffer( m_transfer_recording );
+                vk::SubmitInfo2 submit_info;
+                submit_info.setCommandBufferInfos( command_info );
+                submit_info.setSignalSemaphoreInfos( done_info );
+                m_device->transfer_queue().submit2( submit_info );
+            } else {
+                vk::SemaphoreSubmitInfo transfer_info;
+                transfer_info.setSemaphore( m_transfer_semaphore );
+                transfer_info.setValue( ++m_transfer_value );
+                transfer_info.setStageMask( vk::PipelineStageFlagBits2::eAllCommands );
+
+                std::vector<vk::CommandBufferSubmitInfo> transfer_commands;
+                if (*m_transfer_recording) {
+                    m_transfer_recording.end();
+                    transfer_commands.emplace_back( *m_transfer_recording );
+                }
+                vk::SubmitInfo2 transfer_submit;
+                transfer_submit.setCommandBufferInfos( transfer_commands );
+                transfer_submit.setSignalSemaphoreInfos( transfer_info );
+                m_device->transfer_queue().submit2( transfer_submit );
+
+                std::vector<vk::CommandBufferSubmitInfo> graphics_commands;
+                if (*m_graphics_recording) {
+                    m_graphics_recording.end();
+                    graphics_commands.emplace_back( *m_graphics_recording );
+                }
+                vk::SubmitInfo2 graphics_submit;
+                graphics_submit.setWaitSemaphoreInfos( transfer_info );
+                graphics_submit.setCommandBufferInfos( graphics_commands );
+                graphics_submit.setSignalSemaphoreInfos( done_info );
+                m_device->graphics_queue().submit2( graphics_submit );
+            }
+
+            batch.transfer = std::move(m_transfer_recording);
+            batch.graphics = std::move(m_graphics_recording);
+            m_transfer_recording = nullptr;
+            m_graphics_recording = nullptr;
+            m_in_flight.emplace_back( std::move(batch) );
+            m_submitted_value = done_info.value;
+            return m_submitted_value;
+        }
+
+        // 判断某次提交是否完成
+        [[nodiscard]]
+        bool is_complete(const std::uint64_t value) const { return m_staging_ring->is_complete(value); }
+
+        // 等待某次提交完成
+        void wait(const std::uint64_t value) const { m_staging_ring->wait(value); }
+
+    private:
+        void init() {
+            const auto indices = m_device->queue_family_indices();
+            m_graphics_family = indices.graphics_family.value();
+            m_transfer_family = indices.transfer_family.value();
+            create_command_pools();
+            create_semaphore();
+        }
+        // 传输与图形命令各用一个命令池
+        void create_command_pools() {
+            vk::CommandPoolCreateInfo create_info;
+            create_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer |
+                                vk::CommandPoolCreateFlagBits::eTransient;
+            create_info.queueFamilyIndex = m_transfer_family;
+            m_transfer_pool = m_device->device().createCommandPool( create_info );
+            if (separate_transfer()) {
+                create_info.queueFamilyIndex = m_graphics_family;
+                m_graphics_pool = m_device->device().createCommandPool( create_info );
+            }
+        }
+        // 传输队列与图形队列之间的时间线信号量
+        void create_semaphore() {
+            if (!separate_transfer()) return;
+            vk::StructureChain<vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo> create_info;
+            create_info.get<vk::SemaphoreTypeCreateInfo>()
+                .setSemaphoreType( vk::SemaphoreType::eTimeline )
+                .setInitialValue( 0 );
+            m_transfer_semaphore = m_device->device().createSemaphore( create_info.get() );
+        }
+
+        // 获取正在记录的传输命令缓冲区，必要时开始新的批次
+        [[nodiscard]]
+        const vk::raii::CommandBuffer& transfer_command() {
+            if (!*m_transfer_recording) begin(m_transfer_recording, m_transfer_pool, m_free_transfer);
+            return m_transfer_recording;
+        }
+        // 获取正在记录的图形命令缓冲区，只在使用独立传输队列时存在
+        [[nodiscard]]
+        const vk::raii::CommandBuffer& graphics_command() {
+            if (!*m_graphics_recording) begin(m_graphics_recording, m_graphics_pool, m_free_graphics);
+            return m_graphics_recording;
+        }
+
+        // 复用或分配命令缓冲区并开始记录
+        void begin(
+            vk::raii::CommandBuffer& command_buffer,
+            const vk::raii::CommandPool& pool,
+            std::vector<vk::raii::CommandBuffer>& free_buffers
+        ) {
+            recycle();
+            if (free_buffers.empty()) {
+                vk::CommandBufferAllocateInfo alloc_info;
+                alloc_info.commandPool = pool;
+                alloc_info.level = vk::CommandBufferLevel::ePrimary;
+                alloc_info.commandBufferCount = 1;
+                command_buffer = std::move(m_device->device().allocateCommandBuffers(alloc_info).at(0));
+            } else {
+                command_buffer = std::move(free_buffers.back());
+                free_buffers.pop_back();
+                command_buffer.reset();
+            }
+            command_buffer.begin( { vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+        }
+
+        // 回收已执行完毕的命令缓冲区
+        void recycle() {
+            const std::uint64_t completed = m_staging_ring->completed_value();
+            while (!m_in_flight.empty() && m_in_flight.front().value <= completed) {
+                auto& batch = m_in_flight.front();
+                if (*batch.transfer) m_free_transfer.emplace_back( std::move(batch.transfer) );
+                if (*batch.graphics) m_free_graphics.emplace_back( std::move(batch.graphics) );
+                m_in_flight.pop_front();
+            }
+        }
+    };
+
+}
@@ -0,0 +1,121 @@
+module;
+// offsetof 宏需要从 <cstddef> 头文件中导入
+#include <cstddef>
+export module VertexFormat;
+
+import std;
+import vulkan_hpp;
+import glm;
+
+import Config;
+import DataLoader;
+
+export namespace vht {
+
+    /**
+     * @brief 网格反量化参数，通过推送常量传给顶点着色器
+     * @details
+     * - 着色器中的位置为 offset.xyz + 属性值 * scale.xyz
+     * - 浮点布局使用单位变换
+     */
+    struct MeshQuantization {
+        glm::vec4 offset{ 0.0f };
+        glm::vec4 scale{ 1.0f };
+    };
+
+    /**
+     * @brief GPU 顶点格式
+     * @details
+     * 按 VertexLayout 特化，每个特化提供与自身成员匹配的绑定描述和属性描述，
+     * 以及从 vht::Vertex 编码的函数。属性位置与着色器保持一致：
+     * - location 0: 位置，着色器中读取为 vec3
+     * - location 1: 纹理坐标，着色器中读取为 vec2
+     */
+    template<VertexLayout Layout>
+    struct GpuVertex;
+
+    // 32 位浮点布局，20 字节
+    template<>
+    struct GpuVertex<VertexLayout::eFloat> {
+        glm::vec3 pos;
+        glm::vec2 texCoord;
+
+        static vk::VertexInputBindingDescription get_binding_description() {
+            return { 0, sizeof(GpuVertex), vk::VertexInputRate::eVertex };
+        }
+        static std::array<vk::VertexInputAttributeDescription, 2> get_attribute_description() {
+            std::array<vk::VertexInputAttributeDescription, 2> descriptions;
+            descriptions[0].location = 0;
+            descriptions[0].binding = 0;
+            descriptions[0].format = vk::Format::eR32G32B32Sfloat;
+            descriptions[0].offset = offsetof(GpuVertex, pos);
+            descriptions[1].location = 1;
+            descriptions[1].binding = 0;
+            descriptions[1].format = vk::Format::eR32G32Sfloat;
+            descriptions[1].offset = offsetof(GpuVertex, texCoord);
+            return descriptions;
+        }
+        static MeshQuantization quantization(std::span<const Vertex>) {
+            return {};
+        }
+        static GpuVertex encode(const Vertex& vertex, const MeshQuantization&) {
+            return { vertex.pos, vertex.texCoord };
+        }
+    };
+
+    /**
+     * @brief 紧凑布局，12 字节
+     * @details
+     * - 位置：16 位 UNORM，按网格包围盒归一化，第四个分量仅用于对齐
+     * - 纹理坐标：16 位半精度浮点，允许超出 [0, 1] 的重复纹理坐标
+     */
+    template<>
+    struct GpuVertex<VertexLayout::eCompact> {
+        std::array<std::uint16_t, 4> pos;
+        std::uint32_t texCoord;
+
+        static vk::VertexInputBindingDescription get_binding_description() {
+            return { 0, sizeof(GpuVertex), vk::VertexInputRate::eVertex };
+        }
+        static std::array<vk::VertexInputAttributeDescription, 2> get_attribute_description() {
+            std::array<vk::VertexInputAttributeDescription, 2> descriptions;
+            descriptions[0].location = 0;
+            descriptions[0].binding = 0;
+            descriptions[0].format = vk::Format::eR16G16B16A16Unorm;
+            descriptions[0].offset = offsetof(GpuVertex, pos);
+            descriptions[1].location = 1;
+            descriptions[1].binding = 0;
+            descriptions[1].format = vk::Format::eR16G16Sfloat;
+            descriptions[1].offset = offsetof(GpuVertex, texCoord);
+            return descriptions;
+        }
+        // 由包围盒计算反量化参数
+        static MeshQuantization quantization(const std::span<const Vertex> vertices) {
+            if (vertices.empty()) return {};
+            glm::vec3 min_pos{ std::numeric_limits<float>::max() };
+            glm::vec3 max_pos{ std::numeric_limits<float>::lowest() };
+            for (const auto& vertex : vertices) {
+                min_pos = glm::min(min_pos, vertex.pos);
+                max_pos = glm::max(max_pos, vertex.pos);
+            }
+            glm::vec3 extent = max_pos - min_pos;
+            for (int i = 0; i < 3; ++i) {
+                if (extent[i] <= 0.0f) extent[i] = 1.0f;
+            }
+            return { glm::vec4(min_pos, 0.0f), glm::vec4(extent, 0.0f) };
+        }
+        static GpuVertex encode(const Vertex& vertex, const MeshQuantization& quantization) {
+            GpuVertex result{};
+            for (int i = 0; i < 3; ++i) {
+                const float unorm = (vertex.pos[i] - quantization.offset[i]) / quantization.scale[i];
+                result.pos[i] = static_cast<std::uint16_t>(std::lround(std::clamp(unorm, 0.0f, 1.0f) * 65535.0f));
+            }
+            result.texCoord = glm::packHalf2x16(vertex.texCoord);
+            return result;
+        }
+    };
+
+    // 上传到 GPU 使用的顶点格式，由 VERTEX_LAYOUT 选择
+    using DeviceVertex = GpuVertex<VERTEX_LAYOUT>;
+
+}
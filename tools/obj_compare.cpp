@@ -0,0 +1,110 @@
+import std;
+import tinyobj;
+
+import ObjParser;
+
+namespace {
+
+    // 展开后的一个角点，与 DataLoader 中由角点构造顶点的方式相同
+    struct CornerVertex {
+        std::array<float, 3> position{};
+        std::array<float, 2> texcoord{};
+    };
+
+    [[nodiscard]]
+    bool same_bits(const float a, const float b) {
+        return std::bit_cast<std::uint32_t>(a) == std::bit_cast<std::uint32_t>(b);
+    }
+
+    [[nodiscard]]
+    bool same_vertex(const CornerVertex& a, const CornerVertex& b) {
+        return same_bits(a.position[0], b.position[0]) && same_bits(a.position[1], b.position[1]) &&
+            same_bits(a.position[2], b.position[2]) &&
+            same_bits(a.texcoord[0], b.texcoord[0]) && same_bits(a.texcoord[1], b.texcoord[1]);
+    }
+
+    // 原来的 tinyobj 路径：LoadObj 三角化后按形状顺序展开索引
+    [[nodiscard]]
+    std::vector<CornerVertex> load_tinyobj(const std::string& path) {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn, err;
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())) {
+            throw std::runtime_error(warn + err);
+        }
+        std::vector<CornerVertex> corners;
+        for (const auto& shape : shapes) {
+            for (const auto& index : shape.mesh.indices) {
+                CornerVertex vertex;
+                vertex.position = {
+                    attrib.vertices[3 * index.vertex_index + 0],
+                    attrib.vertices[3 * index.vertex_index + 1],
+                    attrib.vertices[3 * index.vertex_index + 2]
+                };
+                // 旧代码在缺少纹理坐标时越界读取，这里按 ObjParser 的约定取 (0, 0)
+                vertex.texcoord = index.texcoord_index >= 0
+                    ? std::array{ attrib.texcoords[2 * index.texcoord_index + 0], 1.0f - attrib.texcoords[2 * index.texcoord_index + 1] }
+                    : std::array{ 0.0f, 1.0f };
+                corners.push_back(vertex);
+            }
+        }
+        return corners;
+    }
+
+    [[nodiscard]]
+    std::vector<CornerVertex> load_parser(const std::string& path) {
+        const vht::ObjData obj = vht::parse_obj(path);
+        std::vector<CornerVertex> corners;
+        corners.reserve(obj.corners.size());
+        for (const auto& corner : obj.corners) {
+            CornerVertex vertex;
+            vertex.position = {
+                obj.positions[3 * corner.position + 0],
+                obj.positions[3 * corner.position + 1],
+                obj.positions[3 * corner.position + 2]
+            };
+            vertex.texcoord = corner.texcoord >= 0
+                ? std::array{ obj.texcoords[2 * corner.texcoord + 0], 1.0f - obj.texcoords[2 * corner.texcoord + 1] }
+                : std::array{ 0.0f, 1.0f };
+            corners.push_back(vertex);
+        }
+        return corners;
+    }
+
+}
+
+// 对比 ObjParser 与 tinyobj::LoadObj 展开后的顶点，要求逐位相同，需在项目根目录运行
+// 用法：obj_compare [model.obj]...，不指定时对比 viking_room、bunny 与 Marry
+int main(const int argc, char** argv) {
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) paths.emplace_back(argv[i]);
+    if (paths.empty()) paths = { "models/viking_room.obj", "models/bunny.obj", "models/Marry/Marry.obj" };
+
+    int result = 0;
+    for (const auto& path : paths) {
+        try {
+            const auto expected = load_tinyobj(path);
+            const auto actual = load_parser(path);
+            const auto [expected_it, actual_it] = std::ranges::mismatch(expected, actual, same_vertex);
+            if (expected.size() == actual.size() && expected_it == expected.end()) {
+                std::println("{}: {} corners identical", path, actual.size());
+                continue;
+            }
+            result = 1;
+            const auto index = static_cast<std::size_t>(expected_it - expected.begin());
+            std::println("{}: mismatch, tinyobj {} corners, ObjParser {} corners, first difference at corner {}",
+                path, expected.size(), actual.size(), index);
+            if (expected_it != expected.end() && actual_it != actual.end()) {
+                for (const auto& [name, vertex] : { std::pair{ "tinyobj", *expected_it }, std::pair{ "ObjParser", *actual_it } }) {
+                    std::println("  {:<10} ({}, {}, {}) ({}, {})", name,
+                        vertex.position[0], vertex.position[1], vertex.position[2], vertex.texcoord[0], vertex.texcoord[1]);
+                }
+            }
+        } catch (const std::exception& e) {
+            std::println("failed to compare {}: {}", path, e.what());
+            result = 1;
+        }
+    }
+    return result;
+}
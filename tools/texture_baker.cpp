@@ -0,0 +1,43 @@
+import std;
+
+import Config;
+import TextureCache;
+import TextureBaker;
+
+// 离线烘焙纹理容器，需在项目根目录运行，容器写入 cache/textures/
+// 用法：texture_baker [--no-mips] [--bc1 | --bc7] <image>...
+int main(const int argc, char** argv) {
+    bool mipmaps = true;
+    auto compression = vht::TextureCompression::eNone;
+    std::vector<std::filesystem::path> sources;
+    for (int i = 1; i < argc; ++i) {
+        if (const std::string_view arg = argv[i]; arg == "--no-mips") {
+            mipmaps = false;
+        } else if (arg == "--bc1") {
+            compression = vht::TextureCompression::eBC1;
+        } else if (arg == "--bc7") {
+            compression = vht::TextureCompression::eBC7;
+        } else {
+            sources.emplace_back(arg);
+        }
+    }
+    if (sources.empty()) {
+        std::println("usage: texture_baker [--no-mips] [--bc1 | --bc7] <image>...");
+        return 1;
+    }
+
+    int result = 0;
+    for (const auto& source : sources) {
+        try {
+            const auto texture = vht::bake_texture(source, mipmaps, compression);
+            vht::TextureCache::store(source, texture.image());
+            std::println("baked {}: {}x{}, {} levels -> {}",
+                source.string(), texture.width, texture.height, texture.levels.size(),
+                vht::TextureCache::cache_path(source).string());
+        } catch (const std::exception& e) {
+            std::println("failed to bake {}: {}", source.string(), e.what());
+            result = 1;
+        }
+    }
+    return result;
+}